@@ -1,22 +1,44 @@
 #ifndef __AnimateActors_h
+#define __AnimateActors_h
 #include <vtkActor.h>
 #include <vtkAnimationCue.h>
 #include <vtkCommand.h>
+#include <vtkMatrix4x4.h>
 #include <vtkRenderWindow.h>
+#include <algorithm>
+#include <cmath>
 #include <vector>
+
+#include "BroadPhase.h"
+#include "FrameProfiler.h"
+#include "KeyframeTrack.h"
+#include "Pool.h"
+#include "RenderScheduler.h"
  
+// Moves an actor from StartPosition to EndPosition over the cue while
+// spinning it about its X axis at AngularVelocity, or along keyframe
+// tracks. The whole transform is computed from the time since the start
+// of the cue, not accumulated tick by tick, so the pose at a given time
+// does not depend on how many ticks came before it and seeking is as
+// cheap as a tick. It is written once per tick into a matrix set as the
+// actor's user matrix; the actor's own position, orientation and scale
+// are left at identity.
 class ActorAnimator
 {
 public:
   ActorAnimator()
     {
     this->Actor=0;
+    this->Matrix=vtkMatrix4x4::New();
+    this->PositionTrack=0;
+    this->OrientationTrack=0;
+    this->ScaleTrack=0;
+    this->Scheduler=0;
+    this->BroadPhaseCollision=0;
+    this->BroadPhaseId=-1;
     this->Observer = AnimationCueObserver::New();
     this->Observer->Animator = this;
-    this->StartPosition.resize(3);
-    this->StartPosition.insert(this->StartPosition.begin(), 3, 0.0);
-    this->EndPosition.resize(3);
-    this->EndPosition.insert(this->EndPosition.begin(), 3, .5);
+    this->ResetMotion();
     }
  
   ~ActorAnimator()
@@ -27,24 +49,186 @@ public:
       this->Actor=0;
       }
     this->Observer->UnRegister(0);
+    this->Matrix->Delete();
+    delete this->PositionTrack;
+    delete this->OrientationTrack;
+    delete this->ScaleTrack;
     }
   void SetActor(vtkActor *actor)
     {
+    if (actor == this->Actor)
+      {
+      return;
+      }
     if (this->Actor)
       {
       this->Actor->UnRegister(0);
       }
     this->Actor = actor;
     this->Actor->Register(0);
+    this->Actor->SetPosition(0, 0, 0);
+    this->Actor->SetOrientation(0, 0, 0);
+    this->Actor->SetScale(1.0);
+    this->Actor->SetOrigin(0, 0, 0);
+    this->Actor->SetUserMatrix(this->Matrix);
+    }
+  vtkActor *GetActor()
+    {
+    return this->Actor;
+    }
+  void SetStartPosition(const double position[3])
+    {
+    for (int i = 0; i < 3; i++)
+      {
+      this->StartPosition[i] = position[i];
+      }
+    }
+  void SetStartPosition(const std::vector<double> &position)
+    {
+    this->SetStartPosition(&position[0]);
+    }
+  void SetEndPosition(const double position[3])
+    {
+    for (int i = 0; i < 3; i++)
+      {
+      this->EndPosition[i] = position[i];
+      }
     }
-  void SetStartPosition(std::vector<double> position)
+  void SetEndPosition(const std::vector<double> &position)
     {
-    this->StartPosition = position;
+    this->SetEndPosition(&position[0]);
     }
-  void SetEndPosition(std::vector<double> position)
+  // Back to the default motion: from the origin to (.5, .5, .5) spinning
+  // at 20 degrees per second, with the keys of any tracks removed but
+  // their storage kept. Lets a recycled animator start over without
+  // allocating.
+  void ResetMotion()
     {
-    this->EndPosition = position;
+    for (int i = 0; i < 3; i++)
+      {
+      this->StartPosition[i] = 0.0;
+      this->EndPosition[i] = 0.5;
+      }
+    this->AngularVelocity = 20.0;
+    if (this->PositionTrack)
+      {
+      this->PositionTrack->RemoveAllKeys();
+      }
+    if (this->OrientationTrack)
+      {
+      this->OrientationTrack->RemoveAllKeys();
+      }
+    if (this->ScaleTrack)
+      {
+      this->ScaleTrack->RemoveAllKeys();
+      }
+    }
+  // Rotation about X in degrees per second of animation time. The default
+  // matches the 2 degrees per tick at 10 frames per second the animator
+  // used to apply.
+  void SetAngularVelocity(double degreesPerSecond)
+    {
+    this->AngularVelocity = degreesPerSecond;
+    }
+  double GetAngularVelocity() const
+    {
+    return this->AngularVelocity;
+    }
+  // When set, each tick asks the scheduler for a render instead of relying
+  // on the scene observer rendering unconditionally.
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+  // Tells the broad phase when the actor moves; id is the one returned by
+  // BroadPhase::AddActor for this actor.
+  void SetBroadPhase(BroadPhase *broadPhase, int id)
+    {
+    this->BroadPhaseCollision = broadPhase;
+    this->BroadPhaseId = id;
+    }
+  // Keyframe tracks, created on first access. Key times are relative to
+  // the start of the cue. When a position track exists it replaces the
+  // Start/End lerp; an orientation track (quaternion w, x, y, z) replaces
+  // the rotation about X.
+  KeyframeTrack *GetPositionTrack()
+    {
+    if (!this->PositionTrack)
+      {
+      this->PositionTrack = new KeyframeTrack(3);
+      }
+    return this->PositionTrack;
+    }
+  KeyframeTrack *GetOrientationTrack()
+    {
+    if (!this->OrientationTrack)
+      {
+      this->OrientationTrack = new KeyframeTrack(4);
+      this->OrientationTrack->SetQuaternion(true);
+      }
+    return this->OrientationTrack;
+    }
+  KeyframeTrack *GetScaleTrack()
+    {
+    if (!this->ScaleTrack)
+      {
+      this->ScaleTrack = new KeyframeTrack(3);
+      }
+    return this->ScaleTrack;
+    }
+  // World box holding the actor from time0 to time1 seconds into a cue
+  // lasting duration, given its bounds in model coordinates. Whatever the
+  // rotation, the model stays within the sphere about its origin through
+  // the farthest corner, scaled by the largest scale reached, so the box
+  // is the box of the positions reached grown by that radius.
+  void GetMotionBounds(const double modelBounds[6], double time0, double time1,
+                       double duration, double bounds[6])
+    {
+    double radius2 = 0.0;
+    for (int corner = 0; corner < 8; corner++)
+      {
+      double x = modelBounds[corner & 1], y = modelBounds[2 + ((corner >> 1) & 1)],
+        z = modelBounds[4 + (corner >> 2)];
+      radius2 = std::max(radius2, x * x + y * y + z * z);
+      }
+    double scale = 1.0;
+    if (this->ScaleTrack && this->ScaleTrack->GetNumberOfKeys())
+      {
+      double low[3], high[3];
+      this->ScaleTrack->GetBounds(time0, time1, low, high);
+      scale = 0.0;
+      for (int i = 0; i < 3; i++)
+        {
+        scale = std::max(scale, std::max(fabs(low[i]), fabs(high[i])));
+        }
+      }
+    double low[3], high[3];
+    if (this->PositionTrack && this->PositionTrack->GetNumberOfKeys())
+      {
+      this->PositionTrack->GetBounds(time0, time1, low, high);
+      }
+    else
+      {
+      // The lerp is linear in time, so its ends bound it.
+      double u0 = duration > 0 ? time0 / duration : 1.0;
+      double u1 = duration > 0 ? time1 / duration : 1.0;
+      for (int i = 0; i < 3; i++)
+        {
+        double delta = this->EndPosition[i] - this->StartPosition[i];
+        double p0 = this->StartPosition[i] + delta * u0;
+        double p1 = this->StartPosition[i] + delta * u1;
+        low[i] = std::min(p0, p1);
+        high[i] = std::max(p0, p1);
+        }
+      }
+    double radius = sqrt(radius2) * scale;
+    for (int i = 0; i < 3; i++)
+      {
+      bounds[2 * i] = low[i] - radius;
+      bounds[2 * i + 1] = high[i] + radius;
+      }
     }
+
   void AddObserversToCue(vtkAnimationCue *cue)
     {
     cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
@@ -52,34 +236,129 @@ public:
     cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
     }
  
-  void Start(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+  void Start(vtkAnimationCue::AnimationCueInfo *info)
     {
-    this->Actor->SetPosition(this->StartPosition[0],
-                             this->StartPosition[1], 
-                             this->StartPosition[2]);
+    this->Compose(0.0, info->EndTime - info->StartTime, this->Evaluated.Matrix);
+    this->Commit();
     }
- 
+
   void Tick(vtkAnimationCue::AnimationCueInfo *info)
     {
-    double t = (info->AnimationTime - info->StartTime) / (info->EndTime - info->StartTime);
-    double position[3];
-    for (int i = 0; i < 3; i++)
+    FRAME_PROFILE_SCOPE("ActorAnimator::Tick");
+    this->Evaluate(info);
+    this->Commit();
+    if (this->Scheduler)
       {
-      position[i] = this->StartPosition[i] + (this->EndPosition[i] - this->StartPosition[i]) * t;
+      this->Scheduler->RequestRender();
       }
-    this->Actor->SetPosition(position);
-	this->Actor->RotateX(2.0);
-	//cout<<"position: "<< position[0] <<" "<<position[1]<<" "<<position[0]<<endl;
     }
- 
-  void End(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+
+  // First half of Tick: computes the actor's new matrix into this
+  // animator's own buffer without touching the actor, so different
+  // animators can be evaluated on different threads at once.
+  void Evaluate(vtkAnimationCue::AnimationCueInfo *info)
     {
-    this->Actor->SetPosition(this->EndPosition[0],
-                             this->EndPosition[1], 
-                             this->EndPosition[2]);
+    this->Compose(info->AnimationTime - info->StartTime, info->EndTime - info->StartTime,
+                  this->Evaluated.Matrix);
     }
- 
+
+  // Second half of Tick: writes the matrix computed by Evaluate to the
+  // actor. Must run on the main thread.
+  void Commit()
+    {
+    this->Commit(this->Evaluated.Matrix);
+    }
+
+  // Writes a row-major matrix computed elsewhere, e.g. by EvaluateMatrix,
+  // to the actor. Must run on the main thread.
+  void Commit(const double matrix[16])
+    {
+    double *element = &this->Matrix->Element[0][0];
+    for (int i = 0; i < 16; i++)
+      {
+      element[i] = matrix[i];
+      }
+    this->Matrix->Modified();
+    this->MarkMoved();
+    }
+
+  // The matrix of the pose at time seconds into a cue lasting duration,
+  // leaving the actor and the buffer of Evaluate alone. Can run on any
+  // one thread at a time while the motion is not being changed.
+  void EvaluateMatrix(double time, double duration, double matrix[16])
+    {
+    this->Compose(time, duration, matrix);
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    double duration = info->EndTime - info->StartTime;
+    this->Compose(duration, duration, this->Evaluated.Matrix);
+    this->Commit();
+    }
+
 protected:
+  void MarkMoved()
+    {
+    if (this->BroadPhaseCollision)
+      {
+      this->BroadPhaseCollision->MarkMoved(this->BroadPhaseId);
+      }
+    }
+
+  // Row-major matrix of the pose at time seconds into a cue lasting
+  // duration: translation * rotation * scale.
+  void Compose(double time, double duration, double m[16])
+    {
+    double position[3], scale[3] = {1.0, 1.0, 1.0}, r[9];
+    if (this->PositionTrack && this->PositionTrack->GetNumberOfKeys())
+      {
+      this->PositionTrack->Evaluate(time, position);
+      }
+    else
+      {
+      double t = duration > 0 ? time / duration : 1.0;
+      for (int i = 0; i < 3; i++)
+        {
+        position[i] = this->StartPosition[i] + (this->EndPosition[i] - this->StartPosition[i]) * t;
+        }
+      }
+    if (this->OrientationTrack && this->OrientationTrack->GetNumberOfKeys())
+      {
+      double q[4];
+      this->OrientationTrack->Evaluate(time, q);
+      double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+      double w = q[0] / norm, x = q[1] / norm, y = q[2] / norm, z = q[3] / norm;
+      r[0] = 1 - 2 * (y * y + z * z); r[1] = 2 * (x * y - w * z);     r[2] = 2 * (x * z + w * y);
+      r[3] = 2 * (x * y + w * z);     r[4] = 1 - 2 * (x * x + z * z); r[5] = 2 * (y * z - w * x);
+      r[6] = 2 * (x * z - w * y);     r[7] = 2 * (y * z + w * x);     r[8] = 1 - 2 * (x * x + y * y);
+      }
+    else
+      {
+      double angle = this->AngularVelocity * time * 3.14159265358979323846 / 180.0;
+      double c = cos(angle), s = sin(angle);
+      r[0] = 1; r[1] = 0; r[2] = 0;
+      r[3] = 0; r[4] = c; r[5] = -s;
+      r[6] = 0; r[7] = s; r[8] = c;
+      }
+    if (this->ScaleTrack && this->ScaleTrack->GetNumberOfKeys())
+      {
+      this->ScaleTrack->Evaluate(time, scale);
+      }
+    for (int i = 0; i < 3; i++)
+      {
+      for (int j = 0; j < 3; j++)
+        {
+        m[4 * i + j] = r[3 * i + j] * scale[j];
+        }
+      m[4 * i + 3] = position[i];
+      }
+    m[12] = m[13] = m[14] = 0.0;
+    m[15] = 1.0;
+    }
+
+  // Every animator has one, so they come from a pool rather than the
+  // heap; see GetObserverPool.
   class AnimationCueObserver : public vtkCommand
   {
   public:
@@ -87,6 +366,15 @@ protected:
       {
       return new AnimationCueObserver;
       }
+
+    static void *operator new(size_t)
+      {
+      return GetObserverPool().Allocate();
+      }
+    static void operator delete(void *pointer)
+      {
+      GetObserverPool().Free(pointer);
+      }
  
     virtual void Execute(vtkObject *vtkNotUsed(caller),
                          unsigned long event,
@@ -118,10 +406,36 @@ protected:
     ActorAnimator *Animator;
   };
  
+  // Result of the last Evaluate, applied by Commit.
+  struct EvaluatedState
+    {
+    double Matrix[16];
+    };
+
+public:
+  // Pool of the observers of all animators. Reserving ahead of a burst of
+  // new animators keeps their observers off the heap. Never destroyed, so
+  // animators released during static destruction still find it.
+  static ObjectPool<AnimationCueObserver> &GetObserverPool()
+    {
+    static ObjectPool<AnimationCueObserver> *pool = new ObjectPool<AnimationCueObserver>;
+    return *pool;
+    }
+
+protected:
   vtkActor *             Actor;
   AnimationCueObserver * Observer;
-  std::vector<double>    StartPosition;
-  std::vector<double>    EndPosition;
+  EvaluatedState         Evaluated;
+  vtkMatrix4x4 *         Matrix;
+  double                 AngularVelocity;
+  double                 StartPosition[3];
+  double                 EndPosition[3];
+  KeyframeTrack *        PositionTrack;
+  KeyframeTrack *        OrientationTrack;
+  KeyframeTrack *        ScaleTrack;
+  RenderScheduler *      Scheduler;
+  BroadPhase *           BroadPhaseCollision;
+  int                    BroadPhaseId;
 };
  
 class AnimationSceneObserver : public vtkCommand
@@ -141,26 +455,48 @@ public:
     this->RenderWindow = renWin;
     this->RenderWindow->Register(this);
  
+    }
+  // With a scheduler the scene tick renders through RenderScheduler::Flush,
+  // once per frame and only if something changed.
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
     }
   virtual void Execute(vtkObject *vtkNotUsed(caller),
                        unsigned long event,
                        void *vtkNotUsed(calldata))
     {
-    if(this->RenderWindow != 0)
+    if(this->Scheduler != 0)
+      {
+      if(event == vtkCommand::AnimationCueTickEvent)
+        {
+        this->Scheduler->Flush();
+        }
+      }
+    else if(this->RenderWindow != 0)
       {
       switch(event)
         {
         case vtkCommand::AnimationCueTickEvent:
+          {
+          FRAME_PROFILE_SCOPE("AnimationSceneObserver Render");
           this->RenderWindow->Render();
+          }
           break;
         }
       }
+    // The scene tick event comes after all cues: the frame is complete.
+    if(event == vtkCommand::AnimationCueTickEvent)
+      {
+      FrameProfiler::GetInstance().EndFrame();
+      }
     }
  
 protected:
   AnimationSceneObserver()
     {
     this->RenderWindow = 0;
+    this->Scheduler = 0;
     }
   ~AnimationSceneObserver()
     {
@@ -171,6 +507,7 @@ protected:
       }
     }
   vtkRenderWindow *RenderWindow;
+  RenderScheduler *Scheduler;
 };
  
 #endif
\ No newline at end of file
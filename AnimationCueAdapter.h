@@ -0,0 +1,48 @@
+#ifndef __AnimationCueAdapter_h
+#define __AnimationCueAdapter_h
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+
+// Observer forwarding the events of a cue to any animator with Start,
+// Tick and End taking the cue info. The only virtual call per tick is
+// this Execute; everything below it is resolved at compile time.
+template <class AnimatorType>
+class AnimationCueAdapter : public vtkCommand
+{
+public:
+  static AnimationCueAdapter *New()
+    {
+    return new AnimationCueAdapter;
+    }
+
+  virtual void Execute(vtkObject *vtkNotUsed(caller),
+                       unsigned long event,
+                       void *calldata)
+    {
+    if(this->Animator != 0)
+      {
+      vtkAnimationCue::AnimationCueInfo *info=
+        static_cast<vtkAnimationCue::AnimationCueInfo *>(calldata);
+      switch(event)
+        {
+        case vtkCommand::StartAnimationCueEvent:
+          this->Animator->Start(info);
+          break;
+        case vtkCommand::EndAnimationCueEvent:
+          this->Animator->End(info);
+          break;
+        case vtkCommand::AnimationCueTickEvent:
+          this->Animator->Tick(info);
+          break;
+        }
+      }
+    }
+
+  AnimationCueAdapter()
+    {
+    this->Animator = 0;
+    }
+  AnimatorType *Animator;
+};
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef __AnimatorPool_h
+#define __AnimatorPool_h
+#include <vtkActor.h>
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+#include <new>
+#include <vector>
+
+#include "Animation.h"
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+#include "Pool.h"
+#include "RenderScheduler.h"
+
+// Short-lived animations, as in particle effects, without allocating
+// while playing. Each actor added to the pool is bound for good to an
+// ActorAnimator built in the pool's arena, with its matrix, observer and
+// positions. Spawn hands out an idle one and gives it a life of its own
+// within the pool's single cue; Despawn, or the end of that life, returns
+// it. Both are O(1) and only move indices between two preallocated lists,
+// so once the actors are added the global heap is not touched.
+//
+// Idle actors are hidden and shown again when their life starts. The
+// animators must not be added to a cue themselves.
+//
+//   pool.Reserve(1000);
+//   for (...) pool.AddActor(actor);
+//   pool.AddObserversToCue(cue);
+//   ...
+//   int id = pool.Spawn(0.5);  // from now on, for half a second
+//   if (id >= 0) pool.GetAnimator(id)->SetEndPosition(end);
+class ActorAnimatorPool
+{
+public:
+  ActorAnimatorPool()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->Scheduler = 0;
+    this->Time = 0.0;
+    this->AutoDespawn = true;
+    }
+
+  ~ActorAnimatorPool()
+    {
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    for (size_t i = 0; i < this->Slots.size(); i++)
+      {
+      this->Slots[i].Animator->~ActorAnimator();
+      this->Arena.Free(this->Slots[i].Animator);
+      }
+    }
+
+  // Makes room for count actors, including their animators' observers.
+  void Reserve(size_t count)
+    {
+    this->Arena.Reserve(count);
+    ActorAnimator::GetObserverPool().Reserve(count);
+    this->Slots.reserve(count);
+    this->Live.reserve(count);
+    this->Free.reserve(count);
+    }
+
+  // Binds an actor to a new idle animator and hides it. Returns the id
+  // used by Spawn and Despawn. Allocates unless reserved.
+  int AddActor(vtkActor *actor)
+    {
+    Slot slot;
+    slot.Animator = new (this->Arena.Allocate()) ActorAnimator;
+    slot.Animator->SetActor(actor);
+    slot.Actor = actor;
+    slot.StartTime = slot.EndTime = 0.0;
+    slot.LiveIndex = -1;
+    slot.Started = false;
+    actor->VisibilityOff();
+    int id = static_cast<int>(this->Slots.size());
+    this->Slots.push_back(slot);
+    this->Live.reserve(this->Slots.size());
+    this->Free.reserve(this->Slots.size());
+    this->Free.push_back(id);
+    return id;
+    }
+
+  // Starts the life of an idle animator delay seconds from the current
+  // cue time, lasting duration. Its motion is reset to the defaults of
+  // ActorAnimator, to be set through GetAnimator. Returns -1 when every
+  // animator is live.
+  int Spawn(double duration, double delay = 0.0)
+    {
+    if (this->Free.empty())
+      {
+      return -1;
+      }
+    int id = this->Free.back();
+    this->Free.pop_back();
+    Slot &slot = this->Slots[id];
+    slot.StartTime = this->Time + delay;
+    slot.EndTime = slot.StartTime + duration;
+    slot.Started = false;
+    slot.LiveIndex = static_cast<int>(this->Live.size());
+    this->Live.push_back(id);
+    slot.Animator->ResetMotion();
+    return id;
+    }
+
+  // Ends the life of a live animator early and hides its actor.
+  void Despawn(int id)
+    {
+    Slot &slot = this->Slots[id];
+    if (slot.LiveIndex < 0)
+      {
+      return;
+      }
+    int last = this->Live.back();
+    this->Live[slot.LiveIndex] = last;
+    this->Slots[last].LiveIndex = slot.LiveIndex;
+    this->Live.pop_back();
+    slot.LiveIndex = -1;
+    slot.Actor->VisibilityOff();
+    this->Free.push_back(id);
+    }
+
+  void DespawnAll()
+    {
+    while (!this->Live.empty())
+      {
+      this->Despawn(this->Live.back());
+      }
+    }
+
+  ActorAnimator *GetAnimator(int id)
+    {
+    return this->Slots[id].Animator;
+    }
+  bool IsLive(int id) const
+    {
+    return this->Slots[id].LiveIndex >= 0;
+    }
+  size_t GetNumberOfActors() const
+    {
+    return this->Slots.size();
+    }
+  size_t GetNumberOfLive() const
+    {
+    return this->Live.size();
+    }
+
+  // When on (the default), animators are despawned at the end of their
+  // life; otherwise they stay live, and visible, at their end pose.
+  void SetAutoDespawn(bool autoDespawn)
+    {
+    this->AutoDespawn = autoDespawn;
+    }
+
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    this->Advance(0.0);
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    FRAME_PROFILE_SCOPE("ActorAnimatorPool::Tick");
+    this->Advance(info->AnimationTime - info->StartTime);
+    if (this->Scheduler && !this->Live.empty())
+      {
+      this->Scheduler->RequestRender();
+      }
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    this->Advance(info->EndTime - info->StartTime);
+    }
+
+  // Moves the pool to time seconds into its cue: starts, ticks and ends
+  // the live animators whose life covers it.
+  void Advance(double time)
+    {
+    this->Time = time;
+    // Backwards, so that a despawn only moves an animator already done.
+    for (size_t k = this->Live.size(); k-- > 0;)
+      {
+      int id = this->Live[k];
+      Slot &slot = this->Slots[id];
+      if (time < slot.StartTime)
+        {
+        continue;
+        }
+      vtkAnimationCue::AnimationCueInfo local;
+      local.StartTime = slot.StartTime;
+      local.EndTime = slot.EndTime;
+      local.AnimationTime = time < slot.EndTime ? time : slot.EndTime;
+      local.DeltaTime = 0.0;
+      local.ClockTime = time;
+      if (!slot.Started)
+        {
+        slot.Animator->Start(&local);
+        slot.Actor->VisibilityOn();
+        slot.Started = true;
+        }
+      if (time >= slot.EndTime)
+        {
+        slot.Animator->End(&local);
+        if (this->AutoDespawn)
+          {
+          this->Despawn(id);
+          }
+        }
+      else
+        {
+        slot.Animator->Evaluate(&local);
+        slot.Animator->Commit();
+        }
+      }
+    }
+
+protected:
+  typedef AnimationCueAdapter<ActorAnimatorPool> AnimationCueObserver;
+
+  struct Slot
+    {
+    ActorAnimator * Animator;
+    vtkActor *      Actor;
+    double          StartTime;
+    double          EndTime;
+    int             LiveIndex;
+    bool            Started;
+    };
+
+  AnimationCueObserver *       Observer;
+  RenderScheduler *            Scheduler;
+  ObjectPool<ActorAnimator>    Arena;
+  std::vector<Slot>            Slots;
+  std::vector<int>             Live;
+  std::vector<int>             Free;
+  double                       Time;
+  bool                         AutoDespawn;
+};
+
+#endif
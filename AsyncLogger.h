@@ -0,0 +1,395 @@
+#ifndef __AsyncLogger_h
+#define __AsyncLogger_h
+#include <vtkMatrix4x4.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Message record as queued by the producers: the format is not applied
+// on the calling thread, only the pointer and the values are copied.
+struct AsyncLogRecord
+{
+  enum
+    {
+    MESSAGE = 0,
+    MATRIX
+    };
+  int           Kind;
+  int           Severity;
+  long long     Time;        // ns since the logger was created
+  const char *  Format;      // MESSAGE: printf format; MATRIX: label
+  double        Values[16];
+  unsigned long Suppressed;  // messages dropped by the rate limit before this one
+};
+
+// Lets a message through at most once per interval. One instance per
+// call site, typically a member of the callback that logs.
+class AsyncLogRateLimit
+{
+public:
+  AsyncLogRateLimit(double milliseconds = 1000.0)
+    : Interval(static_cast<long long>(milliseconds * 1.0e6)), Next(0), Suppressed(0)
+    {
+    }
+
+  void SetInterval(double milliseconds)
+    {
+    this->Interval = static_cast<long long>(milliseconds * 1.0e6);
+    }
+
+  // True if a message may be logged at time now (ns); suppressed receives
+  // the number of messages refused since the last one let through.
+  bool Allow(long long now, unsigned long *suppressed)
+    {
+    long long next = this->Next.load(std::memory_order_relaxed);
+    if (now < next ||
+        !this->Next.compare_exchange_strong(next, now + this->Interval, std::memory_order_relaxed))
+      {
+      this->Suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+      }
+    *suppressed = this->Suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+    }
+
+private:
+  long long                  Interval;
+  std::atomic<long long>     Next;
+  std::atomic<unsigned long> Suppressed;
+};
+
+// Logging for callbacks that run on the render thread.
+// Log() checks the severity, copies the format pointer and up to four
+// doubles (or a whole matrix) into a fixed-size record and pushes it on a
+// bounded lock-free queue; it never formats, writes or waits. A background
+// thread formats the records and writes them, flushing once the queue is
+// empty rather than per line. When the queue is full the record is
+// dropped and counted, the drop count is reported with the next record
+// written.
+// Shutdown(), also run when the program exits, writes everything queued.
+// Messages logged after it are written synchronously, under a lock, since
+// the worker or Shutdown may still be writing.
+//
+// Formats must be string literals, with at most four %g/%f/%e style
+// conversions, all taking doubles.
+class AsyncLogger
+{
+public:
+  enum
+    {
+    LOG_DEBUG = 0,
+    LOG_INFO,
+    LOG_WARNING,
+    LOG_ERROR
+    };
+
+  static AsyncLogger &GetInstance()
+    {
+    static AsyncLogger instance;
+    return instance;
+    }
+
+  // Messages below this severity are discarded by the caller.
+  void SetLevel(int severity) { this->Level.store(severity, std::memory_order_relaxed); }
+  int GetLevel() const        { return this->Level.load(std::memory_order_relaxed); }
+  bool IsEnabled(int severity) const
+    {
+    return severity >= this->Level.load(std::memory_order_relaxed);
+    }
+
+  // Where the worker writes, stdout by default. Set before logging.
+  void SetOutput(FILE *file)  { this->Output = file; }
+  bool SetOutputFileName(const std::string &fileName)
+    {
+    FILE *file = fopen(fileName.c_str(), "w");
+    if (!file)
+      {
+      return false;
+      }
+    this->Output = file;
+    this->OwnsOutput = true;
+    return true;
+    }
+
+  void Log(int severity, const char *format,
+           double a = 0, double b = 0, double c = 0, double d = 0)
+    {
+    if (!this->IsEnabled(severity))
+      {
+      return;
+      }
+    AsyncLogRecord record;
+    this->Fill(record, AsyncLogRecord::MESSAGE, severity, format, 0);
+    record.Values[0] = a;
+    record.Values[1] = b;
+    record.Values[2] = c;
+    record.Values[3] = d;
+    this->Push(record);
+    }
+
+  // Same as Log, dropped if limit let a message through less than its
+  // interval ago.
+  void Log(AsyncLogRateLimit &limit, int severity, const char *format,
+           double a = 0, double b = 0, double c = 0, double d = 0)
+    {
+    unsigned long suppressed = 0;
+    if (!this->IsEnabled(severity) || !limit.Allow(this->Now(), &suppressed))
+      {
+      return;
+      }
+    AsyncLogRecord record;
+    this->Fill(record, AsyncLogRecord::MESSAGE, severity, format, suppressed);
+    record.Values[0] = a;
+    record.Values[1] = b;
+    record.Values[2] = c;
+    record.Values[3] = d;
+    this->Push(record);
+    }
+
+  // Logs the 16 elements of a matrix, written as 4 rows under label.
+  void LogMatrix(int severity, const char *label, vtkMatrix4x4 *matrix)
+    {
+    if (!this->IsEnabled(severity))
+      {
+      return;
+      }
+    AsyncLogRecord record;
+    this->Fill(record, AsyncLogRecord::MATRIX, severity, label, 0);
+    for (int i = 0; i < 4; i++)
+      {
+      for (int j = 0; j < 4; j++)
+        {
+        record.Values[4 * i + j] = matrix->GetElement(i, j);
+        }
+      }
+    this->Push(record);
+    }
+
+  // Stops the worker after it wrote every queued record and flushes the
+  // output. Safe to call more than once.
+  void Shutdown()
+    {
+    if (!this->Worker.joinable())
+      {
+      return;
+      }
+    this->Done.store(true);
+    this->Worker.join();
+    // A producer that saw Done still false may still be pushing, or may
+    // have pushed after the worker's last pass. Wait for it to publish.
+    while (this->Producers.load() != 0)
+      {
+      std::this_thread::yield();
+      }
+    AsyncLogRecord record;
+    while (this->Pop(record))
+      {
+      this->Write(record);
+      }
+    fflush(this->Output);
+    }
+
+  // Records refused because the queue was full.
+  unsigned long GetNumberOfDropped() const
+    {
+    return this->Dropped.load(std::memory_order_relaxed);
+    }
+
+protected:
+  // One slot of the queue. Sequence tells producers and the consumer
+  // whose turn the slot is (bounded MPMC queue after D. Vyukov, used
+  // here with a single consumer).
+  struct Cell
+    {
+    std::atomic<unsigned long long> Sequence;
+    AsyncLogRecord                  Record;
+    };
+
+  AsyncLogger()
+    : Level(LOG_INFO), EnqueuePosition(0), DequeuePosition(0), Done(false), Producers(0),
+      Dropped(0)
+    {
+    this->Origin = std::chrono::steady_clock::now();
+    this->Output = stdout;
+    this->OwnsOutput = false;
+    this->Size = 4096;
+    this->Cells.reset(new Cell[this->Size]);
+    for (unsigned long long i = 0; i < this->Size; i++)
+      {
+      this->Cells[i].Sequence.store(i, std::memory_order_relaxed);
+      }
+    this->ReportedDropped = 0;
+    this->Worker = std::thread(&AsyncLogger::Work, this);
+    }
+
+  ~AsyncLogger()
+    {
+    this->Shutdown();
+    if (this->OwnsOutput)
+      {
+      fclose(this->Output);
+      }
+    }
+
+  long long Now() const
+    {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - this->Origin).count();
+    }
+
+  void Fill(AsyncLogRecord &record, int kind, int severity, const char *format,
+            unsigned long suppressed) const
+    {
+    record.Kind = kind;
+    record.Severity = severity;
+    record.Time = this->Now();
+    record.Format = format;
+    record.Suppressed = suppressed;
+    }
+
+  // Producers counts the pushes in progress; it is raised before Done is
+  // read and Shutdown reads it after setting Done (both sequentially
+  // consistent), so either the producer sees Done or Shutdown waits for
+  // its record.
+  void Push(const AsyncLogRecord &record)
+    {
+    this->Producers.fetch_add(1);
+    if (this->Done.load())
+      {
+      this->Producers.fetch_sub(1, std::memory_order_release);
+      this->Write(record);
+      return;
+      }
+    unsigned long long position = this->EnqueuePosition.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;)
+      {
+      cell = &this->Cells[position & (this->Size - 1)];
+      unsigned long long sequence = cell->Sequence.load(std::memory_order_acquire);
+      long long difference = static_cast<long long>(sequence - position);
+      if (difference == 0)
+        {
+        if (this->EnqueuePosition.compare_exchange_weak(position, position + 1,
+                                                        std::memory_order_relaxed))
+          {
+          break;
+          }
+        }
+      else if (difference < 0)
+        {
+        this->Dropped.fetch_add(1, std::memory_order_relaxed);
+        this->Producers.fetch_sub(1, std::memory_order_release);
+        return;
+        }
+      else
+        {
+        position = this->EnqueuePosition.load(std::memory_order_relaxed);
+        }
+      }
+    cell->Record = record;
+    cell->Sequence.store(position + 1, std::memory_order_release);
+    this->Producers.fetch_sub(1, std::memory_order_release);
+    }
+
+  bool Pop(AsyncLogRecord &record)
+    {
+    Cell *cell = &this->Cells[this->DequeuePosition & (this->Size - 1)];
+    if (cell->Sequence.load(std::memory_order_acquire) != this->DequeuePosition + 1)
+      {
+      return false;
+      }
+    record = cell->Record;
+    cell->Sequence.store(this->DequeuePosition + this->Size, std::memory_order_release);
+    this->DequeuePosition++;
+    return true;
+    }
+
+  void Work()
+    {
+    AsyncLogRecord record;
+    for (;;)
+      {
+      // Read Done first: anything pushed before it was set is drained by
+      // the loop below.
+      bool done = this->Done.load(std::memory_order_acquire);
+      bool wrote = false;
+      while (this->Pop(record))
+        {
+        this->Write(record);
+        wrote = true;
+        }
+      if (wrote)
+        {
+        fflush(this->Output);
+        }
+      if (done)
+        {
+        break;
+        }
+      if (!wrote)
+        {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+      }
+    }
+
+  // Run by the worker, by Shutdown and by producers once Done is set, so
+  // possibly by several threads at once.
+  void Write(const AsyncLogRecord &record)
+    {
+    static const char *names[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+    std::lock_guard<std::mutex> lock(this->WriteMutex);
+    int severity = record.Severity < LOG_DEBUG ? LOG_DEBUG :
+      (record.Severity > LOG_ERROR ? LOG_ERROR : record.Severity);
+    unsigned long dropped = this->Dropped.load(std::memory_order_relaxed);
+    if (dropped != this->ReportedDropped)
+      {
+      fprintf(this->Output, "[log] %lu messages dropped, queue full\n", dropped - this->ReportedDropped);
+      this->ReportedDropped = dropped;
+      }
+    fprintf(this->Output, "[%10.4f] %-7s ", record.Time * 1.0e-9, names[severity]);
+    if (record.Kind == AsyncLogRecord::MATRIX)
+      {
+      fprintf(this->Output, "%s:\n", record.Format);
+      for (int i = 0; i < 4; i++)
+        {
+        fprintf(this->Output, "    %g %g %g %g\n", record.Values[4 * i], record.Values[4 * i + 1],
+                record.Values[4 * i + 2], record.Values[4 * i + 3]);
+        }
+      }
+    else
+      {
+      fprintf(this->Output, record.Format, record.Values[0], record.Values[1],
+              record.Values[2], record.Values[3]);
+      if (record.Suppressed)
+        {
+        fprintf(this->Output, " (%lu similar suppressed)", record.Suppressed);
+        }
+      fputc('\n', this->Output);
+      }
+    }
+
+  std::chrono::steady_clock::time_point Origin;
+  std::atomic<int>                      Level;
+  FILE *                                Output;
+  bool                                  OwnsOutput;
+  unsigned long long                    Size;
+  std::unique_ptr<Cell[]>               Cells;
+  std::atomic<unsigned long long>       EnqueuePosition;
+  // Only used by the worker, then by Shutdown.
+  unsigned long long                    DequeuePosition;
+  std::atomic<bool>                     Done;
+  std::atomic<int>                      Producers;
+  std::atomic<unsigned long>            Dropped;
+  // Guards Output and ReportedDropped in Write.
+  std::mutex                            WriteMutex;
+  unsigned long                         ReportedDropped;
+  std::thread                           Worker;
+};
+
+#endif
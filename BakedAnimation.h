@@ -0,0 +1,499 @@
+#ifndef __BakedAnimation_h
+#define __BakedAnimation_h
+#include <vtkActor.h>
+#include <vtkAnimationCue.h>
+#include <vtkAnimationScene.h>
+#include <vtkCommand.h>
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+#include "RenderScheduler.h"
+
+// Layout of a baked animation file, in the byte order of the machine that
+// wrote it (a file from the other byte order fails the version check):
+//
+//   BakedAnimationHeader
+//   NumberOfTracks x unsigned long long: byte offset of each track
+//   tracks, each NumberOfFrames x 16 float32, a row-major 4x4 matrix per
+//   frame, starting on a 64-byte boundary
+//
+// Frame i is the state at StartTime + i / FrameRate, the last frame the
+// state at EndTime, the same frames SequenceRenderer renders.
+struct BakedAnimationHeader
+{
+  char         Magic[8];
+  unsigned int Version;
+  unsigned int NumberOfTracks;
+  unsigned int NumberOfFrames;
+  unsigned int Reserved;
+  double       StartTime;
+  double       EndTime;
+  double       FrameRate;
+};
+
+static const char BakedAnimationMagic[8] = {'V', 'T', 'K', 'B', 'A', 'K', 'E', '\0'};
+static const unsigned int BakedAnimationVersion = 1;
+
+// Samples the full matrix of each actor at every frame of a scene and
+// writes them to a baked animation file. The scene is played in sequence
+// mode with whatever animators are attached to its cues; the tracks are
+// kept in memory until Write.
+class AnimationBaker
+{
+public:
+  AnimationBaker()
+    {
+    this->Scene = 0;
+    this->NumberOfFrames = 0;
+    }
+
+  ~AnimationBaker()
+    {
+    for (size_t a = 0; a < this->Actors.size(); a++)
+      {
+      this->Actors[a]->UnRegister(0);
+      }
+    }
+
+  void SetScene(vtkAnimationScene *scene) { this->Scene = scene; }
+
+  // Adds an actor to bake and returns its track index, the index to bind
+  // it to in BakedAnimationPlayer::SetActor.
+  size_t AddActor(vtkActor *actor)
+    {
+    actor->Register(0);
+    this->Actors.push_back(actor);
+    return this->Actors.size() - 1;
+    }
+
+  // Plays the scene and records every frame.
+  void Bake()
+    {
+    this->StartTime = this->Scene->GetStartTime();
+    this->EndTime = this->Scene->GetEndTime();
+    this->FrameRate = this->Scene->GetFrameRate();
+    this->NumberOfFrames = static_cast<int>((this->EndTime - this->StartTime) * this->FrameRate + 0.5) + 1;
+
+    this->Tracks.assign(this->Actors.size(), std::vector<float>());
+    for (size_t a = 0; a < this->Actors.size(); a++)
+      {
+      this->Tracks[a].resize(16 * static_cast<size_t>(this->NumberOfFrames));
+      }
+
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    this->Scene->SetModeToSequence();
+    this->Scene->Initialize();
+    for (int i = 0; i < this->NumberOfFrames; i++)
+      {
+      double time = i + 1 < this->NumberOfFrames ? this->StartTime + i / this->FrameRate : this->EndTime;
+      this->Scene->Tick(time, i ? 1.0 / this->FrameRate : 0.0, time);
+      for (size_t a = 0; a < this->Actors.size(); a++)
+        {
+        this->Actors[a]->GetMatrix(matrix);
+        float *out = &this->Tracks[a][16 * static_cast<size_t>(i)];
+        const double *in = &matrix->Element[0][0];
+        for (int k = 0; k < 16; k++)
+          {
+          out[k] = static_cast<float>(in[k]);
+          }
+        }
+      }
+    this->Scene->Finalize();
+    }
+
+  int GetNumberOfFrames() const { return this->NumberOfFrames; }
+
+  // Writes the tracks recorded by the last Bake. Returns false if the file
+  // could not be written.
+  bool Write(const std::string &fileName)
+    {
+    FILE *file = fopen(fileName.c_str(), "wb");
+    if (!file)
+      {
+      return false;
+      }
+    BakedAnimationHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Magic, BakedAnimationMagic, sizeof(header.Magic));
+    header.Version = BakedAnimationVersion;
+    header.NumberOfTracks = static_cast<unsigned int>(this->Tracks.size());
+    header.NumberOfFrames = static_cast<unsigned int>(this->NumberOfFrames);
+    header.StartTime = this->StartTime;
+    header.EndTime = this->EndTime;
+    header.FrameRate = this->FrameRate;
+
+    const unsigned long long trackSize = 16 * sizeof(float) * static_cast<unsigned long long>(this->NumberOfFrames);
+    std::vector<unsigned long long> offsets(this->Tracks.size());
+    unsigned long long offset = sizeof(header) + offsets.size() * sizeof(unsigned long long);
+    for (size_t a = 0; a < offsets.size(); a++)
+      {
+      offset = (offset + 63) & ~63ULL;
+      offsets[a] = offset;
+      offset += trackSize;
+      }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && !offsets.empty())
+      {
+      ok = fwrite(&offsets[0], sizeof(unsigned long long), offsets.size(), file) == offsets.size();
+      }
+    static const char padding[64] = {0};
+    unsigned long long written = sizeof(header) + offsets.size() * sizeof(unsigned long long);
+    for (size_t a = 0; ok && a < this->Tracks.size(); a++)
+      {
+      ok = fwrite(padding, 1, offsets[a] - written, file) == offsets[a] - written &&
+           fwrite(&this->Tracks[a][0], 1, trackSize, file) == trackSize;
+      written = offsets[a] + trackSize;
+      }
+    ok = fclose(file) == 0 && ok;
+    return ok;
+    }
+
+protected:
+  vtkAnimationScene *             Scene;
+  std::vector<vtkActor*>          Actors;
+  std::vector<std::vector<float> > Tracks;
+  int                             NumberOfFrames;
+  double                          StartTime;
+  double                          EndTime;
+  double                          FrameRate;
+};
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+  MappedFile()
+    {
+    this->Data = 0;
+    this->Size = 0;
+#ifdef _WIN32
+    this->File = INVALID_HANDLE_VALUE;
+    this->Mapping = 0;
+#endif
+    }
+
+  ~MappedFile()
+    {
+    this->Close();
+    }
+
+  bool Open(const std::string &fileName)
+    {
+    this->Close();
+#ifdef _WIN32
+    this->File = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (this->File == INVALID_HANDLE_VALUE)
+      {
+      return false;
+      }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(this->File, &size) || size.QuadPart == 0)
+      {
+      this->Close();
+      return false;
+      }
+    this->Mapping = CreateFileMappingA(this->File, 0, PAGE_READONLY, 0, 0, 0);
+    if (this->Mapping)
+      {
+      this->Data = static_cast<const char*>(MapViewOfFile(this->Mapping, FILE_MAP_READ, 0, 0, 0));
+      }
+    if (!this->Data)
+      {
+      this->Close();
+      return false;
+      }
+    this->Size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+      {
+      return false;
+      }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0)
+      {
+      close(fd);
+      return false;
+      }
+    void *data = mmap(0, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file referenced.
+    close(fd);
+    if (data == MAP_FAILED)
+      {
+      return false;
+      }
+    this->Data = static_cast<const char*>(data);
+    this->Size = static_cast<size_t>(status.st_size);
+#endif
+    return true;
+    }
+
+  void Close()
+    {
+#ifdef _WIN32
+    if (this->Data)
+      {
+      UnmapViewOfFile(this->Data);
+      }
+    if (this->Mapping)
+      {
+      CloseHandle(this->Mapping);
+      }
+    if (this->File != INVALID_HANDLE_VALUE)
+      {
+      CloseHandle(this->File);
+      }
+    this->File = INVALID_HANDLE_VALUE;
+    this->Mapping = 0;
+#else
+    if (this->Data)
+      {
+      munmap(const_cast<char*>(this->Data), this->Size);
+      }
+#endif
+    this->Data = 0;
+    this->Size = 0;
+    }
+
+  const char *GetData() const { return this->Data; }
+  size_t GetSize() const      { return this->Size; }
+
+protected:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+  const char * Data;
+  size_t       Size;
+#ifdef _WIN32
+  HANDLE       File;
+  HANDLE       Mapping;
+#endif
+};
+
+// Replays a baked animation file on a cue in place of the animators that
+// were baked. The file is memory mapped, so opening it reads only the
+// header and the offset table; each tick picks the frame for the cue time
+// and copies its 16 floats into the user matrix of each bound actor, with
+// no interpolation. The pages of a track are loaded by the OS as they are
+// first touched.
+class BakedAnimationPlayer
+{
+public:
+  BakedAnimationPlayer()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->Scheduler = 0;
+    this->Header = 0;
+    this->Offsets = 0;
+    this->CurrentFrame = -1;
+    }
+
+  ~BakedAnimationPlayer()
+    {
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    this->RemoveAllActors();
+    }
+
+  // Maps the file and checks its header and offsets. Returns false if the
+  // file cannot be mapped or is not a baked animation of this version.
+  bool Open(const std::string &fileName)
+    {
+    this->Close();
+    if (!this->File.Open(fileName))
+      {
+      return false;
+      }
+    const size_t size = this->File.GetSize();
+    const BakedAnimationHeader *header = reinterpret_cast<const BakedAnimationHeader*>(this->File.GetData());
+    if (size < sizeof(BakedAnimationHeader) ||
+        memcmp(header->Magic, BakedAnimationMagic, sizeof(header->Magic)) != 0 ||
+        header->Version != BakedAnimationVersion ||
+        header->NumberOfFrames == 0 ||
+        (size - sizeof(BakedAnimationHeader)) / sizeof(unsigned long long) < header->NumberOfTracks)
+      {
+      this->File.Close();
+      return false;
+      }
+    const unsigned long long *offsets = reinterpret_cast<const unsigned long long*>(header + 1);
+    const unsigned long long trackSize = 16 * sizeof(float) * static_cast<unsigned long long>(header->NumberOfFrames);
+    for (unsigned int a = 0; a < header->NumberOfTracks; a++)
+      {
+      if (offsets[a] % sizeof(float) || offsets[a] > size || size - offsets[a] < trackSize)
+        {
+        this->File.Close();
+        return false;
+        }
+      }
+    this->Header = header;
+    this->Offsets = offsets;
+    this->CurrentFrame = -1;
+    return true;
+    }
+
+  void Close()
+    {
+    this->File.Close();
+    this->Header = 0;
+    this->Offsets = 0;
+    this->CurrentFrame = -1;
+    }
+
+  bool IsOpen() const { return this->Header != 0; }
+
+  int GetNumberOfTracks() const   { return this->Header ? static_cast<int>(this->Header->NumberOfTracks) : 0; }
+  int GetNumberOfFrames() const   { return this->Header ? static_cast<int>(this->Header->NumberOfFrames) : 0; }
+  double GetStartTime() const     { return this->Header ? this->Header->StartTime : 0.0; }
+  double GetEndTime() const       { return this->Header ? this->Header->EndTime : 0.0; }
+  double GetFrameRate() const     { return this->Header ? this->Header->FrameRate : 0.0; }
+
+  // The 16 floats of a frame, row major, pointing into the mapping.
+  const float *GetMatrix(int track, int frame) const
+    {
+    return reinterpret_cast<const float*>(this->File.GetData() + this->Offsets[track]) + 16 * frame;
+    }
+
+  // Drives actor from track. The actor's position, orientation, scale and
+  // origin are reset so that its user matrix is its whole transform.
+  void SetActor(int track, vtkActor *actor)
+    {
+    if (static_cast<size_t>(track) >= this->Actors.size())
+      {
+      this->Actors.resize(track + 1, 0);
+      this->Matrices.resize(track + 1);
+      }
+    if (this->Actors[track])
+      {
+      this->Actors[track]->UnRegister(0);
+      }
+    this->Actors[track] = actor;
+    if (actor)
+      {
+      actor->Register(0);
+      this->Matrices[track] = vtkSmartPointer<vtkMatrix4x4>::New();
+      actor->SetPosition(0.0, 0.0, 0.0);
+      actor->SetOrientation(0.0, 0.0, 0.0);
+      actor->SetScale(1.0);
+      actor->SetOrigin(0.0, 0.0, 0.0);
+      actor->SetUserMatrix(this->Matrices[track]);
+      }
+    this->CurrentFrame = -1;
+    }
+
+  void RemoveAllActors()
+    {
+    for (size_t a = 0; a < this->Actors.size(); a++)
+      {
+      if (this->Actors[a])
+        {
+        this->Actors[a]->UnRegister(0);
+        }
+      }
+    this->Actors.clear();
+    this->Matrices.clear();
+    }
+
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    }
+
+  // Frame closest to a time since the start of the baked scene, which is
+  // what a cue in relative time mode (the default) reports, clamped to the
+  // baked range.
+  int GetFrame(double time) const
+    {
+    double frame = time * this->Header->FrameRate + 0.5;
+    int last = static_cast<int>(this->Header->NumberOfFrames) - 1;
+    return frame <= 0.0 ? 0 : (frame >= last ? last : static_cast<int>(frame));
+    }
+
+  // Copies a frame into the bound actors' matrices. Does nothing if the
+  // frame is the one already applied.
+  void ApplyFrame(int frame)
+    {
+    if (!this->Header || frame == this->CurrentFrame)
+      {
+      return;
+      }
+    const size_t tracks = this->Header->NumberOfTracks;
+    for (size_t a = 0; a < this->Actors.size() && a < tracks; a++)
+      {
+      if (!this->Actors[a])
+        {
+        continue;
+        }
+      const float *in = this->GetMatrix(static_cast<int>(a), frame);
+      double *out = &this->Matrices[a]->Element[0][0];
+      for (int k = 0; k < 16; k++)
+        {
+        out[k] = in[k];
+        }
+      this->Matrices[a]->Modified();
+      }
+    this->CurrentFrame = frame;
+    if (this->Scheduler)
+      {
+      this->Scheduler->RequestRender();
+      }
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    this->ApplyFrame(0);
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    FRAME_PROFILE_SCOPE("BakedAnimationPlayer::Tick");
+    if (this->Header)
+      {
+      this->ApplyFrame(this->GetFrame(info->AnimationTime));
+      }
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    this->ApplyFrame(this->GetNumberOfFrames() - 1);
+    }
+
+protected:
+  typedef AnimationCueAdapter<BakedAnimationPlayer> AnimationCueObserver;
+
+  AnimationCueObserver *                     Observer;
+  RenderScheduler *                          Scheduler;
+  MappedFile                                 File;
+  const BakedAnimationHeader *               Header;
+  const unsigned long long *                 Offsets;
+  std::vector<vtkActor*>                     Actors;
+  std::vector<vtkSmartPointer<vtkMatrix4x4> > Matrices;
+  int                                        CurrentFrame;
+};
+
+#endif
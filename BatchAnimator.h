@@ -0,0 +1,207 @@
+#ifndef __BatchAnimator_h
+#define __BatchAnimator_h
+#include <vtkActor.h>
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+#include <cmath>
+#include <vector>
+
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+#include "RenderScheduler.h"
+
+// Animates any number of actors from a single cue.
+// Where ActorAnimator needs one observer per actor, BatchActorAnimator keeps
+// the per-actor state in contiguous arrays (structure of arrays) and
+// evaluates every actor in one pass per tick. The interpolation loop only
+// touches plain doubles so the compiler can vectorize it; the actors are
+// visited once afterwards to receive the results. Like ActorAnimator, the
+// pose is a function of the cue time alone, so it does not depend on how
+// many ticks fired.
+class BatchActorAnimator
+{
+public:
+  BatchActorAnimator()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->Scheduler = 0;
+    }
+
+  ~BatchActorAnimator()
+    {
+    this->RemoveAllActors();
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // Adds an actor to the batch and returns its index.
+  // angularVelocity is the spin around X in degrees per second.
+  size_t AddActor(vtkActor *actor, const double start[3], const double end[3],
+                  double angularVelocity = 20.0)
+    {
+    actor->Register(0);
+    this->Actors.push_back(actor);
+    for (int i = 0; i < 3; i++)
+      {
+      this->StartPosition[i].push_back(start[i]);
+      this->Displacement[i].push_back(end[i] - start[i]);
+      this->Position[i].push_back(start[i]);
+      }
+    this->AngularVelocity.push_back(angularVelocity);
+    return this->Actors.size() - 1;
+    }
+
+  void RemoveAllActors()
+    {
+    for (size_t a = 0; a < this->Actors.size(); a++)
+      {
+      this->Actors[a]->UnRegister(0);
+      }
+    this->Actors.clear();
+    for (int i = 0; i < 3; i++)
+      {
+      this->StartPosition[i].clear();
+      this->Displacement[i].clear();
+      this->Position[i].clear();
+      }
+    this->AngularVelocity.clear();
+    }
+
+  // Reserves storage so that adding actors does not reallocate.
+  void Reserve(size_t count)
+    {
+    this->Actors.reserve(count);
+    for (int i = 0; i < 3; i++)
+      {
+      this->StartPosition[i].reserve(count);
+      this->Displacement[i].reserve(count);
+      this->Position[i].reserve(count);
+      }
+    this->AngularVelocity.reserve(count);
+    }
+
+  size_t GetNumberOfActors() const
+    {
+    return this->Actors.size();
+    }
+
+  vtkActor *GetActor(size_t index) const
+    {
+    return this->Actors[index];
+    }
+
+  void SetStartPosition(size_t index, const double position[3])
+    {
+    for (int i = 0; i < 3; i++)
+      {
+      double end = this->StartPosition[i][index] + this->Displacement[i][index];
+      this->StartPosition[i][index] = position[i];
+      this->Displacement[i][index] = end - position[i];
+      }
+    }
+
+  void SetEndPosition(size_t index, const double position[3])
+    {
+    for (int i = 0; i < 3; i++)
+      {
+      this->Displacement[i][index] = position[i] - this->StartPosition[i][index];
+      }
+    }
+
+  void SetAngularVelocity(size_t index, double degreesPerSecond)
+    {
+    this->AngularVelocity[index] = degreesPerSecond;
+    }
+
+  // Last evaluated position of an actor.
+  void GetPosition(size_t index, double position[3]) const
+    {
+    for (int i = 0; i < 3; i++)
+      {
+      position[i] = this->Position[i][index];
+      }
+    }
+
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    }
+
+  // Computes the positions of all actors at normalized time t (0..1)
+  // without touching the actors.
+  void Evaluate(double t)
+    {
+    const size_t n = this->Actors.size();
+    for (int i = 0; i < 3; i++)
+      {
+      const double *start = n ? &this->StartPosition[i][0] : 0;
+      const double *displacement = n ? &this->Displacement[i][0] : 0;
+      double *position = n ? &this->Position[i][0] : 0;
+      for (size_t a = 0; a < n; a++)
+        {
+        position[a] = start[a] + displacement[a] * t;
+        }
+      }
+    }
+
+  // Pushes the last evaluated positions to the actors, along with their
+  // orientations time seconds into the cue.
+  void Apply(double time)
+    {
+    const size_t n = this->Actors.size();
+    for (size_t a = 0; a < n; a++)
+      {
+      vtkActor *actor = this->Actors[a];
+      actor->SetPosition(this->Position[0][a],
+                         this->Position[1][a],
+                         this->Position[2][a]);
+      actor->SetOrientation(fmod(this->AngularVelocity[a] * time, 360.0), 0.0, 0.0);
+      }
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    this->Evaluate(0.0);
+    this->Apply(0.0);
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    FRAME_PROFILE_SCOPE("BatchActorAnimator::Tick");
+    double time = info->AnimationTime - info->StartTime;
+    double duration = info->EndTime - info->StartTime;
+    this->Evaluate(duration > 0 ? time / duration : 0.0);
+    this->Apply(time);
+    if (this->Scheduler)
+      {
+      this->Scheduler->RequestRender();
+      }
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    this->Evaluate(1.0);
+    this->Apply(info->EndTime - info->StartTime);
+    }
+
+protected:
+  typedef AnimationCueAdapter<BatchActorAnimator> AnimationCueObserver;
+
+  AnimationCueObserver * Observer;
+  RenderScheduler *      Scheduler;
+  std::vector<vtkActor*> Actors;
+  std::vector<double>    StartPosition[3];
+  std::vector<double>    Displacement[3];
+  std::vector<double>    Position[3];
+  std::vector<double>    AngularVelocity;
+};
+
+#endif
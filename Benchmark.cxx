@@ -0,0 +1,2584 @@
+#include <vtkActor.h>
+#include <vtkAnimationCue.h>
+#include <vtkAnimationScene.h>
+#include <vtkCamera.h>
+#include <vtkCommand.h>
+#include <vtkCellLocator.h>
+#include <vtkCellPicker.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkPolyDataWriter.h>
+#include <vtkProperty.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+
+#include "Animation.h"
+#include "AnimatorPool.h"
+#include "BakedAnimation.h"
+#include "BatchAnimator.h"
+#include "BroadPhase.h"
+#include "CueScheduler.h"
+#include "DeformationAnimator.h"
+#include "FrameBudget.h"
+#include "InstancedAnimator.h"
+#include "MeshIntersection.h"
+#include "MeshSequence.h"
+#include "ParallelAnimation.h"
+#include "Picking.h"
+#include "RayIntersection.h"
+#include "SceneLoader.h"
+#include "SimulationThread.h"
+#include "TemplateAnimator.h"
+#include "VisibilityCulling.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/*
+Benchmarks for the animation code, built by the Benchmark target of
+CMakeLists.txt. No window is opened: the cues are ticked directly and
+anything rendered goes to an offscreen window. Run without arguments to
+run everything (this is also what ctest runs), or pass the name of a
+single benchmark:
+
+	Benchmark batch
+	Benchmark broadphase
+	Benchmark rays
+	Benchmark instancing
+	Benchmark baked
+	Benchmark parallel [-actors N] [-keys K] [-threads T]
+	Benchmark meshes [-timesteps N] [-resolution R] [-fps F]
+	Benchmark deform [-vertices N] [-targets K] [-threads T]
+	Benchmark picking [-actors N] [-picks P]
+	Benchmark templates [-items N]
+	Benchmark spawn [-actors N] [-frames F]
+	Benchmark sceneload [-objects N] [-meshes D]
+	Benchmark cues [-cues N] [-ticks T]
+	Benchmark culling [-actors N] [-ticks T]
+	Benchmark budget [-actors N] [-frames F] [-budget MS]
+	Benchmark simulation [-actors N] [-rate HZ] [-render MS]
+	Benchmark scene [-actors N] [-cues M] [-resolution R] [-opacity O]
+	                [-frames F] [-intersection] [-csv]
+
+"scene" plays a generated vtkAnimationScene in sequence mode and prints
+percentiles of the per-frame tick, update and render times as JSON, or
+as one CSV line with -csv, for tracking across versions.
+
+"scene -intersection" also checks that an empty mesh is intersected
+twice without reusing a contact set and that an update with nothing
+moved leaves the output alone, "spawn" that pooled animators do
+not allocate while playing, "cues" and "culling" that their results match plain ticking,
+"budget" that the governed frame time holds the budget, "simulation"
+that snapshots are never torn and poses are interpolated exactly; the
+exit status is nonzero when a check fails.
+*/
+
+static int Failures = 0;
+
+//***************************************************************
+// Every allocation through operator new is counted, so benchmarks can
+// check what allocates while playing.
+static std::atomic<long> HeapAllocations(0);
+
+void *operator new(size_t size)
+{
+  HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+  void *pointer = malloc(size ? size : 1);
+  if (!pointer)
+    {
+    throw std::bad_alloc();
+    }
+  return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+  free(pointer);
+}
+
+//***************************************************************
+// Ticks a cue the same way vtkAnimationScene does and returns the
+// average time of one tick in microseconds.
+static double TimeCueTicks(vtkAnimationCue *cue, int ticks)
+{
+  cue->Initialize();
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int i = 0; i < ticks; i++)
+    {
+    double time = cue->GetStartTime() +
+      (cue->GetEndTime() - cue->GetStartTime()) * i / ticks;
+    cue->Tick(time, 0, time);
+    }
+  double elapsed = vtkTimerLog::GetUniversalTime() - start;
+  cue->Finalize();
+  return elapsed * 1.0e6 / ticks;
+}
+//***************************************************************
+// Ticks the cue and renders after every tick, as the scene observer
+// does. Returns the average time of one frame in microseconds.
+static double TimeRenderedFrames(vtkAnimationCue *cue, vtkRenderWindow *renderWindow, int frames)
+{
+  cue->Initialize();
+  renderWindow->Render();
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int i = 0; i < frames; i++)
+    {
+    double time = cue->GetStartTime() +
+      (cue->GetEndTime() - cue->GetStartTime()) * i / frames;
+    cue->Tick(time, 0, time);
+    renderWindow->Render();
+    }
+  double elapsed = vtkTimerLog::GetUniversalTime() - start;
+  cue->Finalize();
+  return elapsed * 1.0e6 / frames;
+}
+//***************************************************************
+// One ActorAnimator (and observer) per actor against a single
+// BatchActorAnimator for all of them, both driven by one cue.
+static void BenchmarkBatchAnimator()
+{
+  const int counts[] = {10, 100, 1000, 10000};
+  const int ticks = 50;
+  double start[3] = {2, 1, 1};
+  double end[3] = {-1, -1, -1};
+
+  cout << "batch: actors, ActorAnimator us/tick, BatchActorAnimator us/tick" << endl;
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+    int count = counts[c];
+    std::vector<vtkSmartPointer<vtkActor> > actors(count);
+    for (int i = 0; i < count; i++)
+      {
+      actors[i] = vtkSmartPointer<vtkActor>::New();
+      }
+
+    vtkSmartPointer<vtkAnimationCue> perActorCue = vtkSmartPointer<vtkAnimationCue>::New();
+    perActorCue->SetStartTime(0);
+    perActorCue->SetEndTime(5);
+    std::vector<ActorAnimator*> animators(count);
+    std::vector<double> startPos(start, start + 3), endPos(end, end + 3);
+    for (int i = 0; i < count; i++)
+      {
+      animators[i] = new ActorAnimator;
+      animators[i]->SetActor(actors[i]);
+      animators[i]->SetStartPosition(startPos);
+      animators[i]->SetEndPosition(endPos);
+      animators[i]->AddObserversToCue(perActorCue);
+      }
+    double perActor = TimeCueTicks(perActorCue, ticks);
+    for (int i = 0; i < count; i++)
+      {
+      delete animators[i];
+      }
+
+    vtkSmartPointer<vtkAnimationCue> batchCue = vtkSmartPointer<vtkAnimationCue>::New();
+    batchCue->SetStartTime(0);
+    batchCue->SetEndTime(5);
+    BatchActorAnimator batch;
+    batch.Reserve(count);
+    for (int i = 0; i < count; i++)
+      {
+      batch.AddActor(actors[i], start, end);
+      }
+    batch.AddObserversToCue(batchCue);
+    double batched = TimeCueTicks(batchCue, ticks);
+
+    cout << count << ", " << perActor << ", " << batched << endl;
+    }
+}
+//***************************************************************
+// Unit boxes scattered at constant density, all of them moving a little
+// every frame. Reports the time of BroadPhase::Update per frame and, for
+// the smallest scene, checks the pairs against testing every pair.
+static void BenchmarkBroadPhase()
+{
+  const int counts[] = {1000, 10000, 100000};
+  const int frames = 20;
+  double modelBounds[6] = {-0.5, 0.5, -0.5, 0.5, -0.5, 0.5};
+
+  cout << "broadphase: actors, us/frame, pairs/frame, brute force pairs" << endl;
+  srand(1);
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+    int count = counts[c];
+    double side = 3.0 * pow(static_cast<double>(count), 1.0 / 3.0);
+    std::vector<vtkSmartPointer<vtkActor> > actors(count);
+    std::vector<double> position(3 * count);
+    BroadPhase broadPhase;
+    for (int i = 0; i < count; i++)
+      {
+      actors[i] = vtkSmartPointer<vtkActor>::New();
+      for (int k = 0; k < 3; k++)
+        {
+        position[3 * i + k] = side * rand() / RAND_MAX;
+        }
+      actors[i]->SetPosition(&position[3 * i]);
+      broadPhase.AddActor(actors[i], modelBounds);
+      }
+    broadPhase.Update();
+
+    double elapsed = 0;
+    size_t pairs = 0;
+    for (int f = 0; f < frames; f++)
+      {
+      for (int i = 0; i < count; i++)
+        {
+        for (int k = 0; k < 3; k++)
+          {
+          position[3 * i + k] += 0.1 * (2.0 * rand() / RAND_MAX - 1.0);
+          }
+        actors[i]->SetPosition(&position[3 * i]);
+        broadPhase.MarkMoved(i);
+        }
+      double start = vtkTimerLog::GetUniversalTime();
+      broadPhase.Update();
+      elapsed += vtkTimerLog::GetUniversalTime() - start;
+      pairs += broadPhase.GetPairs().size();
+      }
+
+    cout << count << ", " << elapsed * 1.0e6 / frames << ", " << pairs / frames << ", ";
+    if (count <= 1000)
+      {
+      size_t bruteForce = 0;
+      double a[6], b[6];
+      for (int i = 0; i < count; i++)
+        {
+        broadPhase.GetWorldBounds(i, a);
+        for (int j = i + 1; j < count; j++)
+          {
+          broadPhase.GetWorldBounds(j, b);
+          if (a[0] <= b[1] && b[0] <= a[1] && a[2] <= b[3] && b[2] <= a[3] &&
+              a[4] <= b[5] && b[4] <= a[5])
+            {
+            bruteForce++;
+            }
+          }
+        }
+      cout << bruteForce << " (last frame " << broadPhase.GetPairs().size() << ")";
+      }
+    else
+      {
+      cout << "-";
+      }
+    cout << endl;
+    }
+}
+//***************************************************************
+// Random segments through a sphere of about 20k triangles. The batch
+// intersector (one thread and all threads) against one
+// vtkCellLocator::IntersectWithLine call per segment; hits and hit
+// parameters of both are compared.
+static void BenchmarkRays()
+{
+  const int count = 100000;
+  const double tolerance = 0.001;
+
+  vtkSmartPointer<vtkSphereSource> sphereSource = vtkSmartPointer<vtkSphereSource>::New();
+  sphereSource->SetRadius(1.0);
+  sphereSource->SetPhiResolution(100);
+  sphereSource->SetThetaResolution(100);
+  sphereSource->Update();
+  vtkPolyData *sphere = sphereSource->GetOutput();
+
+  srand(2);
+  std::vector<double> p1(3 * count), p2(3 * count);
+  for (int i = 0; i < 3 * count; i++)
+    {
+    p1[i] = 3.0 * rand() / RAND_MAX - 1.5;
+    p2[i] = 3.0 * rand() / RAND_MAX - 1.5;
+    }
+
+  BatchRayIntersector intersector;
+  intersector.SetInput(sphere);
+  intersector.Update();
+  std::vector<double> t(count), x(3 * count);
+  std::vector<vtkIdType> cellIds(count);
+  int threads = intersector.GetNumberOfThreads();
+
+  cout << "rays: segments, threads, us total, segments/s" << endl;
+  for (int pass = 0; pass < 2; pass++)
+    {
+    intersector.SetNumberOfThreads(pass ? threads : 1);
+    double start = vtkTimerLog::GetUniversalTime();
+    intersector.IntersectSegments(count, &p1[0], &p2[0], &t[0], &x[0], &cellIds[0]);
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    cout << count << ", " << intersector.GetNumberOfThreads() << ", " << elapsed * 1.0e6 << ", "
+         << count / elapsed << endl;
+    }
+
+  vtkSmartPointer<vtkCellLocator> locator = vtkSmartPointer<vtkCellLocator>::New();
+  locator->SetDataSet(sphere);
+  locator->BuildLocator();
+  const int checked = count / 10;
+  int mismatches = 0;
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int i = 0; i < checked; i++)
+    {
+    double locatorT, locatorX[3], pcoords[3];
+    int subId;
+    vtkIdType cellId;
+    int hit = locator->IntersectWithLine(&p1[3 * i], &p2[3 * i], tolerance, locatorT,
+                                         locatorX, pcoords, subId, cellId);
+    // Grazing hits may land on the neighbouring cell; compare t only.
+    if ((hit != 0) != (cellIds[i] >= 0) || (hit && fabs(locatorT - t[i]) > tolerance))
+      {
+      mismatches++;
+      }
+    }
+  double elapsed = vtkTimerLog::GetUniversalTime() - start;
+  cout << "vtkCellLocator: " << checked << ", 1, " << elapsed * 1.0e6 << ", "
+       << checked / elapsed << ", mismatches " << mismatches << endl;
+}
+//***************************************************************
+// Copies of one small sphere, rendered offscreen: one actor, mapper and
+// ActorAnimator per copy as in Scene.cxx, against one
+// InstancedActorAnimator drawing all copies with a glyph mapper.
+static void BenchmarkInstancing()
+{
+  const int counts[] = {100, 1000, 10000};
+  const int frames = 20;
+
+  vtkSmartPointer<vtkSphereSource> sphereSource = vtkSmartPointer<vtkSphereSource>::New();
+  sphereSource->SetRadius(0.4);
+  sphereSource->SetPhiResolution(8);
+  sphereSource->SetThetaResolution(8);
+  sphereSource->Update();
+
+  cout << "instancing: copies, per-actor us/frame, instanced us/frame" << endl;
+  srand(3);
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+    int count = counts[c];
+    double side = 2.0 * pow(static_cast<double>(count), 1.0 / 3.0);
+    std::vector<double> start(3 * count), end(3 * count);
+    for (int i = 0; i < 3 * count; i++)
+      {
+      start[i] = side * rand() / RAND_MAX;
+      end[i] = start[i] + 2.0 * rand() / RAND_MAX - 1.0;
+      }
+
+    double perActor;
+      {
+      vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+      vtkSmartPointer<vtkRenderWindow> renderWindow = vtkSmartPointer<vtkRenderWindow>::New();
+      renderWindow->OffScreenRenderingOn();
+      renderWindow->SetSize(640, 480);
+      renderWindow->AddRenderer(renderer);
+      vtkSmartPointer<vtkAnimationCue> cue = vtkSmartPointer<vtkAnimationCue>::New();
+      cue->SetStartTime(0);
+      cue->SetEndTime(5);
+      std::vector<ActorAnimator*> animators(count);
+      for (int i = 0; i < count; i++)
+        {
+        vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+        mapper->SetInputConnection(sphereSource->GetOutputPort());
+        vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+        actor->SetMapper(mapper);
+        renderer->AddActor(actor);
+        animators[i] = new ActorAnimator;
+        animators[i]->SetActor(actor);
+        animators[i]->SetStartPosition(std::vector<double>(&start[3 * i], &start[3 * i] + 3));
+        animators[i]->SetEndPosition(std::vector<double>(&end[3 * i], &end[3 * i] + 3));
+        animators[i]->AddObserversToCue(cue);
+        }
+      renderer->ResetCamera();
+      perActor = TimeRenderedFrames(cue, renderWindow, frames);
+      for (int i = 0; i < count; i++)
+        {
+        delete animators[i];
+        }
+      }
+
+    double instanced;
+      {
+      vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+      vtkSmartPointer<vtkRenderWindow> renderWindow = vtkSmartPointer<vtkRenderWindow>::New();
+      renderWindow->OffScreenRenderingOn();
+      renderWindow->SetSize(640, 480);
+      renderWindow->AddRenderer(renderer);
+      vtkSmartPointer<vtkAnimationCue> cue = vtkSmartPointer<vtkAnimationCue>::New();
+      cue->SetStartTime(0);
+      cue->SetEndTime(5);
+      InstancedActorAnimator instances;
+      instances.SetSourceConnection(sphereSource->GetOutputPort());
+      instances.Reserve(count);
+      double color[3] = {1.0, 1.0, 1.0};
+      for (int i = 0; i < count; i++)
+        {
+        instances.AddInstance(&start[3 * i], &end[3 * i], color);
+        }
+      instances.AddObserversToCue(cue);
+      renderer->AddActor(instances.GetActor());
+      renderer->ResetCamera();
+      instanced = TimeRenderedFrames(cue, renderWindow, frames);
+      }
+
+    cout << count << ", " << perActor << ", " << instanced << endl;
+    }
+}
+//***************************************************************
+// Time stamps taken at fixed points of every scene frame. The scene's
+// first cue marks the start of the tick, a cue added after the animated
+// ones marks the end of the animators; on the scene's own tick event
+// (after all cues) the mappers are brought up to date before
+// AnimationSceneObserver renders, and a last observer closes the frame.
+class SceneFrameTimer : public vtkCommand
+{
+public:
+  enum
+    {
+    TICK_START = 0,
+    ANIMATORS_DONE,
+    UPDATE,
+    FRAME_DONE
+    };
+
+  static SceneFrameTimer *New()
+    {
+    return new SceneFrameTimer;
+    }
+
+  virtual void Execute(vtkObject *vtkNotUsed(caller),
+                       unsigned long event,
+                       void *vtkNotUsed(calldata))
+    {
+    if (event != vtkCommand::AnimationCueTickEvent)
+      {
+      return;
+      }
+    double now = vtkTimerLog::GetUniversalTime();
+    switch (this->Point)
+      {
+      case TICK_START:
+        this->Timer->TickStart = now;
+        break;
+      case ANIMATORS_DONE:
+        this->Timer->AnimatorsDone = now;
+        break;
+      case UPDATE:
+        this->Timer->CuesDone = now;
+        for (size_t i = 0; i < this->Timer->Mappers.size(); i++)
+          {
+          this->Timer->Mappers[i]->Update();
+          }
+        this->Timer->UpdateDone = vtkTimerLog::GetUniversalTime();
+        break;
+      case FRAME_DONE:
+        this->Timer->Tick.push_back(this->Timer->AnimatorsDone - this->Timer->TickStart);
+        this->Timer->Update.push_back(this->Timer->UpdateDone - this->Timer->AnimatorsDone);
+        this->Timer->Render.push_back(now - this->Timer->UpdateDone);
+        break;
+      }
+    }
+
+  SceneFrameTimer()
+    {
+    this->Point = TICK_START;
+    this->Timer = this;
+    this->TickStart = this->AnimatorsDone = this->CuesDone = this->UpdateDone = 0;
+    }
+
+  // Makes this observer record the given point into timer.
+  void SetPoint(SceneFrameTimer *timer, int point)
+    {
+    this->Timer = timer;
+    this->Point = point;
+    }
+
+  int                    Point;
+  SceneFrameTimer *      Timer;
+  double                 TickStart;
+  double                 AnimatorsDone;
+  double                 CuesDone;
+  double                 UpdateDone;
+  std::vector<vtkMapper*> Mappers;
+  std::vector<double>    Tick;
+  std::vector<double>    Update;
+  std::vector<double>    Render;
+};
+
+// Nearest-rank percentile, in microseconds, of times in seconds.
+static double Percentile(std::vector<double> times, double percent)
+{
+  if (times.empty())
+    {
+    return 0.0;
+    }
+  std::sort(times.begin(), times.end());
+  size_t rank = static_cast<size_t>(ceil(percent / 100.0 * times.size()));
+  return times[rank > 0 ? rank - 1 : 0] * 1.0e6;
+}
+
+static double Mean(const std::vector<double> &times)
+{
+  double sum = 0.0;
+  for (size_t i = 0; i < times.size(); i++)
+    {
+    sum += times[i];
+    }
+  return times.empty() ? 0.0 : sum * 1.0e6 / times.size();
+}
+
+static void PrintTimesJSON(const char *name, const std::vector<double> &times, bool last)
+{
+  cout << "  \"" << name << "\": {\"mean\": " << Mean(times)
+       << ", \"p50\": " << Percentile(times, 50) << ", \"p90\": " << Percentile(times, 90)
+       << ", \"p99\": " << Percentile(times, 99) << ", \"max\": " << Percentile(times, 100)
+       << "}" << (last ? "" : ",") << endl;
+}
+
+static void PrintTimesCSV(const std::vector<double> &times)
+{
+  cout << ", " << Mean(times) << ", " << Percentile(times, 50) << ", " << Percentile(times, 90)
+       << ", " << Percentile(times, 99) << ", " << Percentile(times, 100);
+}
+
+//***************************************************************
+// N spheres, each with its own mapper and ActorAnimator as in Scene.cxx,
+// spread over M cues of one scene played in sequence mode and rendered
+// offscreen by AnimationSceneObserver. With -intersection the first two
+// spheres are also intersected by a MeshIntersector on its own cue.
+static void BenchmarkScene(int argc, char *argv[])
+{
+  int actors = 100;
+  int cues = 1;
+  int resolution = 16;
+  double opacity = 1.0;
+  int frames = 100;
+  bool intersection = false;
+  bool csv = false;
+  for (int i = 0; i < argc; i++)
+    {
+    bool value = i + 1 < argc;
+    if (!strcmp(argv[i], "-actors") && value)
+      {
+      actors = std::max(1, atoi(argv[++i]));
+      }
+    else if (!strcmp(argv[i], "-cues") && value)
+      {
+      cues = std::max(1, atoi(argv[++i]));
+      }
+    else if (!strcmp(argv[i], "-resolution") && value)
+      {
+      resolution = std::max(3, atoi(argv[++i]));
+      }
+    else if (!strcmp(argv[i], "-opacity") && value)
+      {
+      opacity = atof(argv[++i]);
+      }
+    else if (!strcmp(argv[i], "-frames") && value)
+      {
+      frames = std::max(2, atoi(argv[++i]));
+      }
+    else if (!strcmp(argv[i], "-intersection"))
+      {
+      intersection = true;
+      }
+    else if (!strcmp(argv[i], "-csv"))
+      {
+      csv = true;
+      }
+    }
+
+  vtkSmartPointer<vtkSphereSource> sphereSource = vtkSmartPointer<vtkSphereSource>::New();
+  sphereSource->SetRadius(0.5);
+  sphereSource->SetPhiResolution(resolution);
+  sphereSource->SetThetaResolution(resolution);
+  sphereSource->Update();
+
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  vtkSmartPointer<vtkRenderWindow> renderWindow = vtkSmartPointer<vtkRenderWindow>::New();
+  renderWindow->OffScreenRenderingOn();
+  renderWindow->SetSize(640, 480);
+  renderWindow->AddRenderer(renderer);
+
+  // Sequence mode ticks frames + 1 times from 0 to the end time.
+  vtkSmartPointer<vtkAnimationScene> scene = vtkSmartPointer<vtkAnimationScene>::New();
+  scene->SetModeToSequence();
+  scene->SetLoop(0);
+  scene->SetStartTime(0);
+  scene->SetEndTime(5);
+  scene->SetFrameRate((frames - 1) / 5.0);
+
+  vtkSmartPointer<SceneFrameTimer> timer = vtkSmartPointer<SceneFrameTimer>::New();
+  vtkSmartPointer<vtkAnimationCue> startCue = vtkSmartPointer<vtkAnimationCue>::New();
+  startCue->SetStartTime(0);
+  startCue->SetEndTime(5);
+  startCue->AddObserver(vtkCommand::AnimationCueTickEvent, timer);
+  scene->AddCue(startCue);
+
+  std::vector<vtkSmartPointer<vtkAnimationCue> > animationCues(cues);
+  for (int c = 0; c < cues; c++)
+    {
+    animationCues[c] = vtkSmartPointer<vtkAnimationCue>::New();
+    animationCues[c]->SetStartTime(0);
+    animationCues[c]->SetEndTime(5);
+    scene->AddCue(animationCues[c]);
+    }
+
+  srand(4);
+  double side = 2.0 * pow(static_cast<double>(actors), 1.0 / 3.0);
+  std::vector<vtkSmartPointer<vtkActor> > sceneActors(actors);
+  std::vector<ActorAnimator*> animators(actors);
+  for (int i = 0; i < actors; i++)
+    {
+    vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    mapper->SetInputConnection(sphereSource->GetOutputPort());
+    timer->Mappers.push_back(mapper);
+    sceneActors[i] = vtkSmartPointer<vtkActor>::New();
+    sceneActors[i]->SetMapper(mapper);
+    sceneActors[i]->GetProperty()->SetOpacity(opacity);
+    renderer->AddActor(sceneActors[i]);
+
+    std::vector<double> start(3), end(3);
+    for (int k = 0; k < 3; k++)
+      {
+      start[k] = side * rand() / RAND_MAX;
+      end[k] = start[k] + 2.0 * rand() / RAND_MAX - 1.0;
+      }
+    animators[i] = new ActorAnimator;
+    animators[i]->SetActor(sceneActors[i]);
+    animators[i]->SetStartPosition(start);
+    animators[i]->SetEndPosition(end);
+    animators[i]->AddObserversToCue(animationCues[i % cues]);
+    }
+
+  vtkSmartPointer<vtkAnimationCue> animatorsDoneCue = vtkSmartPointer<vtkAnimationCue>::New();
+  animatorsDoneCue->SetStartTime(0);
+  animatorsDoneCue->SetEndTime(5);
+  vtkSmartPointer<SceneFrameTimer> animatorsDone = vtkSmartPointer<SceneFrameTimer>::New();
+  animatorsDone->SetPoint(timer, SceneFrameTimer::ANIMATORS_DONE);
+  animatorsDoneCue->AddObserver(vtkCommand::AnimationCueTickEvent, animatorsDone);
+  scene->AddCue(animatorsDoneCue);
+
+  // The intersection counts as pipeline update time.
+  MeshIntersector meshIntersector;
+  vtkSmartPointer<vtkAnimationCue> intersectionCue = vtkSmartPointer<vtkAnimationCue>::New();
+  vtkSmartPointer<vtkPolyDataMapper> intersectionMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+  vtkSmartPointer<vtkActor> intersectionActor = vtkSmartPointer<vtkActor>::New();
+  if (intersection && actors > 1)
+    {
+    // An empty mesh leaves no contact set to reuse on the next update.
+    MeshIntersector emptyIntersector;
+    vtkSmartPointer<vtkPolyData> emptyMesh = vtkSmartPointer<vtkPolyData>::New();
+    emptyIntersector.SetInput(0, sceneActors[0], emptyMesh);
+    emptyIntersector.SetInput(1, sceneActors[1], sphereSource->GetOutput());
+    emptyIntersector.SetMargin(0.1);
+    emptyIntersector.Update();
+    emptyIntersector.Update();
+    if (emptyIntersector.GetContactSetReused() ||
+        emptyIntersector.GetOutput()->GetNumberOfPoints())
+      {
+      cout << "FAILED: intersecting an empty mesh reused a contact set" << endl;
+      Failures++;
+      }
+
+    meshIntersector.SetInput(0, sceneActors[0], sphereSource->GetOutput());
+    meshIntersector.SetInput(1, sceneActors[1], sphereSource->GetOutput());
+    meshIntersector.Update();
+    // Nothing moved: the output must not look modified to the renderer.
+    unsigned long outputMTime = meshIntersector.GetOutput()->GetMTime();
+    meshIntersector.Update();
+    if (meshIntersector.GetOutput()->GetMTime() != outputMTime)
+      {
+      cout << "FAILED: intersecting unmoved actors modified the output" << endl;
+      Failures++;
+      }
+#if VTK_MAJOR_VERSION <= 5
+    intersectionMapper->SetInput(meshIntersector.GetOutput());
+#else
+    intersectionMapper->SetInputData(meshIntersector.GetOutput());
+#endif
+    intersectionActor->SetMapper(intersectionMapper);
+    renderer->AddActor(intersectionActor);
+    timer->Mappers.push_back(intersectionMapper);
+    intersectionCue->SetStartTime(0);
+    intersectionCue->SetEndTime(5);
+    meshIntersector.AddObserversToCue(intersectionCue);
+    scene->AddCue(intersectionCue);
+    }
+  renderer->ResetCamera();
+  renderWindow->Render();
+
+  // Observers of the scene tick run by decreasing priority; they are
+  // also added in that order.
+  vtkSmartPointer<SceneFrameTimer> update = vtkSmartPointer<SceneFrameTimer>::New();
+  update->SetPoint(timer, SceneFrameTimer::UPDATE);
+  scene->AddObserver(vtkCommand::AnimationCueTickEvent, update, 1.0);
+  vtkSmartPointer<AnimationSceneObserver> sceneObserver = vtkSmartPointer<AnimationSceneObserver>::New();
+  sceneObserver->SetRenderWindow(renderWindow);
+  scene->AddObserver(vtkCommand::AnimationCueTickEvent, sceneObserver, 0.0);
+  vtkSmartPointer<SceneFrameTimer> frameDone = vtkSmartPointer<SceneFrameTimer>::New();
+  frameDone->SetPoint(timer, SceneFrameTimer::FRAME_DONE);
+  scene->AddObserver(vtkCommand::AnimationCueTickEvent, frameDone, -1.0);
+
+  scene->Play();
+  scene->Stop();
+
+  for (int i = 0; i < actors; i++)
+    {
+    delete animators[i];
+    }
+
+  if (csv)
+    {
+    cout << "actors, cues, resolution, opacity, intersection, frames";
+    const char *stages[] = {"tick", "update", "render"};
+    for (int s = 0; s < 3; s++)
+      {
+      cout << ", " << stages[s] << "_mean_us, " << stages[s] << "_p50_us, " << stages[s]
+           << "_p90_us, " << stages[s] << "_p99_us, " << stages[s] << "_max_us";
+      }
+    cout << endl;
+    cout << actors << ", " << cues << ", " << resolution << ", " << opacity << ", "
+         << (intersection ? 1 : 0) << ", " << timer->Tick.size();
+    PrintTimesCSV(timer->Tick);
+    PrintTimesCSV(timer->Update);
+    PrintTimesCSV(timer->Render);
+    cout << endl;
+    return;
+    }
+  cout << "{" << endl;
+  cout << "  \"benchmark\": \"scene\"," << endl;
+  cout << "  \"actors\": " << actors << ", \"cues\": " << cues << ", \"resolution\": "
+       << resolution << ", \"opacity\": " << opacity << ", \"intersection\": "
+       << (intersection ? "true" : "false") << ", \"frames\": " << timer->Tick.size() << ","
+       << endl;
+  PrintTimesJSON("tick_us", timer->Tick, false);
+  PrintTimesJSON("update_us", timer->Update, false);
+  PrintTimesJSON("render_us", timer->Render, true);
+  cout << "}" << endl;
+}
+//***************************************************************
+// ActorAnimators with Catmull-Rom position and orientation tracks of
+// many keys, evaluated on every tick, against replaying the same scene
+// baked to a file. Reports the bake and open times, the time per tick of
+// both and the largest difference between evaluated and replayed matrices.
+static void BenchmarkBaked()
+{
+  const int counts[] = {10, 100, 1000};
+  const int keys = 200;
+  const int ticks = 50;
+  const char *fileName = "Benchmark.baked";
+
+  cout << "baked: actors, bake s, open us, ActorAnimator us/tick, BakedAnimationPlayer us/tick, max error" << endl;
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+    int count = counts[c];
+    vtkSmartPointer<vtkAnimationScene> scene = vtkSmartPointer<vtkAnimationScene>::New();
+    scene->SetStartTime(0);
+    scene->SetEndTime(5);
+    scene->SetFrameRate(30);
+    vtkSmartPointer<vtkAnimationCue> animatedCue = vtkSmartPointer<vtkAnimationCue>::New();
+    animatedCue->SetStartTime(0);
+    animatedCue->SetEndTime(5);
+    scene->AddCue(animatedCue);
+
+    std::vector<vtkSmartPointer<vtkActor> > animated(count), replayed(count);
+    std::vector<ActorAnimator*> animators(count);
+    AnimationBaker baker;
+    baker.SetScene(scene);
+    srand(3);
+    for (int i = 0; i < count; i++)
+      {
+      animated[i] = vtkSmartPointer<vtkActor>::New();
+      replayed[i] = vtkSmartPointer<vtkActor>::New();
+      animators[i] = new ActorAnimator;
+      animators[i]->SetActor(animated[i]);
+      KeyframeTrack *position = animators[i]->GetPositionTrack();
+      KeyframeTrack *orientation = animators[i]->GetOrientationTrack();
+      position->SetInterpolationToCatmullRom();
+      orientation->SetInterpolationToCatmullRom();
+      for (int k = 0; k < keys; k++)
+        {
+        double time = 5.0 * k / (keys - 1);
+        double p[3], q[4], norm = 0;
+        for (int j = 0; j < 3; j++)
+          {
+          p[j] = 10.0 * rand() / RAND_MAX - 5.0;
+          }
+        for (int j = 0; j < 4; j++)
+          {
+          q[j] = 2.0 * rand() / RAND_MAX - 1.0;
+          norm += q[j] * q[j];
+          }
+        for (int j = 0; j < 4; j++)
+          {
+          q[j] /= sqrt(norm);
+          }
+        position->AddKey(time, p);
+        orientation->AddKey(time, q);
+        }
+      animators[i]->AddObserversToCue(animatedCue);
+      baker.AddActor(animated[i]);
+      }
+
+    double t0 = vtkTimerLog::GetUniversalTime();
+    baker.Bake();
+    bool written = baker.Write(fileName);
+    double bakeTime = vtkTimerLog::GetUniversalTime() - t0;
+
+    BakedAnimationPlayer player;
+    t0 = vtkTimerLog::GetUniversalTime();
+    bool opened = written && player.Open(fileName);
+    double openTime = (vtkTimerLog::GetUniversalTime() - t0) * 1.0e6;
+    if (!opened)
+      {
+      cout << count << ", cannot write or map " << fileName << endl;
+      for (int i = 0; i < count; i++)
+        {
+        delete animators[i];
+        }
+      continue;
+      }
+    vtkSmartPointer<vtkAnimationCue> replayCue = vtkSmartPointer<vtkAnimationCue>::New();
+    replayCue->SetStartTime(0);
+    replayCue->SetEndTime(5);
+    for (int i = 0; i < count; i++)
+      {
+      player.SetActor(i, replayed[i]);
+      }
+    player.AddObserversToCue(replayCue);
+
+    double evaluated = TimeCueTicks(animatedCue, ticks);
+    double replay = TimeCueTicks(replayCue, ticks);
+
+    // Both on the scene: every frame, evaluated and replayed actors
+    // should agree to float precision.
+    scene->AddCue(replayCue);
+    scene->SetModeToSequence();
+    scene->Initialize();
+    double maxError = 0;
+    vtkSmartPointer<vtkMatrix4x4> a = vtkSmartPointer<vtkMatrix4x4>::New();
+    vtkSmartPointer<vtkMatrix4x4> b = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int f = 0; f < player.GetNumberOfFrames(); f++)
+      {
+      double time = f + 1 < player.GetNumberOfFrames() ? f / player.GetFrameRate() : player.GetEndTime();
+      scene->Tick(time, 0, time);
+      for (int i = 0; i < count; i++)
+        {
+        animated[i]->GetMatrix(a);
+        replayed[i]->GetMatrix(b);
+        for (int k = 0; k < 16; k++)
+          {
+          maxError = std::max(maxError, fabs(a->GetData()[k] - b->GetData()[k]));
+          }
+        }
+      }
+    scene->Finalize();
+
+    cout << count << ", " << bakeTime << ", " << openTime << ", " << evaluated
+         << ", " << replay << ", " << maxError << endl;
+
+    player.Close();
+    for (int i = 0; i < count; i++)
+      {
+      delete animators[i];
+      }
+    }
+  remove(fileName);
+}
+//***************************************************************
+// Keyframed ActorAnimators ticked one after the other by their own cue
+// observers, against the same animators evaluated by a
+// ParallelActorAnimator on 1, 2, 4, ... up to T threads (one per core by
+// default). After every run the actors must match the serial ones
+// exactly.
+static void BenchmarkParallel(int argc, char *argv[])
+{
+  int count = 2000;
+  int keys = 100;
+  int maxThreads = static_cast<int>(std::thread::hardware_concurrency());
+  for (int i = 0; i < argc; i++)
+    {
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(argv[i], "-actors") && value)
+      {
+      count = atoi(value);
+      }
+    else if (!strcmp(argv[i], "-keys") && value)
+      {
+      keys = atoi(value);
+      }
+    else if (!strcmp(argv[i], "-threads") && value)
+      {
+      maxThreads = atoi(value);
+      }
+    }
+  maxThreads = std::max(1, maxThreads);
+  const int ticks = 50;
+
+  // Two identical sets of animators, one per set of actors.
+  std::vector<vtkSmartPointer<vtkActor> > actors[2];
+  std::vector<ActorAnimator*> animators[2];
+  for (int set = 0; set < 2; set++)
+    {
+    srand(5);
+    for (int i = 0; i < count; i++)
+      {
+      actors[set].push_back(vtkSmartPointer<vtkActor>::New());
+      ActorAnimator *animator = new ActorAnimator;
+      animator->SetActor(actors[set][i]);
+      KeyframeTrack *position = animator->GetPositionTrack();
+      KeyframeTrack *orientation = animator->GetOrientationTrack();
+      KeyframeTrack *scale = animator->GetScaleTrack();
+      position->SetInterpolationToCatmullRom();
+      orientation->SetInterpolationToCatmullRom();
+      for (int k = 0; k < keys; k++)
+        {
+        double time = 5.0 * k / (keys - 1);
+        double p[3], q[4], norm = 0;
+        for (int j = 0; j < 3; j++)
+          {
+          p[j] = 10.0 * rand() / RAND_MAX - 5.0;
+          }
+        for (int j = 0; j < 4; j++)
+          {
+          q[j] = 2.0 * rand() / RAND_MAX - 1.0;
+          norm += q[j] * q[j];
+          }
+        for (int j = 0; j < 4; j++)
+          {
+          q[j] /= sqrt(norm);
+          }
+        double sc[3] = {0.5 + p[0] * 0.1, 1.0, 0.5 + p[1] * 0.1};
+        position->AddKey(time, p);
+        orientation->AddKey(time, q);
+        scale->AddKey(time, sc);
+        }
+      animators[set].push_back(animator);
+      }
+    }
+
+  vtkSmartPointer<vtkAnimationCue> serialCue = vtkSmartPointer<vtkAnimationCue>::New();
+  serialCue->SetStartTime(0);
+  serialCue->SetEndTime(5);
+  for (int i = 0; i < count; i++)
+    {
+    animators[0][i]->AddObserversToCue(serialCue);
+    }
+  double serial = TimeCueTicks(serialCue, ticks);
+
+  vtkSmartPointer<vtkAnimationCue> parallelCue = vtkSmartPointer<vtkAnimationCue>::New();
+  parallelCue->SetStartTime(0);
+  parallelCue->SetEndTime(5);
+  ParallelActorAnimator parallel;
+  for (int i = 0; i < count; i++)
+    {
+    parallel.AddAnimator(animators[1][i]);
+    }
+  parallel.AddObserversToCue(parallelCue);
+
+  cout << "parallel: " << count << " actors, " << keys << " keys, serial "
+       << serial << " us/tick" << endl;
+  cout << "parallel: threads, us/tick, speedup, identical" << endl;
+  WorkStealingPool pool(1);
+  parallel.SetPool(&pool);
+  vtkSmartPointer<vtkMatrix4x4> a = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkSmartPointer<vtkMatrix4x4> b = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int threads = 1; ; threads = std::min(2 * threads, maxThreads))
+    {
+    pool.SetNumberOfThreads(threads);
+    double time = TimeCueTicks(parallelCue, ticks);
+    bool identical = true;
+    for (int i = 0; i < count && identical; i++)
+      {
+      actors[0][i]->GetMatrix(a);
+      actors[1][i]->GetMatrix(b);
+      identical = memcmp(a->GetData(), b->GetData(), 16 * sizeof(double)) == 0;
+      }
+    cout << threads << ", " << time << ", " << serial / time << ", "
+         << (identical ? "yes" : "no") << endl;
+    if (threads == maxThreads)
+      {
+      break;
+      }
+    }
+
+  for (int set = 0; set < 2; set++)
+    {
+    for (int i = 0; i < count; i++)
+      {
+      delete animators[set][i];
+      }
+    }
+}
+//***************************************************************
+// Evaluation alone, without touching actors: BatchActorAnimator's
+// runtime lerp in double against TemplateActorAnimator instantiations
+// with the easing and channels fixed at compile time. Reports ns per item
+// per tick and whether the linear double template reproduces the batch
+// positions exactly.
+template <class Animator>
+static double TimeTemplateEvaluate(Animator &animator, int ticks)
+{
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int i = 0; i < ticks; i++)
+    {
+    animator.Evaluate(static_cast<float>(i) / ticks);
+    }
+  return (vtkTimerLog::GetUniversalTime() - start) / ticks;
+}
+
+static void BenchmarkTemplates(int argc, char *argv[])
+{
+  int count = 100000;
+  for (int i = 0; i < argc; i++)
+    {
+    if (!strcmp(argv[i], "-items") && i + 1 < argc)
+      {
+      count = atoi(argv[i + 1]);
+      }
+    }
+  const int ticks = 100;
+
+  std::vector<vtkSmartPointer<vtkActor> > actors(count);
+  BatchActorAnimator batch;
+  batch.Reserve(count);
+  TemplateActorAnimator<double, EaseLinear, PositionChannel> linearDouble;
+  TemplateActorAnimator<float, EaseLinear, PositionChannel> linearFloat;
+  TemplateActorAnimator<float, EaseSmoothStep, PositionChannel> smoothFloat;
+  TemplateActorAnimator<float, EaseInOutCubic, PositionChannel, RotationChannel, ScaleChannel> allFloat;
+  linearDouble.Reserve(count);
+  linearFloat.Reserve(count);
+  smoothFloat.Reserve(count);
+  allFloat.Reserve(count);
+  srand(4);
+  for (int i = 0; i < count; i++)
+    {
+    double start[3], end[3];
+    for (int c = 0; c < 3; c++)
+      {
+      start[c] = 10.0 * rand() / RAND_MAX - 5.0;
+      end[c] = 10.0 * rand() / RAND_MAX - 5.0;
+      }
+    actors[i] = vtkSmartPointer<vtkActor>::New();
+    batch.AddActor(actors[i], start, end);
+    linearDouble.Set<PositionChannel>(linearDouble.AddItem(), start, end);
+    linearFloat.Set<PositionChannel>(linearFloat.AddItem(), start, end);
+    smoothFloat.Set<PositionChannel>(smoothFloat.AddItem(), start, end);
+    size_t item = allFloat.AddItem(0, 0.5 * rand() / RAND_MAX, 0.5);
+    allFloat.Set<PositionChannel>(item, start, end);
+    allFloat.Set<RotationChannel>(item, start, end);
+    allFloat.Set<ScaleChannel>(item, start, end);
+    }
+
+  double batchTime = TimeTemplateEvaluate(batch, ticks);
+  double linearDoubleTime = TimeTemplateEvaluate(linearDouble, ticks);
+  double linearFloatTime = TimeTemplateEvaluate(linearFloat, ticks);
+  double smoothFloatTime = TimeTemplateEvaluate(smoothFloat, ticks);
+  double allFloatTime = TimeTemplateEvaluate(allFloat, ticks);
+
+  batch.Evaluate(0.3);
+  linearDouble.Evaluate(0.3);
+  bool identical = true;
+  for (int i = 0; i < count && identical; i++)
+    {
+    double position[3];
+    batch.GetPosition(i, position);
+    for (int c = 0; c < 3; c++)
+      {
+      identical = identical && position[c] == linearDouble.GetValues<PositionChannel>(c)[i];
+      }
+    }
+
+  const double scale = 1.0e9 / count;
+  cout << "templates: " << count << " items, ns/item/tick" << endl;
+  cout << "BatchActorAnimator position double, " << batchTime * scale << endl;
+  cout << "linear position double, " << linearDoubleTime * scale
+       << ", same as batch: " << (identical ? "yes" : "no") << endl;
+  cout << "linear position float, " << linearFloatTime * scale << endl;
+  cout << "smoothstep position float, " << smoothFloatTime * scale << endl;
+  cout << "in-out cubic position rotation scale float, staggered, " << allFloatTime * scale << endl;
+}
+//***************************************************************
+// N actors drawing three sphere meshes, scattered and rotated, rendered
+// offscreen once. The same P display positions are picked with
+// vtkCellPicker and with ActorPicker, first with the actors still and
+// then moving every actor before each pick, as happens while hovering
+// over an animation. Reports the time per pick and how often both pick
+// the same actor.
+static void BenchmarkPicking(int argc, char *argv[])
+{
+  int count = 2000;
+  int picks = 200;
+  for (int i = 0; i < argc; i++)
+    {
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(argv[i], "-actors") && value)
+      {
+      count = atoi(value);
+      }
+    else if (!strcmp(argv[i], "-picks") && value)
+      {
+      picks = atoi(value);
+      }
+    }
+
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  vtkSmartPointer<vtkRenderWindow> renderWindow = vtkSmartPointer<vtkRenderWindow>::New();
+  renderWindow->OffScreenRenderingOn();
+  renderWindow->SetSize(640, 480);
+  renderWindow->AddRenderer(renderer);
+
+  std::vector<vtkSmartPointer<vtkPolyDataMapper> > mappers;
+  for (int m = 0; m < 3; m++)
+    {
+    vtkSmartPointer<vtkSphereSource> source = vtkSmartPointer<vtkSphereSource>::New();
+    source->SetPhiResolution(8 + 8 * m);
+    source->SetThetaResolution(8 + 8 * m);
+    source->Update();
+    vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+#if VTK_MAJOR_VERSION <= 5
+    mapper->SetInput(source->GetOutput());
+#else
+    mapper->SetInputData(source->GetOutput());
+#endif
+    mappers.push_back(mapper);
+    }
+
+  srand(11);
+  const double extent = 2.0 * pow(static_cast<double>(count), 1.0 / 3.0);
+  ActorPicker actorPicker;
+  std::vector<vtkSmartPointer<vtkActor> > actors;
+  std::vector<double> placed(3 * count);
+  for (int i = 0; i < count; i++)
+    {
+    vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(mappers[i % 3]);
+    for (int c = 0; c < 3; c++)
+      {
+      placed[3 * i + c] = extent * rand() / RAND_MAX;
+      }
+    actor->SetPosition(&placed[3 * i]);
+    actor->RotateWXYZ(360.0 * rand() / RAND_MAX, 1.0 * rand() / RAND_MAX, 1.0, 0.5);
+    actor->SetScale(0.5 + 1.0 * rand() / RAND_MAX, 1.0, 1.0);
+    renderer->AddActor(actor);
+    actorPicker.AddActor(actor);
+    actors.push_back(actor);
+    }
+  renderer->ResetCamera();
+  renderWindow->Render();
+
+  std::vector<double> positions(2 * picks);
+  for (int i = 0; i < picks; i++)
+    {
+    positions[2 * i] = 640.0 * rand() / RAND_MAX;
+    positions[2 * i + 1] = 480.0 * rand() / RAND_MAX;
+    }
+
+  vtkSmartPointer<vtkCellPicker> cellPicker = vtkSmartPointer<vtkCellPicker>::New();
+  cellPicker->SetTolerance(0.0);
+  ActorPicker::Hit hit;
+  // Build whatever either picker builds on first use.
+  cellPicker->Pick(positions[0], positions[1], 0, renderer);
+  actorPicker.Pick(positions[0], positions[1], renderer, hit);
+
+  cout << "picking: " << count << " actors, " << picks << " picks, "
+       << actorPicker.GetNumberOfMeshes() << " meshes" << endl;
+  cout << "picking: actors, vtkCellPicker us/pick, ActorPicker us/pick, speedup, same actor" << endl;
+  for (int moving = 0; moving < 2; moving++)
+    {
+    std::vector<vtkActor*> picked(picks);
+    double cellTime = 0.0, actorTime = 0.0;
+    int same = 0;
+    for (int pass = 0; pass < 2; pass++)
+      {
+      for (int i = 0; i < picks; i++)
+        {
+        if (moving)
+          {
+          // The same positions in both passes so they see the same scene.
+          double offset = 0.01 * (i % 2);
+          for (int a = 0; a < count; a++)
+            {
+            actors[a]->SetPosition(placed[3 * a] + offset, placed[3 * a + 1], placed[3 * a + 2]);
+            }
+          }
+        double start = vtkTimerLog::GetUniversalTime();
+        if (pass == 0)
+          {
+          cellPicker->Pick(positions[2 * i], positions[2 * i + 1], 0, renderer);
+          cellTime += vtkTimerLog::GetUniversalTime() - start;
+          picked[i] = cellPicker->GetActor();
+          }
+        else
+          {
+          actorPicker.Pick(positions[2 * i], positions[2 * i + 1], renderer, hit);
+          actorTime += vtkTimerLog::GetUniversalTime() - start;
+          same += picked[i] == hit.Actor;
+          }
+        }
+      }
+    cout << (moving ? "moving" : "still") << ", " << cellTime * 1.0e6 / picks << ", "
+         << actorTime * 1.0e6 / picks << ", " << cellTime / actorTime << ", "
+         << static_cast<double>(same) / picks << endl;
+    }
+  cout << "picking: hierarchies built " << actorPicker.GetNumberOfBuilds() << endl;
+}
+//***************************************************************
+// Blends K morph targets and a wave into a sphere of about N vertices
+// with MeshDeformationAnimator, writing into the sphere's own points,
+// against the same blend done the way a generic filter would: a new
+// vtkPoints every frame filled through GetPoint/SetPoint. Reports the time
+// per frame and the largest difference between the two results.
+static void BenchmarkDeform(int argc, char *argv[])
+{
+  int vertices = 1000000;
+  int targets = 2;
+  int maxThreads = static_cast<int>(std::thread::hardware_concurrency());
+  for (int i = 0; i < argc; i++)
+    {
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(argv[i], "-vertices") && value)
+      {
+      vertices = atoi(value);
+      }
+    else if (!strcmp(argv[i], "-targets") && value)
+      {
+      targets = atoi(value);
+      }
+    else if (!strcmp(argv[i], "-threads") && value)
+      {
+      maxThreads = atoi(value);
+      }
+    }
+  maxThreads = std::max(1, maxThreads);
+  const int ticks = 20;
+
+  int resolution = std::max(4, static_cast<int>(sqrt(static_cast<double>(vertices))));
+  vtkSmartPointer<vtkSphereSource> source = vtkSmartPointer<vtkSphereSource>::New();
+  source->SetPhiResolution(resolution);
+  source->SetThetaResolution(resolution);
+  source->Update();
+  vtkSmartPointer<vtkPolyData> sphere = vtkSmartPointer<vtkPolyData>::New();
+  sphere->DeepCopy(source->GetOutput());
+  vtkSmartPointer<vtkPoints> base = vtkSmartPointer<vtkPoints>::New();
+  base->DeepCopy(sphere->GetPoints());
+  const vtkIdType n = base->GetNumberOfPoints();
+
+  // Each target stretches the sphere along one axis.
+  std::vector<vtkSmartPointer<vtkPoints> > shapes;
+  for (int k = 0; k < targets; k++)
+    {
+    vtkSmartPointer<vtkPoints> shape = vtkSmartPointer<vtkPoints>::New();
+    shape->SetNumberOfPoints(n);
+    for (vtkIdType p = 0; p < n; p++)
+      {
+      double x[3];
+      base->GetPoint(p, x);
+      x[k % 3] *= 1.5 + 0.25 * (k / 3);
+      shape->SetPoint(p, x);
+      }
+    shapes.push_back(shape);
+    }
+
+  MeshDeformationAnimator deformation;
+  deformation.SetPolyData(sphere);
+  for (int k = 0; k < targets; k++)
+    {
+    int target = deformation.AddTarget(shapes[k]);
+    KeyframeTrack *track = deformation.GetWeightTrack(target);
+    double w0 = 0.0, w1 = 1.0;
+    track->AddKey(0.0, &w0);
+    track->AddKey(5.0, &w1);
+    }
+  const double direction[3] = {0.0, 1.0, 0.0};
+  deformation.SetWave(0.05, 0.5, 0.25, direction);
+  deformation.SetUpdateNormals(false);
+
+  vtkSmartPointer<vtkAnimationCue> cue = vtkSmartPointer<vtkAnimationCue>::New();
+  cue->SetStartTime(0);
+  cue->SetEndTime(5);
+  deformation.AddObserversToCue(cue);
+
+  // The reference blend at the last tick's time, for comparison.
+  const double time = 5.0 * (ticks - 1) / ticks;
+  double reference = 0.0;
+  vtkSmartPointer<vtkPoints> blended;
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int i = 0; i < ticks; i++)
+    {
+    const double t = 5.0 * i / ticks;
+    const double k = 2.0 * 3.14159265358979323846 / 0.5;
+    blended = vtkSmartPointer<vtkPoints>::New();
+    blended->SetNumberOfPoints(n);
+    for (vtkIdType p = 0; p < n; p++)
+      {
+      double b[3], x[3], y[3];
+      base->GetPoint(p, b);
+      double s = 0.05 * sin(k * (b[1] - 0.25 * t));
+      double length = sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+      for (int j = 0; j < 3; j++)
+        {
+        x[j] = b[j] + (length > 0 ? s * b[j] / length : 0.0);
+        }
+      for (int target = 0; target < targets; target++)
+        {
+        shapes[target]->GetPoint(p, y);
+        for (int j = 0; j < 3; j++)
+          {
+          x[j] += t / 5.0 * (y[j] - b[j]);
+          }
+        }
+      blended->SetPoint(p, x);
+      }
+    }
+  reference = (vtkTimerLog::GetUniversalTime() - start) * 1.0e6 / ticks;
+
+  cout << "deform: " << n << " vertices, " << targets << " targets, new points per frame "
+       << reference / 1000.0 << " ms/frame" << endl;
+  cout << "deform: threads, ms/frame, speedup, max difference" << endl;
+  WorkStealingPool pool(1);
+  deformation.SetPool(&pool);
+  for (int threads = 1; ; threads = std::min(2 * threads, maxThreads))
+    {
+    pool.SetNumberOfThreads(threads);
+    double frame = TimeCueTicks(cue, ticks);
+    // Finalize left the end shape; put back the last tick's.
+    deformation.Evaluate(time);
+    double difference = 0.0;
+    for (vtkIdType p = 0; p < n; p++)
+      {
+      double a[3], b[3];
+      sphere->GetPoints()->GetPoint(p, a);
+      blended->GetPoint(p, b);
+      for (int j = 0; j < 3; j++)
+        {
+        difference = std::max(difference, fabs(a[j] - b[j]));
+        }
+      }
+    cout << threads << ", " << frame / 1000.0 << ", " << reference / frame << ", "
+         << difference << endl;
+    if (threads == maxThreads)
+      {
+      break;
+      }
+    }
+}
+//***************************************************************
+// Writes a sequence of sphere meshes of about 2 R^2 triangles each, one
+// legacy .vtk file per timestep, then plays it forward and in reverse
+// through a MeshSequencePlayer rendering offscreen, with several prefetch
+// depths. Frames are paced at F per second, as in real playback, so the
+// reader has the idle part of each frame to get ahead; 0 plays as fast as
+// possible. Reports the hit rate, the time ticks stalled waiting for a
+// read and the time per frame.
+static void BenchmarkMeshes(int argc, char *argv[])
+{
+  int timesteps = 60;
+  int resolution = 200;
+  double fps = 30;
+  for (int i = 0; i < argc; i++)
+    {
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(argv[i], "-fps") && value)
+      {
+      fps = atof(value);
+      }
+    else if (!strcmp(argv[i], "-timesteps") && value)
+      {
+      timesteps = atoi(value);
+      }
+    else if (!strcmp(argv[i], "-resolution") && value)
+      {
+      resolution = atoi(value);
+      }
+    }
+  const char *pattern = "Benchmark_mesh_%04d.vtk";
+
+  std::vector<std::string> fileNames;
+  char name[64];
+  for (int i = 0; i < timesteps; i++)
+    {
+    vtkSmartPointer<vtkSphereSource> source = vtkSmartPointer<vtkSphereSource>::New();
+    source->SetRadius(1.0 + 0.5 * sin(0.2 * i));
+    source->SetPhiResolution(resolution);
+    source->SetThetaResolution(resolution);
+    source->Update();
+    snprintf(name, sizeof(name), pattern, i);
+    vtkSmartPointer<vtkPolyDataWriter> writer = vtkSmartPointer<vtkPolyDataWriter>::New();
+    writer->SetFileName(name);
+    writer->SetFileTypeToBinary();
+#if VTK_MAJOR_VERSION <= 5
+    writer->SetInput(source->GetOutput());
+#else
+    writer->SetInputData(source->GetOutput());
+#endif
+    writer->Write();
+    fileNames.push_back(name);
+    }
+
+  const int prefetch[] = {0, 2, 8};
+  cout << "meshes: " << timesteps << " timesteps, direction, prefetch, hit rate, stall s, ms/frame" << endl;
+  for (int direction = 0; direction < 2; direction++)
+    {
+    for (size_t p = 0; p < sizeof(prefetch) / sizeof(prefetch[0]); p++)
+      {
+      MeshSequencePlayer player;
+      player.SetFileNames(fileNames);
+      player.SetPrefetchCount(prefetch[p]);
+
+      vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+#if VTK_MAJOR_VERSION <= 5
+      mapper->SetInput(player.GetOutput());
+#else
+      mapper->SetInputData(player.GetOutput());
+#endif
+      vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+      actor->SetMapper(mapper);
+      vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+      renderer->AddActor(actor);
+      vtkSmartPointer<vtkRenderWindow> renderWindow = vtkSmartPointer<vtkRenderWindow>::New();
+      renderWindow->OffScreenRenderingOn();
+      renderWindow->SetSize(640, 480);
+      renderWindow->AddRenderer(renderer);
+
+      // One tick per timestep, from the first to the last or back.
+      vtkSmartPointer<vtkAnimationCue> cue = vtkSmartPointer<vtkAnimationCue>::New();
+      cue->SetStartTime(0);
+      cue->SetEndTime(timesteps - 1);
+      player.AddObserversToCue(cue);
+      cue->Initialize();
+      double start = vtkTimerLog::GetUniversalTime();
+      for (int i = 0; i < timesteps; i++)
+        {
+        double time = direction ? timesteps - 1 - i : i;
+        cue->Tick(time, 0, time);
+        renderWindow->Render();
+        if (fps > 0)
+          {
+          double wait = start + (i + 1) / fps - vtkTimerLog::GetUniversalTime();
+          if (wait > 0)
+            {
+            std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>(wait * 1.0e6)));
+            }
+          }
+        }
+      double elapsed = vtkTimerLog::GetUniversalTime() - start;
+      cue->Finalize();
+
+      cout << (direction ? "reverse" : "forward") << ", " << prefetch[p] << ", "
+           << player.GetHitRate() << ", " << player.GetStallTime() << ", "
+           << elapsed * 1.0e3 / timesteps << endl;
+      }
+    }
+
+  for (size_t i = 0; i < fileNames.size(); i++)
+    {
+    remove(fileNames[i].c_str());
+    }
+}
+//***************************************************************
+// A particle-style effect: every frame some of N actors are given a
+// short animation from a random start to a random end, so that about all
+// of them are animated at any time. First each particle gets its own
+// ActorAnimator and cue, deleted when its cue ends, then the animators
+// come from an ActorAnimatorPool driven by one cue. Reports the time per
+// frame and the heap allocations per spawned particle while playing; the
+// pool must not allocate at all. The pool is ticked with the info its cue
+// would pass, leaving out the cue's own event dispatch, which may
+// allocate inside VTK whatever observes it.
+static void BenchmarkSpawn(int argc, char *argv[])
+{
+  int count = 10000;
+  int frames = 600;
+  for (int i = 0; i < argc; i++)
+    {
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(argv[i], "-actors") && value)
+      {
+      count = atoi(value);
+      }
+    else if (!strcmp(argv[i], "-frames") && value)
+      {
+      frames = atoi(value);
+      }
+    }
+  const double frameRate = 60.0;
+  const double life = 0.5;
+  // Spawns per frame so that the effect just fills up the actors.
+  const int spawnsPerFrame = std::max(1, static_cast<int>(count / (life * frameRate + 1.0)));
+
+  std::vector<vtkSmartPointer<vtkActor> > actors(count);
+  for (int i = 0; i < count; i++)
+    {
+    actors[i] = vtkSmartPointer<vtkActor>::New();
+    }
+
+  cout << "spawn: " << count << " actors, " << spawnsPerFrame << " spawns/frame, "
+       << frames << " frames" << endl;
+  cout << "variant, us/frame, spawns, heap allocations/spawn" << endl;
+
+  // One animator and cue per particle.
+    {
+    struct Particle
+      {
+      ActorAnimator *    Animator;
+      vtkAnimationCue *  Cue;
+      int                Actor;
+      };
+    std::vector<Particle> live;
+    std::vector<int> idle;
+    live.reserve(count);
+    idle.reserve(count);
+    for (int i = count; i-- > 0;)
+      {
+      idle.push_back(i);
+      }
+    srand(6);
+    long spawns = 0;
+    long allocations = HeapAllocations.load();
+    double start = vtkTimerLog::GetUniversalTime();
+    for (int f = 0; f < frames; f++)
+      {
+      double time = f / frameRate;
+      for (int s = 0; s < spawnsPerFrame && !idle.empty(); s++, spawns++)
+        {
+        Particle particle;
+        particle.Actor = idle.back();
+        idle.pop_back();
+        double from[3], to[3];
+        for (int c = 0; c < 3; c++)
+          {
+          from[c] = 10.0 * rand() / RAND_MAX - 5.0;
+          to[c] = 10.0 * rand() / RAND_MAX - 5.0;
+          }
+        particle.Animator = new ActorAnimator;
+        particle.Animator->SetActor(actors[particle.Actor]);
+        particle.Animator->SetStartPosition(from);
+        particle.Animator->SetEndPosition(to);
+        particle.Cue = vtkAnimationCue::New();
+        particle.Cue->SetStartTime(time);
+        particle.Cue->SetEndTime(time + life);
+        particle.Animator->AddObserversToCue(particle.Cue);
+        particle.Cue->Initialize();
+        actors[particle.Actor]->VisibilityOn();
+        live.push_back(particle);
+        }
+      for (size_t k = live.size(); k-- > 0;)
+        {
+        live[k].Cue->Tick(time, 1.0 / frameRate, time);
+        if (time >= live[k].Cue->GetEndTime())
+          {
+          live[k].Cue->Delete();
+          delete live[k].Animator;
+          actors[live[k].Actor]->VisibilityOff();
+          idle.push_back(live[k].Actor);
+          live[k] = live.back();
+          live.pop_back();
+          }
+        }
+      }
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    allocations = HeapAllocations.load() - allocations;
+    cout << "animator and cue per particle, " << elapsed * 1.0e6 / frames << ", " << spawns
+         << ", " << static_cast<double>(allocations) / std::max(spawns, 1L) << endl;
+    for (size_t k = 0; k < live.size(); k++)
+      {
+      live[k].Cue->Delete();
+      delete live[k].Animator;
+      }
+    }
+
+  // Pooled animators on one cue.
+    {
+    ActorAnimatorPool pool;
+    pool.Reserve(count);
+    for (int i = 0; i < count; i++)
+      {
+      pool.AddActor(actors[i]);
+      }
+    vtkAnimationCue::AnimationCueInfo info;
+    info.StartTime = 0.0;
+    info.EndTime = frames / frameRate;
+    info.AnimationTime = 0.0;
+    info.DeltaTime = 1.0 / frameRate;
+    info.ClockTime = 0.0;
+    pool.Start(&info);
+    srand(6);
+    long spawns = 0;
+    long allocations = HeapAllocations.load();
+    double start = vtkTimerLog::GetUniversalTime();
+    for (int f = 0; f < frames; f++)
+      {
+      double time = f / frameRate;
+      for (int s = 0; s < spawnsPerFrame; s++, spawns++)
+        {
+        int id = pool.Spawn(life);
+        if (id < 0)
+          {
+          break;
+          }
+        double from[3], to[3];
+        for (int c = 0; c < 3; c++)
+          {
+          from[c] = 10.0 * rand() / RAND_MAX - 5.0;
+          to[c] = 10.0 * rand() / RAND_MAX - 5.0;
+          }
+        pool.GetAnimator(id)->SetStartPosition(from);
+        pool.GetAnimator(id)->SetEndPosition(to);
+        }
+      info.AnimationTime = info.ClockTime = time;
+      pool.Tick(&info);
+      }
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    allocations = HeapAllocations.load() - allocations;
+    pool.End(&info);
+    cout << "ActorAnimatorPool, " << elapsed * 1.0e6 / frames << ", " << spawns
+         << ", " << static_cast<double>(allocations) / std::max(spawns, 1L) << endl;
+    if (allocations)
+      {
+      cout << "FAILED: ActorAnimatorPool made " << allocations
+           << " heap allocations while playing" << endl;
+      Failures++;
+      }
+    else
+      {
+      cout << "ok: no heap allocations while playing" << endl;
+      }
+    }
+}
+//***************************************************************
+// N objects drawing D distinct spheres, written as a text scene with a
+// source declaration per object, as a generator would, and converted to
+// a binary scene. Times reading each with SceneLoader, building the
+// actors and updating the distinct meshes as the first render would,
+// against building the same objects by hand with a source and mapper
+// each. Reports the meshes generated by both.
+static void BenchmarkSceneLoad(int argc, char *argv[])
+{
+  int count = 10000;
+  int distinct = 10;
+  for (int i = 0; i < argc; i++)
+    {
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(argv[i], "-objects") && value)
+      {
+      count = atoi(value);
+      }
+    else if (!strcmp(argv[i], "-meshes") && value)
+      {
+      distinct = std::max(1, atoi(value));
+      }
+    }
+  const char *textFile = "Benchmark.scene";
+  const char *binaryFile = "Benchmark.sceneb";
+
+  std::vector<double> positions(3 * static_cast<size_t>(count));
+  srand(7);
+  for (size_t k = 0; k < positions.size(); k++)
+    {
+    positions[k] = 100.0 * rand() / RAND_MAX - 50.0;
+    }
+  FILE *file = fopen(textFile, "w");
+  if (!file)
+    {
+    cout << "sceneload: cannot write " << textFile << endl;
+    return;
+    }
+  fprintf(file, "property glass color 0 1 0 opacity 0.3\ncue move 0 5\n");
+  for (int i = 0; i < count; i++)
+    {
+    int mesh = i % distinct;
+    fprintf(file, "source s%d sphere radius %g phi %d theta %d\n", i, 1.0 + 0.5 * mesh, 8 + mesh, 16 + mesh);
+    fprintf(file, "actor a%d s%d property glass position %g %g %g\n", i, i,
+            positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+    if (i % 10 == 0)
+      {
+      fprintf(file, "animate a%d move from %g %g %g to 0 0 0\n", i,
+              positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+      }
+    }
+  fclose(file);
+
+  cout << "sceneload: " << count << " objects, " << distinct << " distinct meshes" << endl;
+  cout << "variant, ms, meshes generated" << endl;
+
+  // By hand, a pipeline per object.
+    {
+    double start = vtkTimerLog::GetUniversalTime();
+    vtkSmartPointer<vtkProperty> property = vtkSmartPointer<vtkProperty>::New();
+    property->SetColor(0, 1, 0);
+    property->SetOpacity(0.3);
+    std::vector<vtkSmartPointer<vtkActor> > actors(count);
+    for (int i = 0; i < count; i++)
+      {
+      int mesh = i % distinct;
+      vtkSmartPointer<vtkSphereSource> source = vtkSmartPointer<vtkSphereSource>::New();
+      source->SetRadius(1.0 + 0.5 * mesh);
+      source->SetPhiResolution(8 + mesh);
+      source->SetThetaResolution(16 + mesh);
+      source->Update();
+      vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+      mapper->SetInputConnection(source->GetOutputPort());
+      actors[i] = vtkSmartPointer<vtkActor>::New();
+      actors[i]->SetMapper(mapper);
+      actors[i]->SetProperty(property);
+      actors[i]->SetPosition(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+      }
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    cout << "by hand, " << elapsed * 1.0e3 << ", " << count << endl;
+    }
+
+  const char *files[2] = {textFile, binaryFile};
+  for (int f = 0; f < 2; f++)
+    {
+    SceneLoader loader;
+    double start = vtkTimerLog::GetUniversalTime();
+    if (!loader.Read(files[f]))
+      {
+      cout << "cannot read scene: " << loader.GetErrorMessage() << endl;
+      break;
+      }
+    double read = vtkTimerLog::GetUniversalTime();
+    vtkSmartPointer<vtkAnimationScene> scene = vtkSmartPointer<vtkAnimationScene>::New();
+    loader.Build(0, scene);
+    double built = vtkTimerLog::GetUniversalTime();
+    std::vector<bool> generated(loader.GetNumberOfSources(), false);
+    for (size_t a = 0; a < loader.GetNumberOfActors(); a++)
+      {
+      int source = loader.GetActorDescription(a).Source;
+      if (!generated[source])
+        {
+        loader.GetPolyData(a);
+        generated[source] = true;
+        }
+      }
+    double updated = vtkTimerLog::GetUniversalTime();
+    cout << "SceneLoader " << (f ? "binary" : "text") << ", " << (updated - start) * 1.0e3
+         << " (read " << (read - start) * 1.0e3 << ", build " << (built - read) * 1.0e3
+         << ", meshes " << (updated - built) * 1.0e3 << "), " << loader.GetNumberOfSources() << endl;
+    if (!f && !loader.WriteBinary(binaryFile))
+      {
+      cout << "cannot write " << binaryFile << endl;
+      break;
+      }
+    }
+  remove(textFile);
+  remove(binaryFile);
+}
+//***************************************************************
+// N one-second cues, each moving an actor, staggered at random over a
+// timeline of N / 100 seconds, played in T ticks by a vtkAnimationScene
+// holding every cue, then by a CueScheduler on an empty scene. Reports the
+// time per tick and the cues ticked per tick, then plays both again with
+// a second pass, a backward seek and a forward run, and checks that every
+// actor ends with the same matrix either way and that a cue in normalized
+// time mode is given the same time steps.
+struct DeltaTimeRecorder
+{
+  DeltaTimeRecorder() : Sum(0.0) {}
+  void Start(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info)) {}
+  void Tick(vtkAnimationCue::AnimationCueInfo *info) { this->Sum += info->DeltaTime; }
+  void End(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info)) {}
+  double Sum;
+};
+
+static void BenchmarkCues(int argc, char *argv[])
+{
+  int count = 20000;
+  int ticks = 1000;
+  for (int i = 0; i < argc; i++)
+    {
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(argv[i], "-cues") && value)
+      {
+      count = atoi(value);
+      }
+    else if (!strcmp(argv[i], "-ticks") && value)
+      {
+      ticks = std::max(1, atoi(value));
+      }
+    }
+  const double length = count / 100.0;
+
+  std::vector<double> starts(count), from(3 * static_cast<size_t>(count)), to(from.size());
+  srand(8);
+  for (int i = 0; i < count; i++)
+    {
+    starts[i] = (length - 1.0) * rand() / RAND_MAX;
+    for (int c = 0; c < 3; c++)
+      {
+      from[3 * i + c] = 10.0 * rand() / RAND_MAX - 5.0;
+      to[3 * i + c] = 10.0 * rand() / RAND_MAX - 5.0;
+      }
+    }
+
+  cout << "cues: " << count << " cues over " << length << " s, " << ticks << " ticks" << endl;
+  cout << "variant, us/tick, cues ticked/tick" << endl;
+
+  std::vector<vtkSmartPointer<vtkActor> > actors[2];
+  std::vector<ActorAnimator*> animators[2];
+  DeltaTimeRecorder recorders[2];
+  for (int variant = 0; variant < 2; variant++)
+    {
+    vtkSmartPointer<vtkAnimationScene> scene = vtkSmartPointer<vtkAnimationScene>::New();
+    scene->SetModeToSequence();
+    scene->SetStartTime(0.0);
+    scene->SetEndTime(length);
+    CueScheduler scheduler;
+    scheduler.AddObserversToCue(scene);
+    actors[variant].resize(count);
+    animators[variant].resize(count);
+    for (int i = 0; i < count; i++)
+      {
+      vtkSmartPointer<vtkAnimationCue> cue = vtkSmartPointer<vtkAnimationCue>::New();
+      cue->SetStartTime(starts[i]);
+      cue->SetEndTime(starts[i] + 1.0);
+      actors[variant][i] = vtkSmartPointer<vtkActor>::New();
+      animators[variant][i] = new ActorAnimator;
+      animators[variant][i]->SetActor(actors[variant][i]);
+      animators[variant][i]->SetStartPosition(&from[3 * i]);
+      animators[variant][i]->SetEndPosition(&to[3 * i]);
+      animators[variant][i]->AddObserversToCue(cue);
+      if (variant)
+        {
+        scheduler.AddCue(cue);
+        }
+      else
+        {
+        scene->AddCue(cue);
+        }
+      }
+    vtkSmartPointer<vtkAnimationCue> normalized = vtkSmartPointer<vtkAnimationCue>::New();
+    normalized->SetTimeModeToNormalized();
+    normalized->SetStartTime(0.25);
+    normalized->SetEndTime(0.75);
+    vtkSmartPointer<AnimationCueAdapter<DeltaTimeRecorder> > recorder =
+      vtkSmartPointer<AnimationCueAdapter<DeltaTimeRecorder> >::New();
+    recorder->Animator = &recorders[variant];
+    normalized->AddObserver(vtkCommand::AnimationCueTickEvent, recorder);
+    if (variant)
+      {
+      scheduler.AddCue(normalized);
+      }
+    else
+      {
+      scene->AddCue(normalized);
+      }
+
+    // Playing through once, timed.
+    long ticked = 0;
+    scene->Initialize();
+    double start = vtkTimerLog::GetUniversalTime();
+    for (int i = 0; i <= ticks; i++)
+      {
+      double time = length * i / ticks;
+      scene->Tick(time, i ? length / ticks : 0.0, time);
+      ticked += variant ? static_cast<long>(scheduler.GetNumberOfTickedCues()) : count;
+      }
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    scene->Finalize();
+    cout << (variant ? "CueScheduler" : "vtkAnimationScene") << ", "
+         << elapsed * 1.0e6 / (ticks + 1) << ", " << static_cast<double>(ticked) / (ticks + 1) << endl;
+
+    // Again, as a loop would, then back and forward. The scene needs its
+    // cues initialized again to seek back, the scheduler notices itself.
+    scene->Initialize();
+    for (int i = 0; i <= ticks / 2; i++)
+      {
+      double time = length * i / ticks;
+      scene->Tick(time, 0.0, time);
+      }
+    if (!variant)
+      {
+      scene->Initialize();
+      }
+    for (int i = ticks / 4; i <= 3 * ticks / 8; i++)
+      {
+      double time = length * i / ticks;
+      scene->Tick(time, 0.0, time);
+      }
+    scene->Finalize();
+    }
+
+  double error = 0.0;
+  vtkSmartPointer<vtkMatrix4x4> matrix[2];
+  matrix[0] = vtkSmartPointer<vtkMatrix4x4>::New();
+  matrix[1] = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int i = 0; i < count; i++)
+    {
+    actors[0][i]->GetMatrix(matrix[0]);
+    actors[1][i]->GetMatrix(matrix[1]);
+    for (int k = 0; k < 16; k++)
+      {
+      error = std::max(error, fabs(matrix[0]->Element[k / 4][k % 4] - matrix[1]->Element[k / 4][k % 4]));
+      }
+    delete animators[0][i];
+    delete animators[1][i];
+    }
+  cout << "max matrix difference after looping and seeking, " << error << endl;
+  if (error > 0.0)
+    {
+    cout << "FAILED: CueScheduler and vtkAnimationScene disagree" << endl;
+    Failures++;
+    }
+  cout << "normalized cue time steps, " << recorders[0].Sum << ", " << recorders[1].Sum << endl;
+  if (fabs(recorders[0].Sum - recorders[1].Sum) > 1.0e-9)
+    {
+    cout << "FAILED: CueScheduler gives a normalized cue other time steps" << endl;
+    Failures++;
+    }
+}
+//***************************************************************
+// True when the box lies wholly behind one of the four side planes of
+// a frustum from vtkCamera::GetFrustumPlanes.
+static bool OutsideSidePlanes(const double planes[24], const double bounds[6])
+{
+  for (int p = 0; p < 4; p++)
+    {
+    const double *plane = planes + 4 * p;
+    double distance = plane[3];
+    for (int i = 0; i < 3; i++)
+      {
+      distance += plane[i] * (plane[i] > 0.0 ? bounds[2 * i + 1] : bounds[2 * i]);
+      }
+    if (distance < 0.0)
+      {
+      return true;
+      }
+    }
+  return false;
+}
+//***************************************************************
+// N unit-sized actors scattered over a field a camera sees about a
+// twentieth of, moving by lerp or along Catmull-Rom tracks, some also
+// growing, played over T ticks of a ten second cue during which the
+// camera pans once. Ticking every animator is compared with a
+// CullingActorAnimator. Before the end of the cue, every actor the culling
+// left behind is checked to be off screen, then after CatchUp every
+// matrix is checked against the reference.
+static void BenchmarkCulling(int argc, char *argv[])
+{
+  int count = 5000;
+  int ticks = 600;
+  for (int i = 0; i < argc; i++)
+    {
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(argv[i], "-actors") && value)
+      {
+      count = atoi(value);
+      }
+    else if (!strcmp(argv[i], "-ticks") && value)
+      {
+      ticks = std::max(2, atoi(value));
+      }
+    }
+  const double duration = 10.0;
+  const double modelBounds[6] = {-0.5, 0.5, -0.5, 0.5, -0.5, 0.5};
+
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  vtkCamera *camera = renderer->GetActiveCamera();
+
+  cout << "culling: " << count << " actors, " << ticks << " ticks" << endl;
+  cout << "variant, us/tick, animators committed/tick" << endl;
+
+  std::vector<vtkSmartPointer<vtkActor> > actors[2];
+  std::vector<ActorAnimator*> animators[2];
+  vtkSmartPointer<vtkAnimationCue> cues[2];
+  ParallelActorAnimator all;
+  CullingActorAnimator culling;
+  culling.SetRenderer(renderer);
+  for (int variant = 0; variant < 2; variant++)
+    {
+    vtkSmartPointer<vtkAnimationCue> cue = vtkSmartPointer<vtkAnimationCue>::New();
+    cue->SetStartTime(0.0);
+    cue->SetEndTime(duration);
+    cues[variant] = cue;
+    actors[variant].resize(count);
+    animators[variant].resize(count);
+    srand(11);
+    for (int i = 0; i < count; i++)
+      {
+      actors[variant][i] = vtkSmartPointer<vtkActor>::New();
+      ActorAnimator *animator = new ActorAnimator;
+      animators[variant][i] = animator;
+      animator->SetActor(actors[variant][i]);
+      double from[3], to[3];
+      for (int c = 0; c < 3; c++)
+        {
+        from[c] = (c < 2 ? 160.0 : 10.0) * rand() / RAND_MAX - (c < 2 ? 80.0 : 5.0);
+        to[c] = from[c] + 20.0 * rand() / RAND_MAX - 10.0;
+        }
+      if (i % 2)
+        {
+        KeyframeTrack *track = animator->GetPositionTrack();
+        track->SetInterpolationToCatmullRom();
+        for (int k = 0; k < 5; k++)
+          {
+          double key[3];
+          for (int c = 0; c < 3; c++)
+            {
+            key[c] = from[c] + 10.0 * rand() / RAND_MAX - 5.0;
+            }
+          track->AddKey(duration * k / 4, key);
+          }
+        }
+      else
+        {
+        animator->SetStartPosition(from);
+        animator->SetEndPosition(to);
+        }
+      if (i % 3 == 0)
+        {
+        const double small[3] = {1.0, 1.0, 1.0}, large[3] = {3.0, 1.0, 2.0};
+        animator->GetScaleTrack()->AddKey(0.0, small);
+        animator->GetScaleTrack()->AddKey(duration, large);
+        }
+      if (variant)
+        {
+        culling.AddAnimator(animator, modelBounds);
+        }
+      else
+        {
+        all.AddAnimator(animator);
+        }
+      }
+    if (variant)
+      {
+      culling.AddObserversToCue(cue);
+      }
+    else
+      {
+      all.AddObserversToCue(cue);
+      }
+
+    camera->SetPosition(0.0, 0.0, 60.0);
+    camera->SetFocalPoint(0.0, 0.0, 0.0);
+    camera->SetViewUp(0.0, 1.0, 0.0);
+    camera->SetViewAngle(30.0);
+    // Stopping short of the end, which would catch every actor up.
+    long committed = 0;
+    cue->Initialize();
+    double start = vtkTimerLog::GetUniversalTime();
+    for (int i = 0; i < ticks; i++)
+      {
+      if (i == ticks / 2)
+        {
+        camera->SetPosition(30.0, 0.0, 60.0);
+        camera->SetFocalPoint(30.0, 0.0, 0.0);
+        }
+      double time = duration * i / ticks;
+      cue->Tick(time, 0.0, time);
+      committed += variant ? static_cast<long>(culling.GetNumberOfCommitted()) : count;
+      }
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    cout << (variant ? "CullingActorAnimator" : "every animator") << ", "
+         << elapsed * 1.0e6 / ticks << ", " << static_cast<double>(committed) / ticks << endl;
+    }
+
+  // Whatever was left behind must be out of sight where it should be.
+  double planes[24];
+  camera->GetFrustumPlanes(renderer->GetTiledAspectRatio(), planes);
+  vtkSmartPointer<vtkMatrix4x4> matrix[2];
+  matrix[0] = vtkSmartPointer<vtkMatrix4x4>::New();
+  matrix[1] = vtkSmartPointer<vtkMatrix4x4>::New();
+  int behind = 0, seen = 0;
+  for (int i = 0; i < count; i++)
+    {
+    actors[0][i]->GetMatrix(matrix[0]);
+    actors[1][i]->GetMatrix(matrix[1]);
+    bool same = true;
+    for (int k = 0; k < 16; k++)
+      {
+      same = same && matrix[0]->Element[k / 4][k % 4] == matrix[1]->Element[k / 4][k % 4];
+      }
+    if (same)
+      {
+      continue;
+      }
+    behind++;
+    double bounds[6] = {1e300, -1e300, 1e300, -1e300, 1e300, -1e300};
+    for (int corner = 0; corner < 8; corner++)
+      {
+      double p[3] = {modelBounds[corner & 1], modelBounds[2 + ((corner >> 1) & 1)],
+                     modelBounds[4 + (corner >> 2)]};
+      for (int r = 0; r < 3; r++)
+        {
+        double v = matrix[0]->Element[r][3];
+        for (int c = 0; c < 3; c++)
+          {
+          v += matrix[0]->Element[r][c] * p[c];
+          }
+        bounds[2 * r] = std::min(bounds[2 * r], v);
+        bounds[2 * r + 1] = std::max(bounds[2 * r + 1], v);
+        }
+      }
+    if (!OutsideSidePlanes(planes, bounds))
+      {
+      seen++;
+      }
+    }
+  cout << "actors left behind, " << behind << ", of which on screen, " << seen << endl;
+  if (seen)
+    {
+    cout << "FAILED: an actor on screen was not animated" << endl;
+    Failures++;
+    }
+
+  culling.CatchUp();
+  double error = 0.0;
+  for (int i = 0; i < count; i++)
+    {
+    actors[0][i]->GetMatrix(matrix[0]);
+    actors[1][i]->GetMatrix(matrix[1]);
+    for (int k = 0; k < 16; k++)
+      {
+      error = std::max(error, fabs(matrix[0]->Element[k / 4][k % 4] - matrix[1]->Element[k / 4][k % 4]));
+      }
+    }
+  cout << "max matrix difference after CatchUp, " << error << endl;
+  if (error > 0.0)
+    {
+    cout << "FAILED: culled animators did not catch up" << endl;
+    Failures++;
+    }
+  cues[0]->Finalize();
+  cues[1]->Finalize();
+  for (int i = 0; i < count; i++)
+    {
+    delete animators[0][i];
+    delete animators[1][i];
+    }
+}
+//***************************************************************
+// N spheres with eight levels of detail, from 4 to 50 divisions, drifting
+// toward and away from a camera over F frames. Nothing is rendered: each
+// frame is taken to cost 2 ms plus 40 ns per cell, give or take 10%, and
+// that time is fed to the governor as measured. Reports the mean frame
+// time, the frames over budget after the first second and the level
+// changes, for every sphere at its finest level and for the governor
+// without and with hysteresis, and checks that the governor holds the
+// budget on average.
+static void BenchmarkBudget(int argc, char *argv[])
+{
+  int count = 200;
+  int frames = 600;
+  double budget = 10.0;
+  for (int i = 0; i < argc; i++)
+    {
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(argv[i], "-actors") && value)
+      {
+      count = std::max(1, atoi(value));
+      }
+    else if (!strcmp(argv[i], "-frames") && value)
+      {
+      frames = std::max(1, atoi(value));
+      }
+    else if (!strcmp(argv[i], "-budget") && value)
+      {
+      budget = atof(value);
+      }
+    }
+  const int resolutions[] = {4, 8, 12, 16, 24, 32, 40, 50};
+  const int levels = sizeof(resolutions) / sizeof(resolutions[0]);
+  const int warmup = std::min(frames / 2, 60);
+
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  vtkCamera *camera = renderer->GetActiveCamera();
+  camera->SetPosition(0.0, 0.0, 40.0);
+  camera->SetFocalPoint(0.0, 0.0, 0.0);
+  camera->SetViewAngle(30.0);
+  vtkSmartPointer<vtkSphereSource> sphere = vtkSmartPointer<vtkSphereSource>::New();
+  sphere->SetRadius(1.0);
+
+  std::vector<double> base(3 * static_cast<size_t>(count));
+  srand(5);
+  for (size_t i = 0; i < base.size(); i++)
+    {
+    base[i] = (i % 3 == 2 ? 60.0 : 24.0) * rand() / RAND_MAX - (i % 3 == 2 ? 40.0 : 12.0);
+    }
+
+  cout << "budget: " << count << " spheres, " << frames << " frames, " << budget << " ms budget" << endl;
+  cout << "variant, mean frame ms, frames over budget %, level changes, update us" << endl;
+
+  double governed = 0.0;
+  for (int variant = 0; variant < 3; variant++)
+    {
+    FrameBudgetGovernor governor;
+    governor.SetRenderer(renderer);
+    governor.SetFrameBudget(budget / 1000.0);
+    governor.SetHoldFrames(variant == 2 ? 5 : 0);
+    std::vector<vtkSmartPointer<vtkActor> > actors(count);
+    for (int i = 0; i < count; i++)
+      {
+      vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+      vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+#if VTK_MAJOR_VERSION <= 5
+      mapper->SetInput(output);
+#else
+      mapper->SetInputData(output);
+#endif
+      actors[i] = vtkSmartPointer<vtkActor>::New();
+      actors[i]->SetMapper(mapper);
+      int id = governor.AddActor(actors[i], output);
+      governor.AddSphereLevels(id, sphere, resolutions, levels);
+      }
+
+    srand(6);
+    double total = 0.0, updateTime = 0.0;
+    int over = 0;
+    for (int frame = 0; frame < frames; frame++)
+      {
+      double phase = 2.0 * 3.14159265358979323846 * frame / frames;
+      for (int i = 0; i < count; i++)
+        {
+        actors[i]->SetPosition(base[3 * i], base[3 * i + 1], base[3 * i + 2] + 20.0 * sin(phase + i));
+        }
+      vtkIdType cells = 0;
+      if (variant)
+        {
+        double start = vtkTimerLog::GetUniversalTime();
+        governor.Update();
+        updateTime += vtkTimerLog::GetUniversalTime() - start;
+        cells = governor.GetNumberOfCells();
+        }
+      else
+        {
+        for (int i = 0; i < count; i++)
+          {
+          cells += 2 * resolutions[levels - 1] * (resolutions[levels - 1] / 2);
+          }
+        }
+      double noise = 0.9 + 0.2 * rand() / RAND_MAX;
+      double time = (2.0e-3 + 40.0e-9 * cells) * noise;
+      governor.AddFrameTime(time);
+      if (frame >= warmup)
+        {
+        total += time;
+        over += time > budget / 1000.0;
+        }
+      }
+    double mean = 1000.0 * total / (frames - warmup);
+    cout << (variant == 0 ? "finest" : variant == 1 ? "governor, no hold" : "governor, hold 5") << ", "
+         << mean << ", " << 100.0 * over / (frames - warmup) << ", "
+         << governor.GetTotalLevelChanges() << ", " << (variant ? 1.0e6 * updateTime / frames : 0.0) << endl;
+    if (variant == 2)
+      {
+      governed = mean;
+      governor.PrintStatistics(cout);
+      }
+    }
+  if (governed > 1.05 * budget)
+    {
+    cout << "FAILED: the governor did not hold the budget" << endl;
+    Failures++;
+    }
+}
+//***************************************************************
+// First two checks: a writer thread publishing snapshots of 4096 equal
+// values as fast as it can while the reader checks every one it acquires
+// for a mix of two, then interpolation between two poses of an animator
+// that moves linearly, spins at a constant rate and grows linearly, which
+// should give its pose in between. Then N animators on keyframe tracks
+// played for three seconds in real time while the main thread "renders"
+// for R ms per frame, with every tenth frame taking five times as long:
+// ticking the animators before each render, as the scene does, against a
+// ThreadedActorAnimator at HZ steps per second, with and without
+// interpolation. Reports the animation updates, the longest wait between
+// two of them, the latency of the poses shown and its jitter, and the main
+// thread time spent on animation per frame; checks the final poses.
+static void BenchmarkSimulation(int argc, char *argv[])
+{
+  int count = 2000;
+  double rate = 60.0;
+  double render = 20.0;
+  for (int i = 0; i < argc; i++)
+    {
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(argv[i], "-actors") && value)
+      {
+      count = std::max(1, atoi(value));
+      }
+    else if (!strcmp(argv[i], "-rate") && value)
+      {
+      rate = atof(value);
+      }
+    else if (!strcmp(argv[i], "-render") && value)
+      {
+      render = atof(value);
+      }
+    }
+  const double duration = 3.0;
+
+    {
+    TripleBuffer<std::vector<long> > buffer;
+    for (int i = 0; i < 3; i++)
+      {
+      buffer.GetBuffer(i).assign(4096, -1);
+      }
+    std::atomic<bool> done(false);
+    std::thread writer([&buffer, &done]()
+      {
+      for (long value = 0; !done.load(); value++)
+        {
+        std::vector<long> &values = buffer.GetWriteBuffer();
+        std::fill(values.begin(), values.end(), value);
+        buffer.Publish();
+        }
+      });
+    long acquired = 0, torn = 0;
+    double end = vtkTimerLog::GetUniversalTime() + 0.5;
+    while (vtkTimerLog::GetUniversalTime() < end)
+      {
+      if (buffer.Acquire())
+        {
+        const std::vector<long> &values = buffer.GetReadBuffer();
+        acquired++;
+        torn += std::count(values.begin(), values.end(), values[0]) != static_cast<long>(values.size());
+        }
+      std::this_thread::yield();
+      }
+    done.store(true);
+    writer.join();
+    cout << "simulation: triple buffer, " << acquired << " snapshots acquired, " << torn << " torn" << endl;
+    if (!acquired || torn)
+      {
+      cout << "FAILED: triple buffer snapshots torn or missing" << endl;
+      Failures++;
+      }
+    }
+
+    {
+    ActorAnimator animator;
+    const double from[3] = {1.0, -2.0, 0.5}, to[3] = {-3.0, 4.0, 2.0};
+    const double small[3] = {1.0, 0.5, 2.0}, large[3] = {2.0, 1.5, 1.0};
+    animator.SetStartPosition(from);
+    animator.SetEndPosition(to);
+    animator.SetAngularVelocity(90.0);
+    animator.GetScaleTrack()->AddKey(0.0, small);
+    animator.GetScaleTrack()->AddKey(duration, large);
+    double error = 0.0;
+    for (int i = 0; i < 100; i++)
+      {
+      double t0 = (duration - 0.1) * i / 100, t1 = t0 + 0.1, u = (i % 10 + 0.5) / 10;
+      double m0[16], m1[16], expected[16], m[16];
+      animator.EvaluateMatrix(t0, duration, m0);
+      animator.EvaluateMatrix(t1, duration, m1);
+      animator.EvaluateMatrix(t0 + u * (t1 - t0), duration, expected);
+      ThreadedActorAnimator::InterpolateMatrix(m0, m1, u, m);
+      for (int k = 0; k < 16; k++)
+        {
+        error = std::max(error, fabs(m[k] - expected[k]));
+        }
+      }
+    cout << "simulation: interpolation error, " << error << endl;
+    if (error > 1e-9)
+      {
+      cout << "FAILED: interpolated poses are off" << endl;
+      Failures++;
+      }
+    }
+
+  cout << "simulation: " << count << " actors, " << rate << " steps/s, "
+       << render << " ms renders" << endl;
+  cout << "variant, frames, animation updates, longest wait ms, latency ms, "
+       << "latency jitter ms, main thread animation us/frame" << endl;
+  std::vector<vtkSmartPointer<vtkActor> > actors(count);
+  std::vector<ActorAnimator*> animators(count);
+  srand(12);
+  for (int i = 0; i < count; i++)
+    {
+    actors[i] = vtkSmartPointer<vtkActor>::New();
+    animators[i] = new ActorAnimator;
+    animators[i]->SetActor(actors[i]);
+    KeyframeTrack *track = animators[i]->GetPositionTrack();
+    track->SetInterpolationToCatmullRom();
+    for (int k = 0; k < 8; k++)
+      {
+      double key[3];
+      for (int c = 0; c < 3; c++)
+        {
+        key[c] = 20.0 * rand() / RAND_MAX - 10.0;
+        }
+      track->AddKey(duration * k / 7, key);
+      }
+    }
+
+  vtkAnimationCue::AnimationCueInfo info;
+  info.StartTime = 0.0;
+  info.EndTime = duration;
+  info.DeltaTime = 0.0;
+  for (int variant = 0; variant < 3; variant++)
+    {
+    ThreadedActorAnimator threaded;
+    threaded.SetStepsPerSecond(rate);
+    threaded.SetInterpolate(variant == 2);
+    for (int i = 0; i < count; i++)
+      {
+      threaded.AddAnimator(animators[i]);
+      }
+    info.AnimationTime = info.ClockTime = 0.0;
+    int frames = 0;
+    double animating = 0.0, longest = 0.0, latencySum = 0.0, latencySquareSum = 0.0;
+    double start = vtkTimerLog::GetUniversalTime(), last = start;
+    if (variant)
+      {
+      threaded.Start(&info);
+      }
+    for (double now = start; now - start < duration; now = vtkTimerLog::GetUniversalTime())
+      {
+      double before = vtkTimerLog::GetUniversalTime();
+      if (variant)
+        {
+        threaded.Tick(&info);
+        }
+      else
+        {
+        // The pose is as old as the time it was evaluated for.
+        info.AnimationTime = info.ClockTime = before - start;
+        for (int i = 0; i < count; i++)
+          {
+          animators[i]->Evaluate(&info);
+          animators[i]->Commit();
+          }
+        longest = std::max(longest, before - last);
+        last = before;
+        }
+      double after = vtkTimerLog::GetUniversalTime();
+      animating += after - before;
+      frames++;
+      double frame = (frames % 10 ? 1.0 : 5.0) * render / 1000.0;
+      if (!variant)
+        {
+        // The poses shown were evaluated before this frame's render.
+        double latency = 0.5 * frame + (after - before);
+        latencySum += latency;
+        latencySquareSum += latency * latency;
+        }
+      std::this_thread::sleep_for(std::chrono::duration<double>(frame));
+      }
+    long updates = frames;
+    double latency = latencySum / frames;
+    double jitter = sqrt(std::max(0.0, latencySquareSum / frames - latency * latency));
+    if (variant)
+      {
+      threaded.End(&info);
+      updates = static_cast<long>(threaded.GetNumberOfSteps());
+      longest = threaded.GetStep() + threaded.GetMaximumStepLateness();
+      latency = threaded.GetMeanLatency();
+      jitter = threaded.GetLatencyJitter();
+      }
+    cout << (variant == 0 ? "tick before render" : variant == 1 ? "threaded" : "threaded, interpolated")
+         << ", " << frames << ", " << updates << ", " << 1000.0 * longest << ", " << 1000.0 * latency
+         << ", " << 1000.0 * jitter << ", " << 1.0e6 * animating / frames << endl;
+    if (variant)
+      {
+      threaded.PrintStatistics(cout);
+      }
+    }
+
+  double error = 0.0;
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int i = 0; i < count; i++)
+    {
+    double expected[16];
+    animators[i]->EvaluateMatrix(duration, duration, expected);
+    actors[i]->GetMatrix(matrix);
+    for (int k = 0; k < 16; k++)
+      {
+      error = std::max(error, fabs(matrix->Element[k / 4][k % 4] - expected[k]));
+      }
+    delete animators[i];
+    }
+  cout << "max matrix difference from the final poses, " << error << endl;
+  if (error > 0.0)
+    {
+    cout << "FAILED: the threaded animation did not end on the final poses" << endl;
+    Failures++;
+    }
+}
+//***************************************************************
+
+//***************************************************************
+int main(int argc, char *argv[])
+{
+  const char *name = argc > 1 ? argv[1] : 0;
+
+  if (!name || !strcmp(name, "batch"))
+    {
+    BenchmarkBatchAnimator();
+    }
+  if (!name || !strcmp(name, "broadphase"))
+    {
+    BenchmarkBroadPhase();
+    }
+  if (!name || !strcmp(name, "rays"))
+    {
+    BenchmarkRays();
+    }
+  if (!name || !strcmp(name, "instancing"))
+    {
+    BenchmarkInstancing();
+    }
+  if (!name || !strcmp(name, "baked"))
+    {
+    BenchmarkBaked();
+    }
+  if (!name || !strcmp(name, "parallel"))
+    {
+    BenchmarkParallel(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "templates"))
+    {
+    BenchmarkTemplates(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "spawn"))
+    {
+    BenchmarkSpawn(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "picking"))
+    {
+    BenchmarkPicking(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "deform"))
+    {
+    BenchmarkDeform(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "meshes"))
+    {
+    BenchmarkMeshes(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "cues"))
+    {
+    BenchmarkCues(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "culling"))
+    {
+    BenchmarkCulling(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "budget"))
+    {
+    BenchmarkBudget(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "simulation"))
+    {
+    BenchmarkSimulation(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "sceneload"))
+    {
+    BenchmarkSceneLoad(argc - 2, argv + 2);
+    }
+  if (!name || !strcmp(name, "scene"))
+    {
+    BenchmarkScene(argc - 2, argv + 2);
+    }
+
+  return Failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
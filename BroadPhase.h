@@ -0,0 +1,368 @@
+#ifndef __BroadPhase_h
+#define __BroadPhase_h
+#include <vtkActor.h>
+#include <vtkMapper.h>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Finds the actors whose world bounding boxes overlap, with a uniform
+// spatial hash. Every registered actor keeps its model-space box; when an
+// actor moves (MarkMoved, called by ActorAnimator::Tick) only its world
+// box is recomputed from its current matrix at the next Update(), and it
+// only changes hash cells if it crossed a cell boundary.
+// Boxes are compared only with boxes sharing a cell. A pair sharing more
+// than one cell is reported from the first of them, so no pair is tested
+// twice. Sweep and prune along one axis is not used: with actors spread
+// through a volume most X intervals overlap and it grows close to
+// quadratic.
+// Cell coordinates are packed in 21 bits per axis. A box reaching beyond
+// that range (about a million cells from the origin), or with non-finite
+// bounds, is kept out of the grid and tested against every other box.
+// The pairs returned are candidates for a narrow-phase test such as
+// MeshIntersector.
+class BroadPhase
+{
+public:
+  BroadPhase()
+    {
+    this->CellSize = 0.0;
+    this->NumberOfOutsideGrid = 0;
+    }
+
+  ~BroadPhase()
+    {
+    this->RemoveAllActors();
+    }
+
+  // Registers an actor and returns its id. Without modelBounds the bounds
+  // of the actor's mapper are used.
+  int AddActor(vtkActor *actor, const double *modelBounds = 0)
+    {
+    int id = static_cast<int>(this->Actors.size());
+    actor->Register(0);
+    this->Actors.push_back(actor);
+    double bounds[6] = {0, 0, 0, 0, 0, 0};
+    if (modelBounds)
+      {
+      std::copy(modelBounds, modelBounds + 6, bounds);
+      }
+    else if (actor->GetMapper() && actor->GetMapper()->GetBounds())
+      {
+      std::copy(actor->GetMapper()->GetBounds(), actor->GetMapper()->GetBounds() + 6, bounds);
+      }
+    this->ModelBounds.insert(this->ModelBounds.end(), bounds, bounds + 6);
+    for (int c = 0; c < 3; c++)
+      {
+      this->Min[c].push_back(0.0);
+      this->Max[c].push_back(0.0);
+      }
+    this->IsMoved.push_back(false);
+    for (int c = 0; c < 6; c++)
+      {
+      this->Cells.push_back(0);
+      }
+    this->InGrid.push_back(false);
+    this->OutsideGrid.push_back(false);
+    this->MarkMoved(id);
+    return id;
+    }
+
+  void RemoveAllActors()
+    {
+    for (size_t i = 0; i < this->Actors.size(); i++)
+      {
+      this->Actors[i]->UnRegister(0);
+      }
+    this->Actors.clear();
+    this->ModelBounds.clear();
+    for (int c = 0; c < 3; c++)
+      {
+      this->Min[c].clear();
+      this->Max[c].clear();
+      }
+    this->IsMoved.clear();
+    this->Moved.clear();
+    this->Cells.clear();
+    this->InGrid.clear();
+    this->OutsideGrid.clear();
+    this->NumberOfOutsideGrid = 0;
+    this->Grid.clear();
+    this->Pairs.clear();
+    }
+
+  // Edge length of the hash cells. Best around the size of a typical
+  // box; when not set it is four times the mean box size at the first
+  // Update().
+  void SetCellSize(double size)
+    {
+    this->CellSize = size;
+    this->Grid.clear();
+    std::fill(this->InGrid.begin(), this->InGrid.end(), false);
+    std::fill(this->OutsideGrid.begin(), this->OutsideGrid.end(), false);
+    this->NumberOfOutsideGrid = 0;
+    for (size_t id = 0; id < this->Actors.size(); id++)
+      {
+      this->MarkMoved(static_cast<int>(id));
+      }
+    }
+  double GetCellSize() const { return this->CellSize; }
+
+  int GetNumberOfActors() const         { return static_cast<int>(this->Actors.size()); }
+  vtkActor *GetActor(int id) const      { return this->Actors[id]; }
+
+  // The actor's transform changed; its box is refreshed on Update().
+  void MarkMoved(int id)
+    {
+    if (!this->IsMoved[id])
+      {
+      this->IsMoved[id] = true;
+      this->Moved.push_back(id);
+      }
+    }
+
+  void GetWorldBounds(int id, double bounds[6]) const
+    {
+    for (int c = 0; c < 3; c++)
+      {
+      bounds[2 * c] = this->Min[c][id];
+      bounds[2 * c + 1] = this->Max[c][id];
+      }
+    }
+
+  // Refreshes moved boxes, moves them between cells and collects the
+  // overlapping pairs.
+  void Update()
+    {
+    for (size_t i = 0; i < this->Moved.size(); i++)
+      {
+      this->UpdateWorldBounds(this->Moved[i]);
+      }
+    if (this->CellSize <= 0.0 && !this->Actors.empty())
+      {
+      double size = 0.0;
+      for (size_t id = 0; id < this->Actors.size(); id++)
+        {
+        for (int c = 0; c < 3; c++)
+          {
+          size += this->Max[c][id] - this->Min[c][id];
+          }
+        }
+      this->CellSize = size > 0.0 ? 4.0 * size / (3.0 * this->Actors.size()) : 1.0;
+      }
+    for (size_t i = 0; i < this->Moved.size(); i++)
+      {
+      int id = this->Moved[i];
+      this->UpdateCells(id);
+      this->IsMoved[id] = false;
+      }
+    this->Moved.clear();
+
+    this->Pairs.clear();
+    for (GridType::iterator cell = this->Grid.begin(); cell != this->Grid.end(); ++cell)
+      {
+      const std::vector<int> &ids = cell->second;
+      if (ids.size() < 2)
+        {
+        continue;
+        }
+      int x, y, z;
+      DecodeCell(cell->first, &x, &y, &z);
+      for (size_t i = 0; i < ids.size(); i++)
+        {
+        int a = ids[i];
+        const int *ca = &this->Cells[6 * a];
+        for (size_t j = i + 1; j < ids.size(); j++)
+          {
+          int b = ids[j];
+          const int *cb = &this->Cells[6 * b];
+          // Report the pair only from the lowest cell both boxes touch.
+          if (std::max(ca[0], cb[0]) != x || std::max(ca[2], cb[2]) != y ||
+              std::max(ca[4], cb[4]) != z)
+            {
+            continue;
+            }
+          if (this->Overlap(a, b))
+            {
+            this->Pairs.push_back(a < b ? std::make_pair(a, b) : std::make_pair(b, a));
+            }
+          }
+        }
+      }
+    if (this->NumberOfOutsideGrid)
+      {
+      const int n = static_cast<int>(this->Actors.size());
+      for (int a = 0; a < n; a++)
+        {
+        if (!this->OutsideGrid[a])
+          {
+          continue;
+          }
+        for (int b = 0; b < n; b++)
+          {
+          // Pairs of two outside boxes are tested once, from the smaller id.
+          if (b != a && !(this->OutsideGrid[b] && b < a) && this->Overlap(a, b))
+            {
+            this->Pairs.push_back(a < b ? std::make_pair(a, b) : std::make_pair(b, a));
+            }
+          }
+        }
+      }
+    // The hash map iterates in no particular order; sort so the result
+    // does not depend on it.
+    std::sort(this->Pairs.begin(), this->Pairs.end());
+    }
+
+  // Pairs of actor ids (smaller id first) found by the last Update().
+  const std::vector<std::pair<int, int> > &GetPairs() const
+    {
+    return this->Pairs;
+    }
+
+protected:
+  typedef std::unordered_map<unsigned long long, std::vector<int> > GridType;
+
+  // Cells are packed in 21 bits per axis, two's complement, so each
+  // coordinate must lie in [-CellLimit, CellLimit).
+  enum
+    {
+    CellBits = 21,
+    CellLimit = 1 << (CellBits - 1)
+    };
+  static unsigned long long EncodeCell(int x, int y, int z)
+    {
+    const unsigned long long mask = (1ULL << CellBits) - 1;
+    return ((static_cast<unsigned long long>(x) & mask) << (2 * CellBits)) |
+      ((static_cast<unsigned long long>(y) & mask) << CellBits) |
+      (static_cast<unsigned long long>(z) & mask);
+    }
+  static int DecodeCoordinate(unsigned long long field)
+    {
+    int value = static_cast<int>(field & ((1ULL << CellBits) - 1));
+    return value >= CellLimit ? value - 2 * CellLimit : value;
+    }
+  static void DecodeCell(unsigned long long key, int *x, int *y, int *z)
+    {
+    *x = DecodeCoordinate(key >> (2 * CellBits));
+    *y = DecodeCoordinate(key >> CellBits);
+    *z = DecodeCoordinate(key);
+    }
+
+  bool Overlap(int a, int b) const
+    {
+    return this->Min[0][b] <= this->Max[0][a] && this->Min[0][a] <= this->Max[0][b] &&
+      this->Min[1][b] <= this->Max[1][a] && this->Min[1][a] <= this->Max[1][b] &&
+      this->Min[2][b] <= this->Max[2][a] && this->Min[2][a] <= this->Max[2][b];
+    }
+
+  // Moves the actor to the cells covered by its world box, if they changed.
+  void UpdateCells(int id)
+    {
+    double bounds[6];
+    bool outside = false;
+    for (int c = 0; c < 3; c++)
+      {
+      bounds[2 * c] = floor(this->Min[c][id] / this->CellSize);
+      bounds[2 * c + 1] = floor(this->Max[c][id] / this->CellSize);
+      // Also false for NaN.
+      outside = outside || !(bounds[2 * c] >= -CellLimit && bounds[2 * c + 1] < CellLimit);
+      }
+    if (outside != this->OutsideGrid[id])
+      {
+      this->OutsideGrid[id] = outside;
+      this->NumberOfOutsideGrid += outside ? 1 : -1;
+      }
+    int *cells = &this->Cells[6 * id];
+    if (outside)
+      {
+      if (this->InGrid[id])
+        {
+        this->ForEachCell(cells, id, false);
+        this->InGrid[id] = false;
+        }
+      return;
+      }
+    int range[6];
+    for (int c = 0; c < 6; c++)
+      {
+      range[c] = static_cast<int>(bounds[c]);
+      }
+    if (this->InGrid[id])
+      {
+      if (std::equal(range, range + 6, cells))
+        {
+        return;
+        }
+      this->ForEachCell(cells, id, false);
+      }
+    std::copy(range, range + 6, cells);
+    this->ForEachCell(cells, id, true);
+    this->InGrid[id] = true;
+    }
+
+  void ForEachCell(const int *range, int id, bool insert)
+    {
+    for (int x = range[0]; x <= range[1]; x++)
+      {
+      for (int y = range[2]; y <= range[3]; y++)
+        {
+        for (int z = range[4]; z <= range[5]; z++)
+          {
+          unsigned long long key = EncodeCell(x, y, z);
+          if (insert)
+            {
+            this->Grid[key].push_back(id);
+            continue;
+            }
+          GridType::iterator cell = this->Grid.find(key);
+          std::vector<int> &ids = cell->second;
+          *std::find(ids.begin(), ids.end(), id) = ids.back();
+          // Empty cells are kept so their storage is reused when a box
+          // comes back.
+          ids.pop_back();
+          }
+        }
+      }
+    }
+
+  void UpdateWorldBounds(int id)
+    {
+    double m[16];
+    this->Actors[id]->GetMatrix(m);
+    const double *b = &this->ModelBounds[6 * id];
+    double center[3], half[3];
+    for (int c = 0; c < 3; c++)
+      {
+      center[c] = 0.5 * (b[2 * c] + b[2 * c + 1]);
+      half[c] = 0.5 * (b[2 * c + 1] - b[2 * c]);
+      }
+    for (int r = 0; r < 3; r++)
+      {
+      double x = m[4 * r] * center[0] + m[4 * r + 1] * center[1] + m[4 * r + 2] * center[2] + m[4 * r + 3];
+      double e = fabs(m[4 * r]) * half[0] + fabs(m[4 * r + 1]) * half[1] + fabs(m[4 * r + 2]) * half[2];
+      this->Min[r][id] = x - e;
+      this->Max[r][id] = x + e;
+      }
+    }
+
+  std::vector<vtkActor*>            Actors;
+  std::vector<double>               ModelBounds;
+  std::vector<double>               Min[3];
+  std::vector<double>               Max[3];
+  std::vector<bool>                 IsMoved;
+  std::vector<int>                  Moved;
+  // Cell range (x0, x1, y0, y1, z0, z1) each actor is stored in.
+  std::vector<int>                  Cells;
+  std::vector<bool>                 InGrid;
+  // Boxes beyond the range of the cell coordinates.
+  std::vector<bool>                 OutsideGrid;
+  int                               NumberOfOutsideGrid;
+  GridType                          Grid;
+  double                            CellSize;
+  std::vector<std::pair<int, int> > Pairs;
+};
+
+#endif
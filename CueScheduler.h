@@ -0,0 +1,287 @@
+#ifndef __CueScheduler_h
+#define __CueScheduler_h
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+
+// Ticks many cues from one driving cue, usually the vtkAnimationScene
+// itself, touching only the cues that matter for the tick.
+// vtkAnimationScene ticks every cue it holds on every tick; with tens of
+// thousands of short cues staggered over a long timeline almost all of
+// those calls do nothing. Here the cue intervals are kept sorted by start
+// time in an implicit balanced tree, each node holding the latest end
+// time below it, so that a tick finds the k cues whose interval overlaps
+// the time swept since the previous tick in O(k log n) at worst: the max
+// end only prunes whole subtrees, so each hit can cost a walk down the
+// tree. Those cues are ticked in the order they were added, with the time
+// and time step the scene would have given them, so each still sends its
+// own Start, Tick and End events:
+// a cue entered or crossed between two ticks gets its Start and End as in
+// the scene.
+//
+// Seeking backwards, and the driving cue starting again (a looping
+// scene), start over from the beginning of the timeline: the cues are
+// initialized again, lazily, the first time they are ticked afterwards,
+// and the cues already over are started and ended again as
+// vtkAnimationScene::SetAnimationTime does. When the driving cue ends,
+// the cues still running are finalized.
+//
+// Cues added here must not also be added to the scene. Their start and
+// end times, relative or normalized to the driving cue, are read when the
+// tree is rebuilt: on the first tick after a cue is added, or after
+// Modified is called.
+class CueScheduler
+{
+public:
+  CueScheduler()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->Dirty = true;
+    this->Duration = 0.0;
+    this->BuildDuration = 0.0;
+    this->HasNormalized = false;
+    this->Previous = 0.0;
+    this->Generation = 1;
+    this->NumberOfTickedCues = 0;
+    }
+
+  ~CueScheduler()
+    {
+    this->RemoveAllCues();
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // Returns the index of the cue.
+  int AddCue(vtkAnimationCue *cue)
+    {
+    cue->Register(0);
+    Entry entry;
+    entry.Cue = cue;
+    entry.Generation = 0;
+    this->Entries.push_back(entry);
+    this->Dirty = true;
+    return static_cast<int>(this->Entries.size()) - 1;
+    }
+
+  void RemoveAllCues()
+    {
+    for (size_t i = 0; i < this->Entries.size(); i++)
+      {
+      this->Entries[i].Cue->UnRegister(0);
+      }
+    this->Entries.clear();
+    this->Touched.clear();
+    this->Dirty = true;
+    }
+
+  size_t GetNumberOfCues() const
+    {
+    return this->Entries.size();
+    }
+
+  // Call after changing the start or end time of cues already added.
+  void Modified()
+    {
+    this->Dirty = true;
+    }
+
+  // Cues ticked by the last tick.
+  size_t GetNumberOfTickedCues() const
+    {
+    return this->NumberOfTickedCues;
+    }
+
+  // With a higher priority than the default, so that on the scene the
+  // cues are ticked before observers rendering the scene tick.
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer, 1.0);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer, 1.0);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer, 1.0);
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    this->Duration = info->EndTime - info->StartTime;
+    this->Restart();
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    FRAME_PROFILE_SCOPE("CueScheduler::Tick");
+    this->Duration = info->EndTime - info->StartTime;
+    double time = info->AnimationTime - info->StartTime;
+    if (time < this->Previous)
+      {
+      this->Restart();
+      }
+    this->Sweep(this->Previous, time, info->DeltaTime, info->ClockTime);
+    this->Previous = time;
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    for (size_t i = 0; i < this->Touched.size(); i++)
+      {
+      this->Entries[this->Touched[i]].Cue->Finalize();
+      }
+    this->Restart();
+    }
+
+protected:
+  void Restart()
+    {
+    this->Generation++;
+    this->Touched.clear();
+    this->Previous = 0.0;
+    }
+
+  // Ticks, at time, the cues overlapping [from, to].
+  void Sweep(double from, double time, double deltaTime, double clockTime)
+    {
+    if (this->Dirty || (this->HasNormalized && this->Duration != this->BuildDuration))
+      {
+      this->Build();
+      }
+    this->Hits.clear();
+    this->Query(0, this->Starts.size(), from, time);
+    // Tree order is start order; the scene ticks in the order of addition.
+    std::sort(this->Hits.begin(), this->Hits.end());
+    for (size_t h = 0; h < this->Hits.size(); h++)
+      {
+      Entry &entry = this->Entries[this->Hits[h]];
+      if (entry.Generation != this->Generation)
+        {
+        entry.Cue->Initialize();
+        entry.Generation = this->Generation;
+        this->Touched.push_back(this->Hits[h]);
+        }
+      double local = time;
+      double localDelta = deltaTime;
+      if (entry.Cue->GetTimeMode() == vtkAnimationCue::TIMEMODE_NORMALIZED)
+        {
+        // Normalized cues get the time and the time step as fractions of
+        // the driving cue, as vtkAnimationScene gives them.
+        local = this->Duration > 0.0 ? time / this->Duration : 0.0;
+        localDelta = this->Duration > 0.0 ? deltaTime / this->Duration : 0.0;
+        }
+      entry.Cue->Tick(local, localDelta, clockTime);
+      }
+    this->NumberOfTickedCues = this->Hits.size();
+    }
+
+  // Sorts the intervals by start, then fills MaxEnds bottom up over the
+  // implicit tree in which the root of [lo, hi) is its middle.
+  void Build()
+    {
+    const size_t n = this->Entries.size();
+    std::vector<std::pair<double, int> > order(n);
+    this->HasNormalized = false;
+    for (size_t i = 0; i < n; i++)
+      {
+      vtkAnimationCue *cue = this->Entries[i].Cue;
+      double scale = 1.0;
+      if (cue->GetTimeMode() == vtkAnimationCue::TIMEMODE_NORMALIZED)
+        {
+        scale = this->Duration;
+        this->HasNormalized = true;
+        }
+      this->Entries[i].StartTime = cue->GetStartTime() * scale;
+      this->Entries[i].EndTime = cue->GetEndTime() * scale;
+      order[i] = std::make_pair(this->Entries[i].StartTime, static_cast<int>(i));
+      }
+    std::sort(order.begin(), order.end());
+    this->Starts.resize(n);
+    this->Ends.resize(n);
+    this->MaxEnds.resize(n);
+    this->Indices.resize(n);
+    for (size_t i = 0; i < n; i++)
+      {
+      this->Indices[i] = order[i].second;
+      this->Starts[i] = order[i].first;
+      this->Ends[i] = this->Entries[order[i].second].EndTime;
+      }
+    if (n)
+      {
+      this->BuildMaxEnds(0, n);
+      }
+    this->BuildDuration = this->Duration;
+    this->Dirty = false;
+    }
+
+  double BuildMaxEnds(size_t lo, size_t hi)
+    {
+    size_t mid = lo + (hi - lo) / 2;
+    double maxEnd = this->Ends[mid];
+    if (lo < mid)
+      {
+      maxEnd = std::max(maxEnd, this->BuildMaxEnds(lo, mid));
+      }
+    if (mid + 1 < hi)
+      {
+      maxEnd = std::max(maxEnd, this->BuildMaxEnds(mid + 1, hi));
+      }
+    this->MaxEnds[mid] = maxEnd;
+    return maxEnd;
+    }
+
+  void Query(size_t lo, size_t hi, double from, double to)
+    {
+    while (lo < hi)
+      {
+      size_t mid = lo + (hi - lo) / 2;
+      if (this->MaxEnds[mid] < from)
+        {
+        return;
+        }
+      this->Query(lo, mid, from, to);
+      if (this->Starts[mid] > to)
+        {
+        return;
+        }
+      if (this->Ends[mid] >= from)
+        {
+        this->Hits.push_back(this->Indices[mid]);
+        }
+      lo = mid + 1;
+      }
+    }
+
+  typedef AnimationCueAdapter<CueScheduler> AnimationCueObserver;
+
+  struct Entry
+    {
+    vtkAnimationCue * Cue;
+    double            StartTime;
+    double            EndTime;
+    // Restart count when the cue was last initialized.
+    unsigned long     Generation;
+    };
+
+  AnimationCueObserver *  Observer;
+  std::vector<Entry>      Entries;
+  // The tree, in start order.
+  std::vector<double>     Starts;
+  std::vector<double>     Ends;
+  std::vector<double>     MaxEnds;
+  std::vector<int>        Indices;
+  std::vector<int>        Hits;
+  // Cues initialized since the last restart.
+  std::vector<int>        Touched;
+  bool                    Dirty;
+  bool                    HasNormalized;
+  double                  Duration;
+  double                  BuildDuration;
+  double                  Previous;
+  unsigned long           Generation;
+  size_t                  NumberOfTickedCues;
+};
+
+#endif
@@ -0,0 +1,610 @@
+#ifndef __DeformationAnimator_h
+#define __DeformationAnimator_h
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <cmath>
+#include <vector>
+
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+#include "KeyframeTrack.h"
+#include "RenderScheduler.h"
+#include "WorkStealingPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEFORMATION_ANIMATOR_SSE
+#include <emmintrin.h>
+#endif
+
+// Deforms the points of a polydata in place: morph targets (blend shapes)
+// plus an optional travelling wave.
+//
+// The base mesh and every target are copied once into float arrays laid
+// out as structure of arrays (all X, then all Y, then all Z), padded to a
+// multiple of four vertices. Each tick the kernel reads four vertices at a
+// time, adds the weighted target offsets and the wave displacement in SSE
+// registers, and writes the result straight into the float buffer the
+// polydata's vtkPoints already owns, so nothing is allocated per frame.
+// Only the points (and the normals, when they are blended) are marked
+// modified, so the mapper re-uploads just those arrays.
+//
+// Target weights are constant or come from keyframe tracks with times
+// relative to the start of the cue. The wave moves points along the base
+// normals, or away from the centroid when the mesh has no normals; the
+// normals themselves are only blended between the targets, not bent by
+// the wave.
+class MeshDeformationAnimator
+{
+public:
+  MeshDeformationAnimator()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->PolyData = 0;
+    this->Points = 0;
+    this->Normals = 0;
+    this->NumberOfPoints = 0;
+    this->UpdateNormals = true;
+    this->NormalsBent = false;
+    this->WaveAmplitude = 0.0;
+    this->WaveLength = 1.0;
+    this->WaveSpeed = 1.0;
+    this->WaveDirection[0] = 1.0;
+    this->WaveDirection[1] = 0.0;
+    this->WaveDirection[2] = 0.0;
+    this->Pool = 0;
+    this->GrainSize = 4096;
+    this->Scheduler = 0;
+    }
+
+  ~MeshDeformationAnimator()
+    {
+    this->SetPolyData(0);
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // The polydata deformed in place, typically the input of the actor's
+  // mapper. Points (and normals) that are not float are converted to float
+  // once here. Setting a new polydata removes all targets.
+  void SetPolyData(vtkPolyData *polyData)
+    {
+    this->RemoveAllTargets();
+    if (this->PolyData)
+      {
+      this->PolyData->UnRegister(0);
+      }
+    this->PolyData = polyData;
+    this->Points = 0;
+    this->Normals = 0;
+    this->NumberOfPoints = 0;
+    this->NormalsBent = false;
+    for (int i = 0; i < 3; i++)
+      {
+      this->Base[i].clear();
+      this->BaseNormal[i].clear();
+      this->Direction[i].clear();
+      }
+    if (!polyData || !polyData->GetPoints())
+      {
+      return;
+      }
+    polyData->Register(0);
+
+    vtkPoints *points = polyData->GetPoints();
+    this->NumberOfPoints = static_cast<size_t>(points->GetNumberOfPoints());
+    this->Points = vtkFloatArray::SafeDownCast(points->GetData());
+    if (!this->Points)
+      {
+      this->Points = FloatCopy(points->GetData());
+      points->SetData(this->Points);
+      this->Points->Delete();
+      }
+    vtkDataArray *normals = polyData->GetPointData() ? polyData->GetPointData()->GetNormals() : 0;
+    if (normals && normals->GetNumberOfComponents() == 3 &&
+        static_cast<size_t>(normals->GetNumberOfTuples()) == this->NumberOfPoints)
+      {
+      this->Normals = vtkFloatArray::SafeDownCast(normals);
+      if (!this->Normals)
+        {
+        this->Normals = FloatCopy(normals);
+        polyData->GetPointData()->SetNormals(this->Normals);
+        this->Normals->Delete();
+        }
+      }
+
+    const size_t padded = Padded(this->NumberOfPoints);
+    ToStructureOfArrays(this->Points->GetPointer(0), this->NumberOfPoints, this->Base);
+    if (this->Normals)
+      {
+      ToStructureOfArrays(this->Normals->GetPointer(0), this->NumberOfPoints, this->BaseNormal);
+      for (int i = 0; i < 3; i++)
+        {
+        this->Direction[i] = this->BaseNormal[i];
+        }
+      }
+    else
+      {
+      double center[3] = {0.0, 0.0, 0.0};
+      for (size_t p = 0; p < this->NumberOfPoints; p++)
+        {
+        for (int i = 0; i < 3; i++)
+          {
+          center[i] += this->Base[i][p];
+          }
+        }
+      for (int i = 0; i < 3; i++)
+        {
+        center[i] /= this->NumberOfPoints ? this->NumberOfPoints : 1;
+        this->Direction[i].assign(padded, 0.0f);
+        }
+      for (size_t p = 0; p < this->NumberOfPoints; p++)
+        {
+        double d[3], length = 0.0;
+        for (int i = 0; i < 3; i++)
+          {
+          d[i] = this->Base[i][p] - center[i];
+          length += d[i] * d[i];
+          }
+        length = length > 0.0 ? 1.0 / sqrt(length) : 0.0;
+        for (int i = 0; i < 3; i++)
+          {
+          this->Direction[i][p] = static_cast<float>(d[i] * length);
+          }
+        }
+      }
+    }
+  vtkPolyData *GetPolyData() { return this->PolyData; }
+
+  // Adds a target shape with the same number and order of points as the
+  // polydata and returns its index, or -1 if the counts differ. normals
+  // are optional; without them the target does not bend the normals.
+  int AddTarget(vtkPoints *target, vtkDataArray *normals = 0)
+    {
+    if (!target || static_cast<size_t>(target->GetNumberOfPoints()) != this->NumberOfPoints ||
+        !this->NumberOfPoints)
+      {
+      return -1;
+      }
+    Target *t = new Target;
+    ToStructureOfArrays(target, this->Base, t->Delta);
+    if (normals && this->Normals && normals->GetNumberOfComponents() == 3 &&
+        static_cast<size_t>(normals->GetNumberOfTuples()) == this->NumberOfPoints)
+      {
+      ToStructureOfArrays(normals, this->BaseNormal, t->NormalDelta);
+      }
+    this->Targets.push_back(t);
+    return static_cast<int>(this->Targets.size()) - 1;
+    }
+
+  void RemoveAllTargets()
+    {
+    for (size_t t = 0; t < this->Targets.size(); t++)
+      {
+      delete this->Targets[t]->WeightTrack;
+      delete this->Targets[t];
+      }
+    this->Targets.clear();
+    }
+  int GetNumberOfTargets() const
+    {
+    return static_cast<int>(this->Targets.size());
+    }
+
+  // Weight of a target while it has no weight track; 0 leaves the base
+  // shape, 1 gives the target shape.
+  void SetWeight(int target, double weight)
+    {
+    this->Targets[target]->Weight = weight;
+    }
+  double GetWeight(int target) const
+    {
+    return this->Targets[target]->Weight;
+    }
+  // One component track of the weight of a target, created on first
+  // access; it replaces the constant weight once it has keys.
+  KeyframeTrack *GetWeightTrack(int target)
+    {
+    Target *t = this->Targets[target];
+    if (!t->WeightTrack)
+      {
+      t->WeightTrack = new KeyframeTrack(1);
+      }
+    return t->WeightTrack;
+    }
+
+  // Travelling wave: points move by amplitude * sin(2 pi (d.p - speed t) /
+  // wavelength), where d is the unit direction the wave travels in and p
+  // the base position. An amplitude of 0 turns the wave off.
+  void SetWave(double amplitude, double wavelength, double speed, const double direction[3])
+    {
+    this->WaveAmplitude = amplitude;
+    this->WaveLength = wavelength != 0.0 ? wavelength : 1.0;
+    this->WaveSpeed = speed;
+    double length = sqrt(direction[0] * direction[0] + direction[1] * direction[1] +
+                         direction[2] * direction[2]);
+    for (int i = 0; i < 3; i++)
+      {
+      this->WaveDirection[i] = length > 0.0 ? direction[i] / length : (i == 0);
+      }
+    }
+
+  // Blend the normals along with the points when the polydata has normals
+  // (on by default).
+  void SetUpdateNormals(bool update) { this->UpdateNormals = update; }
+  bool GetUpdateNormals() const      { return this->UpdateNormals; }
+
+  // Without a pool the points are deformed on the calling thread. The
+  // grain is in blocks of four vertices.
+  void SetPool(WorkStealingPool *pool) { this->Pool = pool; }
+  void SetGrainSize(size_t grain)      { this->GrainSize = grain ? grain : 1; }
+
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    }
+
+  // Writes the shape at time seconds into the cue into the polydata.
+  void Evaluate(double time)
+    {
+    if (!this->NumberOfPoints)
+      {
+      return;
+      }
+    this->ActiveTargets.clear();
+    this->ActiveWeights.clear();
+    bool normals = this->Normals && this->UpdateNormals;
+    bool bent = false;
+    for (size_t t = 0; t < this->Targets.size(); t++)
+      {
+      Target *target = this->Targets[t];
+      double weight = target->Weight;
+      if (target->WeightTrack && target->WeightTrack->GetNumberOfKeys())
+        {
+        target->WeightTrack->Evaluate(time, &weight);
+        }
+      if (weight != 0.0)
+        {
+        this->ActiveTargets.push_back(target);
+        this->ActiveWeights.push_back(static_cast<float>(weight));
+        bent = bent || !target->NormalDelta[0].empty();
+        }
+      }
+    // Normals only change while a target with normals is blended in, and
+    // once more to restore the base normals when the last one drops out.
+    normals = normals && (bent || this->NormalsBent);
+    this->NormalsBent = normals && bent;
+
+    const double k = 2.0 * 3.14159265358979323846 / this->WaveLength;
+    this->Frame.Wave = this->WaveAmplitude != 0.0;
+    this->Frame.Normals = normals;
+    this->Frame.Amplitude = static_cast<float>(this->WaveAmplitude);
+    for (int i = 0; i < 3; i++)
+      {
+      this->Frame.K[i] = static_cast<float>(k * this->WaveDirection[i]);
+      }
+    // Keep the phase offset small so float precision does not degrade
+    // over long animations.
+    this->Frame.Phase = static_cast<float>(fmod(k * this->WaveSpeed * time, 2.0 * 3.14159265358979323846));
+
+    const size_t blocks = Padded(this->NumberOfPoints) / 4;
+    if (this->Pool)
+      {
+      this->Pool->ParallelFor(blocks, this->GrainSize,
+        [this](size_t begin, size_t end)
+          {
+          this->Deform(begin, end);
+          });
+      }
+    else
+      {
+      this->Deform(0, blocks);
+      }
+    this->PolyData->GetPoints()->Modified();
+    if (normals)
+      {
+      this->Normals->Modified();
+      }
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    this->Evaluate(0.0);
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    FRAME_PROFILE_SCOPE("MeshDeformationAnimator::Tick");
+    this->Evaluate(info->AnimationTime - info->StartTime);
+    if (this->Scheduler)
+      {
+      this->Scheduler->RequestRender();
+      }
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    this->Evaluate(info->EndTime - info->StartTime);
+    }
+
+protected:
+  struct Target
+    {
+    Target() : Weight(0.0), WeightTrack(0) {}
+    std::vector<float> Delta[3];
+    std::vector<float> NormalDelta[3];
+    double             Weight;
+    KeyframeTrack *    WeightTrack;
+    };
+
+  // What one Evaluate needs in the kernel, in float.
+  struct FrameParameters
+    {
+    bool  Wave;
+    bool  Normals;
+    float Amplitude;
+    float K[3];
+    float Phase;
+    };
+
+  static size_t Padded(size_t count)
+    {
+    return (count + 3) & ~static_cast<size_t>(3);
+    }
+
+  // New float array with the tuples of a three component array.
+  static vtkFloatArray *FloatCopy(vtkDataArray *array)
+    {
+    vtkFloatArray *copy = vtkFloatArray::New();
+    copy->SetNumberOfComponents(3);
+    copy->SetNumberOfTuples(array->GetNumberOfTuples());
+    copy->SetName(array->GetName());
+    double tuple[3];
+    for (vtkIdType t = 0; t < array->GetNumberOfTuples(); t++)
+      {
+      array->GetTuple(t, tuple);
+      copy->SetTuple(t, tuple);
+      }
+    return copy;
+    }
+
+  static void ToStructureOfArrays(const float *xyz, size_t count, std::vector<float> soa[3])
+    {
+    for (int i = 0; i < 3; i++)
+      {
+      soa[i].assign(Padded(count), 0.0f);
+      for (size_t p = 0; p < count; p++)
+        {
+        soa[i][p] = xyz[3 * p + i];
+        }
+      }
+    }
+
+  // Offsets of a target (points or normals) from the base.
+  static void ToStructureOfArrays(vtkPoints *target, const std::vector<float> base[3],
+                                  std::vector<float> delta[3])
+    {
+    ToStructureOfArrays(target->GetData(), base, delta);
+    }
+  static void ToStructureOfArrays(vtkDataArray *target, const std::vector<float> base[3],
+                                  std::vector<float> delta[3])
+    {
+    const size_t count = static_cast<size_t>(target->GetNumberOfTuples());
+    for (int i = 0; i < 3; i++)
+      {
+      delta[i].assign(base[i].size(), 0.0f);
+      }
+    double tuple[3];
+    for (size_t p = 0; p < count; p++)
+      {
+      target->GetTuple(static_cast<vtkIdType>(p), tuple);
+      for (int i = 0; i < 3; i++)
+        {
+        delta[i][p] = static_cast<float>(tuple[i] - base[i][p]);
+        }
+      }
+    }
+
+  // Deforms blocks [begin, end) of four vertices.
+  void Deform(size_t begin, size_t end)
+    {
+    const FrameParameters &f = this->Frame;
+    const size_t targets = this->ActiveTargets.size();
+    Target *const *active = targets ? &this->ActiveTargets[0] : 0;
+    const float *weights = targets ? &this->ActiveWeights[0] : 0;
+    float *points = this->Points->GetPointer(0);
+    float *normals = f.Normals ? this->Normals->GetPointer(0) : 0;
+    const size_t n = this->NumberOfPoints;
+#ifdef DEFORMATION_ANIMATOR_SSE
+    const __m128 amplitude = _mm_set1_ps(f.Amplitude);
+    const __m128 kx = _mm_set1_ps(f.K[0]), ky = _mm_set1_ps(f.K[1]), kz = _mm_set1_ps(f.K[2]);
+    const __m128 phase = _mm_set1_ps(f.Phase);
+    for (size_t b = begin; b < end; b++)
+      {
+      const size_t p = 4 * b;
+      __m128 bx = _mm_loadu_ps(&this->Base[0][p]);
+      __m128 by = _mm_loadu_ps(&this->Base[1][p]);
+      __m128 bz = _mm_loadu_ps(&this->Base[2][p]);
+      __m128 x = bx, y = by, z = bz;
+      if (f.Wave)
+        {
+        __m128 arg = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(kx, bx), _mm_mul_ps(ky, by)),
+                                           _mm_mul_ps(kz, bz)), phase);
+        __m128 s = _mm_mul_ps(amplitude, Sin(arg));
+        x = _mm_add_ps(x, _mm_mul_ps(s, _mm_loadu_ps(&this->Direction[0][p])));
+        y = _mm_add_ps(y, _mm_mul_ps(s, _mm_loadu_ps(&this->Direction[1][p])));
+        z = _mm_add_ps(z, _mm_mul_ps(s, _mm_loadu_ps(&this->Direction[2][p])));
+        }
+      for (size_t t = 0; t < targets; t++)
+        {
+        const __m128 w = _mm_set1_ps(weights[t]);
+        x = _mm_add_ps(x, _mm_mul_ps(w, _mm_loadu_ps(&active[t]->Delta[0][p])));
+        y = _mm_add_ps(y, _mm_mul_ps(w, _mm_loadu_ps(&active[t]->Delta[1][p])));
+        z = _mm_add_ps(z, _mm_mul_ps(w, _mm_loadu_ps(&active[t]->Delta[2][p])));
+        }
+      StoreInterleaved(x, y, z, points, p, n);
+
+      if (normals)
+        {
+        x = _mm_loadu_ps(&this->BaseNormal[0][p]);
+        y = _mm_loadu_ps(&this->BaseNormal[1][p]);
+        z = _mm_loadu_ps(&this->BaseNormal[2][p]);
+        for (size_t t = 0; t < targets; t++)
+          {
+          if (active[t]->NormalDelta[0].empty())
+            {
+            continue;
+            }
+          const __m128 w = _mm_set1_ps(weights[t]);
+          x = _mm_add_ps(x, _mm_mul_ps(w, _mm_loadu_ps(&active[t]->NormalDelta[0][p])));
+          y = _mm_add_ps(y, _mm_mul_ps(w, _mm_loadu_ps(&active[t]->NormalDelta[1][p])));
+          z = _mm_add_ps(z, _mm_mul_ps(w, _mm_loadu_ps(&active[t]->NormalDelta[2][p])));
+          }
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                               _mm_mul_ps(z, z)));
+        // Padding and degenerate normals have length 0; leave them at 0.
+        __m128 scale = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), length),
+                                  _mm_cmpgt_ps(length, _mm_setzero_ps()));
+        StoreInterleaved(_mm_mul_ps(x, scale), _mm_mul_ps(y, scale), _mm_mul_ps(z, scale),
+                         normals, p, n);
+        }
+      }
+#else
+    const size_t last = 4 * end < n ? 4 * end : n;
+    for (size_t p = 4 * begin; p < last; p++)
+      {
+      float x = this->Base[0][p], y = this->Base[1][p], z = this->Base[2][p];
+      if (f.Wave)
+        {
+        float s = f.Amplitude * static_cast<float>(sin(f.K[0] * x + f.K[1] * y + f.K[2] * z - f.Phase));
+        x += s * this->Direction[0][p];
+        y += s * this->Direction[1][p];
+        z += s * this->Direction[2][p];
+        }
+      for (size_t t = 0; t < targets; t++)
+        {
+        x += weights[t] * active[t]->Delta[0][p];
+        y += weights[t] * active[t]->Delta[1][p];
+        z += weights[t] * active[t]->Delta[2][p];
+        }
+      points[3 * p] = x;
+      points[3 * p + 1] = y;
+      points[3 * p + 2] = z;
+
+      if (normals)
+        {
+        x = this->BaseNormal[0][p];
+        y = this->BaseNormal[1][p];
+        z = this->BaseNormal[2][p];
+        for (size_t t = 0; t < targets; t++)
+          {
+          if (!active[t]->NormalDelta[0].empty())
+            {
+            x += weights[t] * active[t]->NormalDelta[0][p];
+            y += weights[t] * active[t]->NormalDelta[1][p];
+            z += weights[t] * active[t]->NormalDelta[2][p];
+            }
+          }
+        float length = sqrtf(x * x + y * y + z * z);
+        float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        normals[3 * p] = x * scale;
+        normals[3 * p + 1] = y * scale;
+        normals[3 * p + 2] = z * scale;
+        }
+      }
+#endif
+    }
+
+#ifdef DEFORMATION_ANIMATOR_SSE
+  // sin of four floats: reduced to [-pi/2, pi/2] and a degree 9 Taylor
+  // polynomial there, within about 2e-6 of sin for |x| up to ~1e6.
+  static __m128 Sin(__m128 x)
+    {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    // Turns, reduced to [-0.5, 0.5].
+    __m128 t = _mm_mul_ps(x, _mm_set1_ps(0.15915494309189535f));
+    t = _mm_sub_ps(t, _mm_cvtepi32_ps(_mm_cvtps_epi32(t)));
+    __m128 sign = _mm_and_ps(t, signMask);
+    __m128 a = _mm_xor_ps(t, sign);
+    // sin(2 pi a) = sin(2 pi (0.5 - a)), folding [0.25, 0.5] onto [0, 0.25].
+    a = _mm_min_ps(a, _mm_sub_ps(_mm_set1_ps(0.5f), a));
+    a = _mm_mul_ps(a, _mm_set1_ps(6.283185307179586f));
+    __m128 a2 = _mm_mul_ps(a, a);
+    __m128 p = _mm_set1_ps(1.0f / 362880.0f);
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(-1.0f / 5040.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(1.0f / 120.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(-1.0f / 6.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(1.0f));
+    return _mm_xor_ps(_mm_mul_ps(p, a), sign);
+    }
+
+  // Writes four vertices held as x, y, z registers to xyz triples at
+  // vertex p of out, dropping the ones at or past count.
+  static void StoreInterleaved(__m128 x, __m128 y, __m128 z, float *out, size_t p, size_t count)
+    {
+    __m128 xy0 = _mm_unpacklo_ps(x, y);                                  // x0 y0 x1 y1
+    __m128 xy1 = _mm_unpackhi_ps(x, y);                                  // x2 y2 x3 y3
+    __m128 zx = _mm_shuffle_ps(z, xy0, _MM_SHUFFLE(2, 2, 0, 0));         // z0 z0 x1 x1
+    __m128 yz = _mm_shuffle_ps(xy0, z, _MM_SHUFFLE(1, 1, 3, 3));         // y1 y1 z1 z1
+    __m128 zx3 = _mm_shuffle_ps(z, xy1, _MM_SHUFFLE(2, 2, 2, 2));        // z2 z2 x3 x3
+    __m128 yz3 = _mm_shuffle_ps(xy1, z, _MM_SHUFFLE(3, 3, 3, 3));        // y3 y3 z3 z3
+    __m128 r0 = _mm_shuffle_ps(xy0, zx, _MM_SHUFFLE(2, 0, 1, 0));        // x0 y0 z0 x1
+    __m128 r1 = _mm_shuffle_ps(yz, xy1, _MM_SHUFFLE(1, 0, 2, 0));        // y1 z1 x2 y2
+    __m128 r2 = _mm_shuffle_ps(zx3, yz3, _MM_SHUFFLE(2, 0, 2, 0));       // z2 x3 y3 z3
+    if (p + 4 <= count)
+      {
+      _mm_storeu_ps(out + 3 * p, r0);
+      _mm_storeu_ps(out + 3 * p + 4, r1);
+      _mm_storeu_ps(out + 3 * p + 8, r2);
+      return;
+      }
+    float last[12];
+    _mm_storeu_ps(last, r0);
+    _mm_storeu_ps(last + 4, r1);
+    _mm_storeu_ps(last + 8, r2);
+    for (size_t i = 0; i < 3 * (count - p); i++)
+      {
+      out[3 * p + i] = last[i];
+      }
+    }
+#endif
+
+  typedef AnimationCueAdapter<MeshDeformationAnimator> AnimationCueObserver;
+
+  AnimationCueObserver *  Observer;
+  vtkPolyData *           PolyData;
+  vtkFloatArray *         Points;
+  vtkFloatArray *         Normals;
+  size_t                  NumberOfPoints;
+  std::vector<float>      Base[3];
+  std::vector<float>      BaseNormal[3];
+  std::vector<float>      Direction[3];
+  std::vector<Target*>    Targets;
+  std::vector<Target*>    ActiveTargets;
+  std::vector<float>      ActiveWeights;
+  FrameParameters         Frame;
+  bool                    UpdateNormals;
+  bool                    NormalsBent;
+  double                  WaveAmplitude;
+  double                  WaveLength;
+  double                  WaveSpeed;
+  double                  WaveDirection[3];
+  WorkStealingPool *      Pool;
+  size_t                  GrainSize;
+  RenderScheduler *       Scheduler;
+};
+
+#endif
@@ -0,0 +1,510 @@
+#ifndef __FrameBudget_h
+#define __FrameBudget_h
+#include <vtkActor.h>
+#include <vtkAnimationCue.h>
+#include <vtkCamera.h>
+#include <vtkCommand.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <vector>
+
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+
+// Holds the frame rate of a real-time scene by choosing, every tick, one
+// of a few precomputed tessellations for each actor. In real-time mode
+// vtkAnimationScene drops ticks when a frame takes longer than the
+// budget; this trades detail for those ticks instead.
+//
+// The time between ticks, smoothed over recent frames, is compared with
+// the budget. Over budget, the number of cells to draw is cut in
+// proportion; well under it (below LowWater of the budget) it grows by at
+// most a quarter per tick; in between it is left alone. The cells are
+// then handed out by screen size: in rounds, each actor, largest on
+// screen first, goes one level finer if that fits in what is left, but
+// no finer than about one cell per PixelsPerCell pixels of its projected
+// area. Every actor keeps at least its coarsest level.
+//
+// To avoid flicker an actor changes level only once the same new level
+// was chosen for HoldFrames ticks in a row, except that it drops at once
+// while the frame time is over budget.
+//
+// Levels are shown by shallow copying them into an output polydata given
+// per actor, which its mapper reads, as TessellationCache does. Hidden
+// actors are not counted and keep their level.
+class FrameBudgetGovernor
+{
+public:
+  FrameBudgetGovernor()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->Renderer = 0;
+    this->FrameBudget = 0.1;
+    this->LowWater = 0.75;
+    this->Smoothing = 0.25;
+    this->HoldFrames = 5;
+    this->PixelsPerCell = 16.0;
+    this->CellBudget = -1.0;
+    this->AverageFrameTime = 0.0;
+    this->LastClock = -1.0;
+    this->NumberOfCells = 0;
+    this->NumberOfLevelChanges = 0;
+    this->TotalLevelChanges = 0;
+    this->NumberOfUpdates = 0;
+    this->NumberOfUpdatesOverBudget = 0;
+    }
+
+  ~FrameBudgetGovernor()
+    {
+    this->SetRenderer(0);
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // Returns the id of the actor. Its levels will be shallow copied into
+  // output, which should be its mapper's input.
+  int AddActor(vtkActor *actor, vtkPolyData *output)
+    {
+    Entry entry;
+    entry.Actor = actor;
+    entry.Output = output;
+    entry.Level = -1;
+    entry.MaximumLevel = -1;
+    entry.Pending = -1;
+    entry.PendingCount = 0;
+    entry.Wanted = 0;
+    entry.Priority = 0.0;
+    entry.UsefulLevel = 0;
+    this->Entries.push_back(entry);
+    return static_cast<int>(this->Entries.size()) - 1;
+    }
+
+  // Adds a level, coarsest first. The first one is shown at once.
+  void AddLevel(int id, vtkPolyData *level)
+    {
+    Entry &entry = this->Entries[id];
+    entry.Levels.push_back(level);
+    entry.Cells.push_back(level->GetNumberOfCells());
+    if (entry.Level < 0)
+      {
+      this->Show(entry, 0);
+      }
+    }
+
+  // Levels tessellating the sphere of source, with theta resolutions
+  // given in increasing order and half as many phi divisions, as the
+  // resolution slider does. Each level is generated here.
+  void AddSphereLevels(int id, vtkSphereSource *source, const int *resolutions, int count)
+    {
+    for (int i = 0; i < count; i++)
+      {
+      vtkSmartPointer<vtkSphereSource> level = vtkSmartPointer<vtkSphereSource>::New();
+      double *center = source->GetCenter();
+      level->SetCenter(center[0], center[1], center[2]);
+      level->SetRadius(source->GetRadius());
+      level->SetPhiResolution(resolutions[i] / 2);
+      level->SetThetaResolution(resolutions[i]);
+      level->Update();
+      vtkSmartPointer<vtkPolyData> data = vtkSmartPointer<vtkPolyData>::New();
+      data->ShallowCopy(level->GetOutput());
+      this->AddLevel(id, data);
+      }
+    }
+
+  size_t GetNumberOfActors() const
+    {
+    return this->Entries.size();
+    }
+  int GetNumberOfLevels(int id) const
+    {
+    return static_cast<int>(this->Entries[id].Levels.size());
+    }
+  // The level shown.
+  int GetLevel(int id) const
+    {
+    return this->Entries[id].Level;
+    }
+  // Finest level the actor may get, for instance from a user setting; -1,
+  // the default, allows all of them.
+  void SetMaximumLevel(int id, int level)
+    {
+    this->Entries[id].MaximumLevel = level;
+    }
+
+  // The renderer whose camera and size give the screen size of actors.
+  // Without one every actor is as important as any other.
+  void SetRenderer(vtkRenderer *renderer)
+    {
+    if (this->Renderer)
+      {
+      this->Renderer->UnRegister(0);
+      }
+    this->Renderer = renderer;
+    if (this->Renderer)
+      {
+      this->Renderer->Register(0);
+      }
+    }
+
+  // Seconds per frame to hold, e.g. 1 / the scene's frame rate.
+  void SetFrameBudget(double seconds)
+    {
+    this->FrameBudget = seconds;
+    }
+  double GetFrameBudget() const
+    {
+    return this->FrameBudget;
+    }
+  // Fraction of the budget under which detail is added again.
+  void SetLowWater(double fraction)
+    {
+    this->LowWater = fraction;
+    }
+  // Weight of the newest frame time in the running average.
+  void SetSmoothing(double weight)
+    {
+    this->Smoothing = std::min(1.0, std::max(0.01, weight));
+    }
+  void SetHoldFrames(int frames)
+    {
+    this->HoldFrames = frames > 0 ? frames : 0;
+    }
+  void SetPixelsPerCell(double pixels)
+    {
+    this->PixelsPerCell = pixels;
+    }
+
+  // Forgets the frame times measured and lifts the cell budget, as when
+  // the scene starts playing.
+  void Reset()
+    {
+    this->CellBudget = -1.0;
+    this->AverageFrameTime = 0.0;
+    this->LastClock = -1.0;
+    }
+
+  // Takes the duration of one frame into the average. Tick does this
+  // with the time since the previous tick.
+  void AddFrameTime(double seconds)
+    {
+    if (this->AverageFrameTime <= 0.0)
+      {
+      this->AverageFrameTime = seconds;
+      }
+    else
+      {
+      this->AverageFrameTime += this->Smoothing * (seconds - this->AverageFrameTime);
+      }
+    }
+
+  // Adjusts the cell budget to the average frame time, then chooses the
+  // level of every visible actor.
+  void Update()
+    {
+    FRAME_PROFILE_SCOPE("FrameBudgetGovernor::Update");
+    bool over = this->AverageFrameTime > this->FrameBudget;
+    if (this->AverageFrameTime > 0.0 && this->NumberOfCells > 0)
+      {
+      double cells = static_cast<double>(this->NumberOfCells);
+      if (over)
+        {
+        this->CellBudget = cells * this->FrameBudget / this->AverageFrameTime;
+        }
+      else if (this->CellBudget >= 0.0 &&
+               this->AverageFrameTime < this->LowWater * this->FrameBudget)
+        {
+        double growth = std::min(1.25, this->LowWater * this->FrameBudget / this->AverageFrameTime);
+        this->CellBudget = std::max(this->CellBudget, cells * growth);
+        }
+      }
+
+    // Everything visible at its coarsest, then refined in order of size.
+    this->Order.clear();
+    double total = 0.0;
+    for (size_t i = 0; i < this->Entries.size(); i++)
+      {
+      Entry &entry = this->Entries[i];
+      if (entry.Levels.empty() || !entry.Actor->GetVisibility())
+        {
+        continue;
+        }
+      this->Measure(entry);
+      entry.Wanted = 0;
+      total += entry.Cells[0];
+      this->Order.push_back(static_cast<int>(i));
+      }
+    std::sort(this->Order.begin(), this->Order.end(), ByPriority(this->Entries));
+    // One level at a time, in rounds, so the cells are spread over the
+    // larger actors rather than spent on the largest alone.
+    for (bool refined = true; refined;)
+      {
+      refined = false;
+      for (size_t k = 0; k < this->Order.size(); k++)
+        {
+        Entry &entry = this->Entries[this->Order[k]];
+        if (entry.Wanted >= entry.UsefulLevel)
+          {
+          continue;
+          }
+        double added = static_cast<double>(entry.Cells[entry.Wanted + 1] - entry.Cells[entry.Wanted]);
+        if (this->CellBudget < 0.0 || total + added <= this->CellBudget)
+          {
+          entry.Wanted++;
+          total += added;
+          refined = true;
+          }
+        }
+      }
+
+    this->NumberOfLevelChanges = 0;
+    this->NumberOfCells = 0;
+    this->LevelHistogram.assign(this->LevelHistogram.size(), 0);
+    for (size_t k = 0; k < this->Order.size(); k++)
+      {
+      Entry &entry = this->Entries[this->Order[k]];
+      if (entry.Wanted != entry.Level)
+        {
+        if (entry.Wanted != entry.Pending)
+          {
+          entry.Pending = entry.Wanted;
+          entry.PendingCount = 0;
+          }
+        entry.PendingCount++;
+        if ((over && entry.Wanted < entry.Level) || entry.PendingCount > this->HoldFrames)
+          {
+          this->Show(entry, entry.Wanted);
+          this->NumberOfLevelChanges++;
+          }
+        }
+      else
+        {
+        entry.Pending = -1;
+        entry.PendingCount = 0;
+        }
+      this->NumberOfCells += entry.Cells[entry.Level];
+      if (static_cast<size_t>(entry.Level) >= this->LevelHistogram.size())
+        {
+        this->LevelHistogram.resize(entry.Level + 1, 0);
+        }
+      this->LevelHistogram[entry.Level]++;
+      }
+    this->TotalLevelChanges += this->NumberOfLevelChanges;
+    this->NumberOfUpdates++;
+    if (over)
+      {
+      this->NumberOfUpdatesOverBudget++;
+      }
+    FRAME_PROFILE_COUNTER("FrameBudgetGovernor cells", static_cast<double>(this->NumberOfCells));
+    FRAME_PROFILE_COUNTER("FrameBudgetGovernor average frame ms", 1000.0 * this->AverageFrameTime);
+    }
+
+  // Telemetry, for the last update unless noted.
+  double GetAverageFrameTime() const
+    {
+    return this->AverageFrameTime;
+    }
+  // Cells allowed; negative while unlimited.
+  double GetCellBudget() const
+    {
+    return this->CellBudget;
+    }
+  // Cells of the levels shown on visible actors.
+  vtkIdType GetNumberOfCells() const
+    {
+    return this->NumberOfCells;
+    }
+  int GetNumberOfLevelChanges() const
+    {
+    return this->NumberOfLevelChanges;
+    }
+  // Visible actors showing the given level.
+  int GetNumberOfActorsAtLevel(int level) const
+    {
+    return level >= 0 && static_cast<size_t>(level) < this->LevelHistogram.size() ?
+      this->LevelHistogram[level] : 0;
+    }
+  // Since construction.
+  unsigned long GetTotalLevelChanges() const
+    {
+    return this->TotalLevelChanges;
+    }
+  unsigned long GetNumberOfUpdates() const
+    {
+    return this->NumberOfUpdates;
+    }
+  unsigned long GetNumberOfUpdatesOverBudget() const
+    {
+    return this->NumberOfUpdatesOverBudget;
+    }
+
+  void PrintStatistics(ostream &os)
+    {
+    os << "frame: " << 1000.0 * this->AverageFrameTime << " ms of "
+       << 1000.0 * this->FrameBudget << " ms, cells: " << this->NumberOfCells
+       << " of " << this->CellBudget << ", levels:";
+    for (size_t level = 0; level < this->LevelHistogram.size(); level++)
+      {
+      os << " " << this->LevelHistogram[level];
+      }
+    os << endl;
+    os << "updates: " << this->NumberOfUpdates << ", over budget: "
+       << this->NumberOfUpdatesOverBudget << ", level changes: "
+       << this->TotalLevelChanges << endl;
+    }
+
+  // After the cues that move actors (see CueScheduler) and before the
+  // observers that render.
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer, 0.5);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer, 0.5);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer, 0.5);
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    this->Reset();
+    }
+
+  // The time since the previous tick is the whole of the last frame:
+  // its render, which followed that tick, and the cues ticked since.
+  void Tick(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    double now = vtkTimerLog::GetUniversalTime();
+    if (this->LastClock >= 0.0)
+      {
+      this->AddFrameTime(now - this->LastClock);
+      }
+    this->LastClock = now;
+    this->Update();
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    this->LastClock = -1.0;
+    }
+
+protected:
+  struct Entry
+    {
+    vtkActor *                                 Actor;
+    vtkPolyData *                              Output;
+    std::vector<vtkSmartPointer<vtkPolyData> > Levels;
+    std::vector<vtkIdType>                     Cells;
+    int                                        Level;
+    int                                        MaximumLevel;
+    // Level chosen by the last updates but not shown yet, and for how
+    // many updates in a row.
+    int                                        Pending;
+    int                                        PendingCount;
+    // Scratch of Update.
+    int                                        Wanted;
+    double                                     Priority;
+    int                                        UsefulLevel;
+    };
+
+  struct ByPriority
+    {
+    ByPriority(const std::vector<Entry> &entries) : Entries(entries) {}
+    bool operator()(int a, int b) const
+      {
+      return this->Entries[a].Priority > this->Entries[b].Priority;
+      }
+    const std::vector<Entry> &Entries;
+    };
+
+  void Show(Entry &entry, int level)
+    {
+    entry.Output->ShallowCopy(entry.Levels[level]);
+    entry.Level = level;
+    entry.Pending = -1;
+    entry.PendingCount = 0;
+    }
+
+  // Sets the priority of the entry to the radius of its bounding sphere
+  // on screen, in pixels when the renderer's size is known, and the
+  // finest level worth that many pixels.
+  void Measure(Entry &entry)
+    {
+    int last = static_cast<int>(entry.Levels.size()) - 1;
+    if (entry.MaximumLevel >= 0 && entry.MaximumLevel < last)
+      {
+      last = entry.MaximumLevel;
+      }
+    entry.UsefulLevel = last;
+    entry.Priority = 1.0;
+    double *bounds = entry.Actor->GetBounds();
+    if (!this->Renderer || !bounds || bounds[0] > bounds[1])
+      {
+      return;
+      }
+    double center[3], radius2 = 0.0;
+    for (int i = 0; i < 3; i++)
+      {
+      center[i] = 0.5 * (bounds[2 * i] + bounds[2 * i + 1]);
+      double half = 0.5 * (bounds[2 * i + 1] - bounds[2 * i]);
+      radius2 += half * half;
+      }
+    double radius = sqrt(radius2);
+    vtkCamera *camera = this->Renderer->GetActiveCamera();
+    double halfHeight;
+    if (camera->GetParallelProjection())
+      {
+      halfHeight = camera->GetParallelScale();
+      }
+    else
+      {
+      double *position = camera->GetPosition();
+      double distance2 = 0.0;
+      for (int i = 0; i < 3; i++)
+        {
+        distance2 += (center[i] - position[i]) * (center[i] - position[i]);
+        }
+      double distance = std::max(sqrt(distance2), radius);
+      halfHeight = distance * tan(camera->GetViewAngle() * 3.14159265358979323846 / 360.0);
+      }
+    entry.Priority = halfHeight > 0.0 ? radius / halfHeight : 1.0;
+    int *size = this->Renderer->GetSize();
+    if (!size || size[1] <= 0 || this->PixelsPerCell <= 0.0)
+      {
+      return;
+      }
+    entry.Priority *= size[1] / 2.0;
+    double cells = 3.14159265358979323846 * entry.Priority * entry.Priority / this->PixelsPerCell;
+    while (entry.UsefulLevel > 0 && entry.Cells[entry.UsefulLevel] > cells)
+      {
+      entry.UsefulLevel--;
+      }
+    }
+
+  typedef AnimationCueAdapter<FrameBudgetGovernor> AnimationCueObserver;
+
+  AnimationCueObserver *  Observer;
+  vtkRenderer *           Renderer;
+  std::vector<Entry>      Entries;
+  std::vector<int>        Order;
+  std::vector<int>        LevelHistogram;
+  double                  FrameBudget;
+  double                  LowWater;
+  double                  Smoothing;
+  int                     HoldFrames;
+  double                  PixelsPerCell;
+  double                  CellBudget;
+  double                  AverageFrameTime;
+  double                  LastClock;
+  vtkIdType               NumberOfCells;
+  int                     NumberOfLevelChanges;
+  unsigned long           TotalLevelChanges;
+  unsigned long           NumberOfUpdates;
+  unsigned long           NumberOfUpdatesOverBudget;
+};
+
+#endif
@@ -0,0 +1,394 @@
+#ifndef __FrameProfiler_h
+#define __FrameProfiler_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Scoped timers and counters for the per-frame hot paths.
+// Every thread records into its own ring buffer: the owning thread is the
+// only writer and publishes each event with one atomic store, so recording
+// takes no lock. When profiling is disabled a timer costs one relaxed
+// atomic load; building with FRAME_PROFILER_DISABLED removes the macros
+// entirely.
+// The buffers can be written as Chrome trace JSON (chrome://tracing or
+// Perfetto) on demand or when the program exits. EndFrame(), called once
+// per frame by the scene observer, folds the events of the frame into
+// per-stage totals; PrintFrameSummary reports their average and 99th
+// percentile over the last frames.
+//
+//   FRAME_PROFILE_SCOPE("ActorAnimator::Tick");
+//   FRAME_PROFILE_COUNTER("MeshIntersector pairs", pairs);
+//
+// Names must be string literals (or otherwise outlive the profiler); only
+// the pointer is stored.
+class FrameProfiler
+{
+public:
+  struct Event
+    {
+    const char *Name;
+    long long   Start;     // ns since the profiler was created
+    long long   Duration;  // ns, or -1 for a counter
+    double      Value;     // counter value
+    };
+
+  static FrameProfiler &GetInstance()
+    {
+    static FrameProfiler instance;
+    return instance;
+    }
+
+  static bool IsEnabled()
+    {
+    return GetInstance().Enabled.load(std::memory_order_relaxed);
+    }
+
+  void SetEnabled(bool enabled) { this->Enabled.store(enabled, std::memory_order_relaxed); }
+  void EnableOn()               { this->SetEnabled(true); }
+  void EnableOff()              { this->SetEnabled(false); }
+
+  // Events kept per thread, rounded up to a power of two. Only affects
+  // threads that record their first event afterwards.
+  void SetBufferSize(size_t events)
+    {
+    size_t size = 1;
+    while (size < events)
+      {
+      size <<= 1;
+      }
+    this->BufferSize = size;
+    }
+
+  // Writes the trace to this file when the program exits.
+  void SetTraceFileOnExit(const std::string &fileName) { this->TraceFileOnExit = fileName; }
+
+  // Prints the frame summary to stdout every interval frames; 0 disables.
+  void SetSummaryInterval(int frames) { this->SummaryInterval = frames; }
+  // Number of frames the summary statistics cover.
+  void SetSummaryWindow(size_t frames) { this->SummaryWindow = frames > 0 ? frames : 1; }
+
+  long long Now() const
+    {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - this->Origin).count();
+    }
+
+  void RecordScope(const char *name, long long start, long long end)
+    {
+    ThreadBuffer *buffer = this->GetThreadBuffer();
+    Event &event = buffer->Reserve();
+    event.Name = name;
+    event.Start = start;
+    event.Duration = end - start;
+    event.Value = 0.0;
+    buffer->Publish();
+    }
+
+  void RecordCounter(const char *name, double value)
+    {
+    ThreadBuffer *buffer = this->GetThreadBuffer();
+    Event &event = buffer->Reserve();
+    event.Name = name;
+    event.Start = this->Now();
+    event.Duration = -1;
+    event.Value = value;
+    buffer->Publish();
+    }
+
+  // Closes the current frame: adds up the scopes recorded since the last
+  // call, per name, and the time since the last call as "frame". Call from
+  // one thread only.
+  void EndFrame()
+    {
+    if (!IsEnabled())
+      {
+      return;
+      }
+    long long now = this->Now();
+    std::map<std::string, double> totals;
+    if (this->LastFrameEnd >= 0)
+      {
+      totals["frame"] = (now - this->LastFrameEnd) * 1.0e-6;
+      }
+    this->LastFrameEnd = now;
+
+    std::lock_guard<std::mutex> lock(this->BuffersMutex);
+    for (size_t b = 0; b < this->Buffers.size(); b++)
+      {
+      ThreadBuffer *buffer = this->Buffers[b];
+      unsigned long long end = buffer->Count.load(std::memory_order_acquire);
+      unsigned long long begin = std::max(buffer->Summarized, end > buffer->Events.size() ?
+                                          end - buffer->Events.size() : 0ULL);
+      for (unsigned long long i = begin; i < end; i++)
+        {
+        const Event &event = buffer->Events[i & buffer->Mask];
+        if (event.Duration >= 0)
+          {
+          totals[event.Name] += event.Duration * 1.0e-6;
+          }
+        }
+      buffer->Summarized = end;
+      }
+
+    // A stage first seen now gets 0 ms for the earlier frames, and a known
+    // stage missing from this frame gets 0 ms for it.
+    for (std::map<std::string, double>::iterator total = totals.begin(); total != totals.end(); ++total)
+      {
+      if (!this->Stages.count(total->first))
+        {
+        this->Stages[total->first].assign(this->WindowFrames(), 0.0);
+        }
+      }
+    for (StageMap::iterator stage = this->Stages.begin(); stage != this->Stages.end(); ++stage)
+      {
+      std::map<std::string, double>::iterator total = totals.find(stage->first);
+      stage->second.push_back(total != totals.end() ? total->second : 0.0);
+      while (stage->second.size() > this->SummaryWindow)
+        {
+        stage->second.pop_front();
+        }
+      }
+    this->NumberOfFrames++;
+    if (this->SummaryInterval > 0 && this->NumberOfFrames % this->SummaryInterval == 0)
+      {
+      this->PrintSummaryLine(std::cout);
+      }
+    }
+
+  // Average and 99th percentile, in ms per frame, of every stage over the
+  // last SummaryWindow frames.
+  void PrintFrameSummary(std::ostream &os) const
+    {
+    os << "stage, avg ms, p99 ms (last " << this->WindowFrames() << " frames)" << std::endl;
+    for (StageMap::const_iterator stage = this->Stages.begin(); stage != this->Stages.end(); ++stage)
+      {
+      os << stage->first << ", " << Average(stage->second) << ", "
+         << Percentile99(stage->second) << std::endl;
+      }
+    }
+
+  // Writes every event still held in the ring buffers. Returns false if
+  // the file could not be written.
+  bool WriteChromeTrace(const std::string &fileName)
+    {
+    FILE *file = fopen(fileName.c_str(), "w");
+    if (!file)
+      {
+      return false;
+      }
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    std::lock_guard<std::mutex> lock(this->BuffersMutex);
+    for (size_t b = 0; b < this->Buffers.size(); b++)
+      {
+      ThreadBuffer *buffer = this->Buffers[b];
+      unsigned long long end = buffer->Count.load(std::memory_order_acquire);
+      unsigned long long begin = end > buffer->Events.size() ? end - buffer->Events.size() : 0;
+      for (unsigned long long i = begin; i < end; i++)
+        {
+        const Event &event = buffer->Events[i & buffer->Mask];
+        std::string name = Escape(event.Name);
+        if (event.Duration >= 0)
+          {
+          fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                  first ? "" : ",\n", name.c_str(), static_cast<int>(b),
+                  event.Start * 1.0e-3, event.Duration * 1.0e-3);
+          }
+        else
+          {
+          fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+                  first ? "" : ",\n", name.c_str(), static_cast<int>(b),
+                  event.Start * 1.0e-3, event.Value);
+          }
+        first = false;
+        }
+      }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+    }
+
+protected:
+  // Ring of events written by one thread. Count only grows; slot
+  // Count & Mask is the next one written. A reader copying events while
+  // the writer wraps around may see a slot being overwritten; for a trace
+  // that is an acceptable price for a lock-free writer.
+  struct ThreadBuffer
+    {
+    ThreadBuffer(size_t size) : Events(size), Mask(size - 1), Count(0), Summarized(0) {}
+
+    Event &Reserve()
+      {
+      return this->Events[this->Count.load(std::memory_order_relaxed) & this->Mask];
+      }
+    void Publish()
+      {
+      this->Count.store(this->Count.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+      }
+
+    std::vector<Event>                   Events;
+    unsigned long long                   Mask;
+    std::atomic<unsigned long long>      Count;
+    // Read by EndFrame only.
+    unsigned long long                   Summarized;
+    };
+  typedef std::map<std::string, std::deque<double> > StageMap;
+
+  FrameProfiler() : Enabled(false)
+    {
+    this->Origin = std::chrono::steady_clock::now();
+    this->BufferSize = 1 << 16;
+    this->SummaryInterval = 0;
+    this->SummaryWindow = 120;
+    this->NumberOfFrames = 0;
+    this->LastFrameEnd = -1;
+    // FRAME_PROFILE=<file> enables profiling and writes the trace at exit.
+    const char *traceFile = getenv("FRAME_PROFILE");
+    if (traceFile && *traceFile)
+      {
+      this->Enabled.store(true);
+      this->TraceFileOnExit = traceFile;
+      }
+    }
+
+  ~FrameProfiler()
+    {
+    if (!this->TraceFileOnExit.empty())
+      {
+      this->WriteChromeTrace(this->TraceFileOnExit);
+      }
+    for (size_t b = 0; b < this->Buffers.size(); b++)
+      {
+      delete this->Buffers[b];
+      }
+    }
+
+  // The calling thread's buffer, created on its first event. Buffers stay
+  // with the profiler after their thread exits so the trace keeps them.
+  ThreadBuffer *GetThreadBuffer()
+    {
+    static thread_local ThreadBuffer *buffer = 0;
+    if (!buffer)
+      {
+      buffer = new ThreadBuffer(this->BufferSize);
+      std::lock_guard<std::mutex> lock(this->BuffersMutex);
+      this->Buffers.push_back(buffer);
+      }
+    return buffer;
+    }
+
+  size_t WindowFrames() const
+    {
+    return std::min<size_t>(this->NumberOfFrames, this->SummaryWindow);
+    }
+
+  // One line per summary interval: avg/p99 in ms of every stage.
+  void PrintSummaryLine(std::ostream &os) const
+    {
+    os << "frame " << this->NumberOfFrames << ":";
+    for (StageMap::const_iterator stage = this->Stages.begin(); stage != this->Stages.end(); ++stage)
+      {
+      os << " " << stage->first << " " << Average(stage->second) << "/"
+         << Percentile99(stage->second) << " ms";
+      }
+    os << std::endl;
+    }
+
+  static double Average(const std::deque<double> &times)
+    {
+    double sum = 0.0;
+    for (size_t i = 0; i < times.size(); i++)
+      {
+      sum += times[i];
+      }
+    return times.empty() ? 0.0 : sum / times.size();
+    }
+
+  static double Percentile99(const std::deque<double> &times)
+    {
+    if (times.empty())
+      {
+      return 0.0;
+      }
+    std::vector<double> sorted(times.begin(), times.end());
+    size_t rank = (99 * sorted.size() + 99) / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + (rank - 1), sorted.end());
+    return sorted[rank - 1];
+    }
+
+  static std::string Escape(const char *name)
+    {
+    std::string escaped;
+    for (; *name; name++)
+      {
+      if (*name == '"' || *name == '\\')
+        {
+        escaped += '\\';
+        }
+      escaped += *name;
+      }
+    return escaped;
+    }
+
+  std::atomic<bool>                     Enabled;
+  std::chrono::steady_clock::time_point Origin;
+  size_t                                BufferSize;
+  std::mutex                            BuffersMutex;
+  std::vector<ThreadBuffer*>            Buffers;
+  std::string                           TraceFileOnExit;
+  int                                   SummaryInterval;
+  size_t                                SummaryWindow;
+  unsigned long                         NumberOfFrames;
+  long long                             LastFrameEnd;
+  StageMap                              Stages;
+};
+
+// Records the time from construction to destruction under name.
+class FrameProfileScope
+{
+public:
+  FrameProfileScope(const char *name)
+    {
+    this->Name = FrameProfiler::IsEnabled() ? name : 0;
+    if (this->Name)
+      {
+      this->Start = FrameProfiler::GetInstance().Now();
+      }
+    }
+  ~FrameProfileScope()
+    {
+    if (this->Name)
+      {
+      FrameProfiler &profiler = FrameProfiler::GetInstance();
+      profiler.RecordScope(this->Name, this->Start, profiler.Now());
+      }
+    }
+
+private:
+  const char *Name;
+  long long   Start;
+};
+
+#ifdef FRAME_PROFILER_DISABLED
+#define FRAME_PROFILE_SCOPE(name) do { } while (0)
+#define FRAME_PROFILE_COUNTER(name, value) do { } while (0)
+#else
+#define FRAME_PROFILE_CONCAT_(a, b) a##b
+#define FRAME_PROFILE_CONCAT(a, b) FRAME_PROFILE_CONCAT_(a, b)
+#define FRAME_PROFILE_SCOPE(name) \
+  FrameProfileScope FRAME_PROFILE_CONCAT(frameProfileScope, __LINE__)(name)
+#define FRAME_PROFILE_COUNTER(name, value) \
+  do { if (FrameProfiler::IsEnabled()) FrameProfiler::GetInstance().RecordCounter(name, value); } while (0)
+#endif
+
+#endif
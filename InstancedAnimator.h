@@ -0,0 +1,264 @@
+#ifndef __InstancedAnimator_h
+#define __InstancedAnimator_h
+#include <vtkActor.h>
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+#include <vtkFloatArray.h>
+#include <vtkGlyph3DMapper.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+#include "RenderScheduler.h"
+
+// Animates many copies of one mesh drawn by a single actor.
+// Instead of one vtkActor and vtkPolyDataMapper per copy, the copies are
+// the points of one polydata handed to a vtkGlyph3DMapper: the point
+// coordinates are the instance positions and the point data holds the
+// packed per-instance buffers "Orientation" (rotation angles about X, Y, Z
+// in degrees), "Scale" and "Color" (RGBA). Each tick evaluates the same
+// start/end lerp and X rotation as BatchActorAnimator, in closed form,
+// straight into these buffers, then marks them modified; there are no per-actor calls.
+// The glyph mapper does not need any particular OpenGL extension, so it
+// renders the same offscreen and with software (Mesa) rendering.
+class InstancedActorAnimator
+{
+public:
+  InstancedActorAnimator()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->Scheduler = 0;
+
+    this->Instances = vtkSmartPointer<vtkPolyData>::New();
+    this->Positions = vtkSmartPointer<vtkFloatArray>::New();
+    this->Positions->SetNumberOfComponents(3);
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(this->Positions);
+    this->Instances->SetPoints(points);
+    this->Orientations = vtkSmartPointer<vtkFloatArray>::New();
+    this->Orientations->SetNumberOfComponents(3);
+    this->Orientations->SetName("Orientation");
+    this->Scales = vtkSmartPointer<vtkFloatArray>::New();
+    this->Scales->SetNumberOfComponents(3);
+    this->Scales->SetName("Scale");
+    this->Colors = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    this->Colors->SetNumberOfComponents(4);
+    this->Colors->SetName("Color");
+    this->Instances->GetPointData()->AddArray(this->Orientations);
+    this->Instances->GetPointData()->AddArray(this->Scales);
+    this->Instances->GetPointData()->SetScalars(this->Colors);
+
+    this->Mapper = vtkSmartPointer<vtkGlyph3DMapper>::New();
+#if VTK_MAJOR_VERSION <= 5
+    this->Mapper->SetInput(this->Instances);
+#else
+    this->Mapper->SetInputData(this->Instances);
+#endif
+    this->Mapper->SetOrientationArray("Orientation");
+    this->Mapper->SetOrientationModeToRotation();
+    this->Mapper->OrientOn();
+    this->Mapper->SetScaleArray("Scale");
+    this->Mapper->SetScaleModeToScaleByVectorComponents();
+    this->Mapper->ScalingOn();
+    this->Mapper->ScalarVisibilityOn();
+    this->Actor = vtkSmartPointer<vtkActor>::New();
+    this->Actor->SetMapper(this->Mapper);
+    }
+
+  ~InstancedActorAnimator()
+    {
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // The mesh every instance draws.
+  void SetSourceData(vtkPolyData *source)
+    {
+#if VTK_MAJOR_VERSION <= 5
+    this->Mapper->SetSource(source);
+#else
+    this->Mapper->SetSourceData(source);
+#endif
+    }
+  void SetSourceConnection(vtkAlgorithmOutput *output)
+    {
+    this->Mapper->SetSourceConnection(output);
+    }
+
+  // The single actor to add to the renderer.
+  vtkActor *GetActor()           { return this->Actor; }
+  vtkGlyph3DMapper *GetMapper()  { return this->Mapper; }
+  vtkPolyData *GetInstances()    { return this->Instances; }
+
+  // Adds an instance and returns its index. color is RGB in 0..1 like
+  // vtkProperty::SetColor; angularVelocity in degrees per second as in
+  // BatchActorAnimator.
+  size_t AddInstance(const double start[3], const double end[3],
+                     const double color[3], double angularVelocity = 20.0)
+    {
+    size_t index = this->AngularVelocity.size();
+    for (int i = 0; i < 3; i++)
+      {
+      this->StartPosition[i].push_back(start[i]);
+      this->Displacement[i].push_back(end[i] - start[i]);
+      }
+    this->AngularVelocity.push_back(angularVelocity);
+
+    unsigned char rgba[4];
+    for (int i = 0; i < 3; i++)
+      {
+      rgba[i] = static_cast<unsigned char>(255.0 * std::min(1.0, std::max(0.0, color[i])) + 0.5);
+      }
+    rgba[3] = 255;
+    this->Positions->InsertNextTuple3(start[0], start[1], start[2]);
+    this->Orientations->InsertNextTuple3(0.0, 0.0, 0.0);
+    this->Scales->InsertNextTuple3(1.0, 1.0, 1.0);
+    this->Colors->InsertNextTuple4(rgba[0], rgba[1], rgba[2], rgba[3]);
+    this->Instances->Modified();
+    return index;
+    }
+
+  void RemoveAllInstances()
+    {
+    for (int i = 0; i < 3; i++)
+      {
+      this->StartPosition[i].clear();
+      this->Displacement[i].clear();
+      }
+    this->AngularVelocity.clear();
+    this->Positions->Reset();
+    this->Orientations->Reset();
+    this->Scales->Reset();
+    this->Colors->Reset();
+    this->Instances->Modified();
+    }
+
+  // Reserves storage so that adding instances does not reallocate.
+  void Reserve(size_t count)
+    {
+    for (int i = 0; i < 3; i++)
+      {
+      this->StartPosition[i].reserve(count);
+      this->Displacement[i].reserve(count);
+      }
+    this->AngularVelocity.reserve(count);
+    if (static_cast<vtkIdType>(count) > this->Positions->GetNumberOfTuples())
+      {
+      vtkIdType tuples = static_cast<vtkIdType>(count);
+      this->Positions->Resize(tuples);
+      this->Orientations->Resize(tuples);
+      this->Scales->Resize(tuples);
+      this->Colors->Resize(tuples);
+      }
+    }
+
+  size_t GetNumberOfInstances() const
+    {
+    return this->AngularVelocity.size();
+    }
+
+  void SetScale(size_t index, const double scale[3])
+    {
+    float *s = this->Scales->GetPointer(3 * index);
+    for (int i = 0; i < 3; i++)
+      {
+      s[i] = static_cast<float>(scale[i]);
+      }
+    this->Scales->Modified();
+    }
+
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    }
+
+  // Writes the positions at normalized time t (0..1) into the position
+  // buffer and the X angles time seconds into the cue into the
+  // orientation buffer.
+  void Evaluate(double t, double time)
+    {
+    const size_t n = this->AngularVelocity.size();
+    if (!n)
+      {
+      return;
+      }
+    float *position = this->Positions->GetPointer(0);
+    for (int i = 0; i < 3; i++)
+      {
+      const double *start = &this->StartPosition[i][0];
+      const double *displacement = &this->Displacement[i][0];
+      for (size_t a = 0; a < n; a++)
+        {
+        position[3 * a + i] = static_cast<float>(start[a] + displacement[a] * t);
+        }
+      }
+    this->Positions->Modified();
+    float *orientation = this->Orientations->GetPointer(0);
+    const double *velocity = &this->AngularVelocity[0];
+    for (size_t a = 0; a < n; a++)
+      {
+      orientation[3 * a] = static_cast<float>(fmod(velocity[a] * time, 360.0));
+      }
+    this->Orientations->Modified();
+    // The mapper compares the input's MTime; the arrays alone would not
+    // trigger a new upload.
+    this->Instances->Modified();
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    this->Evaluate(0.0, 0.0);
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    FRAME_PROFILE_SCOPE("InstancedActorAnimator::Tick");
+    double time = info->AnimationTime - info->StartTime;
+    double duration = info->EndTime - info->StartTime;
+    this->Evaluate(duration > 0 ? time / duration : 0.0, time);
+    if (this->Scheduler)
+      {
+      this->Scheduler->RequestRender();
+      }
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    double duration = info->EndTime - info->StartTime;
+    this->Evaluate(1.0, duration);
+    }
+
+protected:
+  typedef AnimationCueAdapter<InstancedActorAnimator> AnimationCueObserver;
+
+  AnimationCueObserver *                Observer;
+  RenderScheduler *                     Scheduler;
+  std::vector<double>                   StartPosition[3];
+  std::vector<double>                   Displacement[3];
+  std::vector<double>                   AngularVelocity;
+  vtkSmartPointer<vtkPolyData>          Instances;
+  vtkSmartPointer<vtkFloatArray>        Positions;
+  vtkSmartPointer<vtkFloatArray>        Orientations;
+  vtkSmartPointer<vtkFloatArray>        Scales;
+  vtkSmartPointer<vtkUnsignedCharArray> Colors;
+  vtkSmartPointer<vtkGlyph3DMapper>     Mapper;
+  vtkSmartPointer<vtkActor>             Actor;
+};
+
+#endif
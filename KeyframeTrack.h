@@ -0,0 +1,420 @@
+#ifndef __KeyframeTrack_h
+#define __KeyframeTrack_h
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// A sequence of keys (time, value) for one animated channel: position and
+// scale use 3 components, orientation uses a quaternion (w, x, y, z).
+// Keys are kept in flat arrays, one for the times and one for the values,
+// so a track with thousands of keys is a couple of contiguous blocks.
+//
+// The segment found by the last evaluation is remembered. While the
+// playhead moves forward it stays in the same or the next segment, which is
+// checked first (O(1)); any other time falls back to a binary search
+// (O(log n)).
+class KeyframeTrack
+{
+public:
+  enum
+    {
+    LINEAR = 0,
+    CATMULL_ROM,
+    BEZIER
+    };
+
+  KeyframeTrack(int numberOfComponents = 3)
+    {
+    this->NumberOfComponents = numberOfComponents;
+    this->Scratch.resize(3 * numberOfComponents);
+    this->Interpolation = LINEAR;
+    this->Quaternion = false;
+    this->Cursor = 0;
+    }
+
+  int GetNumberOfComponents() const
+    {
+    return this->NumberOfComponents;
+    }
+
+  // Orientation tracks hold unit quaternions (w, x, y, z) and interpolate
+  // them on the sphere: slerp for LINEAR, de Casteljau with slerp for
+  // BEZIER, and a normalized Catmull-Rom for CATMULL_ROM.
+  void SetQuaternion(bool quaternion)
+    {
+    this->Quaternion = quaternion;
+    }
+  bool GetQuaternion() const
+    {
+    return this->Quaternion;
+    }
+
+  void SetInterpolation(int interpolation)
+    {
+    this->Interpolation = interpolation;
+    }
+  int GetInterpolation() const
+    {
+    return this->Interpolation;
+    }
+  void SetInterpolationToLinear()     { this->SetInterpolation(LINEAR); }
+  void SetInterpolationToCatmullRom() { this->SetInterpolation(CATMULL_ROM); }
+  void SetInterpolationToBezier()     { this->SetInterpolation(BEZIER); }
+
+  void Reserve(size_t numberOfKeys)
+    {
+    this->Times.reserve(numberOfKeys);
+    this->Values.reserve(numberOfKeys * this->NumberOfComponents);
+    }
+
+  void RemoveAllKeys()
+    {
+    this->Times.clear();
+    this->Values.clear();
+    this->Handles.clear();
+    this->Cursor = 0;
+    }
+
+  size_t GetNumberOfKeys() const
+    {
+    return this->Times.size();
+    }
+
+  double GetStartTime() const
+    {
+    return this->Times.empty() ? 0.0 : this->Times.front();
+    }
+  double GetEndTime() const
+    {
+    return this->Times.empty() ? 0.0 : this->Times.back();
+    }
+
+  // Keys must be added in increasing time order.
+  void AddKey(double time, const double *value)
+    {
+    this->Times.push_back(time);
+    this->Values.insert(this->Values.end(), value, value + this->NumberOfComponents);
+    if (!this->Handles.empty())
+      {
+      // Keys without handles get handles on the key itself.
+      this->Handles.insert(this->Handles.end(), value, value + this->NumberOfComponents);
+      this->Handles.insert(this->Handles.end(), value, value + this->NumberOfComponents);
+      }
+    }
+
+  // Adds a key with the incoming and outgoing control points used by
+  // BEZIER interpolation.
+  void AddKey(double time, const double *value,
+              const double *inHandle, const double *outHandle)
+    {
+    if (this->Handles.empty() && !this->Times.empty())
+      {
+      this->Handles.resize(2 * this->Values.size());
+      for (size_t k = 0; k < this->Times.size(); k++)
+        {
+        const double *v = &this->Values[k * this->NumberOfComponents];
+        std::copy(v, v + this->NumberOfComponents,
+                  &this->Handles[2 * k * this->NumberOfComponents]);
+        std::copy(v, v + this->NumberOfComponents,
+                  &this->Handles[(2 * k + 1) * this->NumberOfComponents]);
+        }
+      }
+    this->Times.push_back(time);
+    this->Values.insert(this->Values.end(), value, value + this->NumberOfComponents);
+    this->Handles.insert(this->Handles.end(), inHandle, inHandle + this->NumberOfComponents);
+    this->Handles.insert(this->Handles.end(), outHandle, outHandle + this->NumberOfComponents);
+    }
+
+  // Value of the track at the given time. Times outside of the keys are
+  // clamped to the first or last key.
+  void Evaluate(double time, double *value)
+    {
+    const int nc = this->NumberOfComponents;
+    const size_t n = this->Times.size();
+    if (n == 0)
+      {
+      return;
+      }
+    if (n == 1 || time <= this->Times[0])
+      {
+      std::copy(&this->Values[0], &this->Values[0] + nc, value);
+      return;
+      }
+    if (time >= this->Times[n - 1])
+      {
+      std::copy(&this->Values[(n - 1) * nc], &this->Values[(n - 1) * nc] + nc, value);
+      return;
+      }
+
+    size_t k = this->FindSegment(time);
+    double t0 = this->Times[k];
+    double t1 = this->Times[k + 1];
+    double u = (time - t0) / (t1 - t0);
+    const double *p1 = &this->Values[k * nc];
+    const double *p2 = &this->Values[(k + 1) * nc];
+
+    switch (this->Interpolation)
+      {
+      case CATMULL_ROM:
+        {
+        size_t k0 = k > 0 ? k - 1 : k;
+        size_t k3 = k + 2 < n ? k + 2 : k + 1;
+        const double *p0 = &this->Values[k0 * nc];
+        const double *p3 = &this->Values[k3 * nc];
+        double q0[4], q2[4], q3[4];
+        if (this->Quaternion)
+          {
+          // Keep each key in the same hemisphere as the one before it, so
+          // the spline takes the short way around.
+          AlignQuaternion(p1, p0, q0);
+          AlignQuaternion(p1, p2, q2);
+          AlignQuaternion(q2, p3, q3);
+          this->CatmullRom(q0, p1, q2, q3, this->Times[k0], t0, t1, this->Times[k3], u, value);
+          NormalizeQuaternion(value);
+          }
+        else
+          {
+          this->CatmullRom(p0, p1, p2, p3, this->Times[k0], t0, t1, this->Times[k3], u, value);
+          }
+        }
+        break;
+      case BEZIER:
+        if (!this->Handles.empty())
+          {
+          const double *c1 = &this->Handles[(2 * k + 1) * nc];
+          const double *c2 = &this->Handles[2 * (k + 1) * nc];
+          if (this->Quaternion)
+            {
+            double a[4], b[4], c[4], ab[4], bc[4];
+            Slerp(p1, c1, u, a);
+            Slerp(c1, c2, u, b);
+            Slerp(c2, p2, u, c);
+            Slerp(a, b, u, ab);
+            Slerp(b, c, u, bc);
+            Slerp(ab, bc, u, value);
+            }
+          else
+            {
+            double v = 1.0 - u;
+            double b0 = v * v * v, b1 = 3.0 * v * v * u, b2 = 3.0 * v * u * u, b3 = u * u * u;
+            for (int i = 0; i < nc; i++)
+              {
+              value[i] = b0 * p1[i] + b1 * c1[i] + b2 * c2[i] + b3 * p2[i];
+              }
+            }
+          break;
+          }
+        // No handles were given, use linear.
+        // fall through
+      default:
+        if (this->Quaternion)
+          {
+          Slerp(p1, p2, u, value);
+          }
+        else
+          {
+          for (int i = 0; i < nc; i++)
+            {
+            value[i] = p1[i] + (p2[i] - p1[i]) * u;
+            }
+          }
+        break;
+      }
+    }
+
+  // Box holding every value the track takes from time t0 to t1, per
+  // component. Each segment is bounded by the hull of its Bezier control
+  // points (the keys alone for linear segments), so spline overshoot is
+  // included; the box may be larger than the curve, never smaller.
+  // Not meaningful for quaternion tracks.
+  void GetBounds(double t0, double t1, double *minimum, double *maximum)
+    {
+    const int nc = this->NumberOfComponents;
+    const size_t n = this->Times.size();
+    if (n == 0)
+      {
+      return;
+      }
+    double *value = &this->Scratch[0];
+    this->Evaluate(t0, value);
+    std::copy(value, value + nc, minimum);
+    std::copy(value, value + nc, maximum);
+    this->Evaluate(t1, value);
+    Extend(value, nc, minimum, maximum);
+    if (n == 1 || t1 <= this->Times[0] || t0 >= this->Times[n - 1])
+      {
+      return;
+      }
+    size_t first = t0 <= this->Times[0] ? 0 : this->FindSegment(t0);
+    for (size_t k = first; k + 1 < n && this->Times[k] < t1; k++)
+      {
+      const double *p1 = &this->Values[k * nc];
+      const double *p2 = &this->Values[(k + 1) * nc];
+      Extend(p1, nc, minimum, maximum);
+      Extend(p2, nc, minimum, maximum);
+      if (this->Interpolation == CATMULL_ROM)
+        {
+        // The Hermite segment as a Bezier: p1, p1 + m1 / 3, p2 - m2 / 3, p2.
+        size_t k0 = k > 0 ? k - 1 : k;
+        size_t k3 = k + 2 < n ? k + 2 : k + 1;
+        const double *p0 = &this->Values[k0 * nc];
+        const double *p3 = &this->Values[k3 * nc];
+        double dt = this->Times[k + 1] - this->Times[k];
+        double d1 = this->Times[k + 1] - this->Times[k0];
+        double d2 = this->Times[k3] - this->Times[k];
+        double *c1 = value + nc, *c2 = value + 2 * nc;
+        for (int i = 0; i < nc; i++)
+          {
+          double m1 = d1 > 0.0 ? (p2[i] - p0[i]) / d1 * dt : 0.0;
+          double m2 = d2 > 0.0 ? (p3[i] - p1[i]) / d2 * dt : 0.0;
+          c1[i] = p1[i] + m1 / 3.0;
+          c2[i] = p2[i] - m2 / 3.0;
+          }
+        Extend(c1, nc, minimum, maximum);
+        Extend(c2, nc, minimum, maximum);
+        }
+      else if (this->Interpolation == BEZIER && !this->Handles.empty())
+        {
+        Extend(&this->Handles[(2 * k + 1) * nc], nc, minimum, maximum);
+        Extend(&this->Handles[2 * (k + 1) * nc], nc, minimum, maximum);
+        }
+      }
+    }
+
+  // Spherical linear interpolation between unit quaternions (w, x, y, z)
+  // along the shortest arc.
+  static void Slerp(const double *q0, const double *q1, double u, double *q)
+    {
+    double cosom = q0[0] * q1[0] + q0[1] * q1[1] + q0[2] * q1[2] + q0[3] * q1[3];
+    double sign = 1.0;
+    if (cosom < 0.0)
+      {
+      cosom = -cosom;
+      sign = -1.0;
+      }
+    double s0, s1;
+    if (cosom > 0.9995)
+      {
+      // Nearly parallel, lerp is accurate and avoids dividing by sin(0).
+      s0 = 1.0 - u;
+      s1 = u;
+      }
+    else
+      {
+      double omega = acos(cosom);
+      double sinom = sin(omega);
+      s0 = sin((1.0 - u) * omega) / sinom;
+      s1 = sin(u * omega) / sinom;
+      }
+    for (int i = 0; i < 4; i++)
+      {
+      q[i] = s0 * q0[i] + sign * s1 * q1[i];
+      }
+    NormalizeQuaternion(q);
+    }
+
+  static void NormalizeQuaternion(double *q)
+    {
+    double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (norm > 0.0)
+      {
+      for (int i = 0; i < 4; i++)
+        {
+        q[i] /= norm;
+        }
+      }
+    }
+
+  // Angle (degrees) and axis of a unit quaternion, as taken by RotateWXYZ.
+  static void QuaternionToAngleAxis(const double *q, double *angle, double axis[3])
+    {
+    double w = std::max(-1.0, std::min(1.0, q[0]));
+    double s = sqrt(1.0 - w * w);
+    *angle = 2.0 * acos(w) * 180.0 / 3.14159265358979323846;
+    if (s < 1.0e-9)
+      {
+      axis[0] = 1.0; axis[1] = 0.0; axis[2] = 0.0;
+      return;
+      }
+    axis[0] = q[1] / s;
+    axis[1] = q[2] / s;
+    axis[2] = q[3] / s;
+    }
+
+protected:
+  static void Extend(const double *value, int nc, double *minimum, double *maximum)
+    {
+    for (int i = 0; i < nc; i++)
+      {
+      minimum[i] = std::min(minimum[i], value[i]);
+      maximum[i] = std::max(maximum[i], value[i]);
+      }
+    }
+
+  size_t FindSegment(double time)
+    {
+    const size_t last = this->Times.size() - 2;
+    size_t c = std::min(this->Cursor, last);
+    if (this->Times[c] <= time)
+      {
+      if (time < this->Times[c + 1])
+        {
+        return c;
+        }
+      if (c < last && time < this->Times[c + 2])
+        {
+        this->Cursor = c + 1;
+        return c + 1;
+        }
+      }
+    size_t k = std::upper_bound(this->Times.begin(), this->Times.end(), time) -
+      this->Times.begin();
+    k = k > 0 ? k - 1 : 0;
+    this->Cursor = std::min(k, last);
+    return this->Cursor;
+    }
+
+  // Non-uniform Catmull-Rom in Hermite form: the tangent at each key is the
+  // slope between its neighbours, scaled by the segment duration.
+  void CatmullRom(const double *p0, const double *p1, const double *p2, const double *p3,
+                  double t0, double t1, double t2, double t3, double u, double *value) const
+    {
+    double dt = t2 - t1;
+    double d1 = t2 - t0;
+    double d2 = t3 - t1;
+    double u2 = u * u, u3 = u2 * u;
+    double h00 = 2.0 * u3 - 3.0 * u2 + 1.0;
+    double h10 = u3 - 2.0 * u2 + u;
+    double h01 = -2.0 * u3 + 3.0 * u2;
+    double h11 = u3 - u2;
+    for (int i = 0; i < this->NumberOfComponents; i++)
+      {
+      double m1 = d1 > 0.0 ? (p2[i] - p0[i]) / d1 * dt : 0.0;
+      double m2 = d2 > 0.0 ? (p3[i] - p1[i]) / d2 * dt : 0.0;
+      value[i] = h00 * p1[i] + h10 * m1 + h01 * p2[i] + h11 * m2;
+      }
+    }
+
+  static void AlignQuaternion(const double *reference, const double *q, double *aligned)
+    {
+    double dot = reference[0] * q[0] + reference[1] * q[1] +
+      reference[2] * q[2] + reference[3] * q[3];
+    double sign = dot < 0.0 ? -1.0 : 1.0;
+    for (int i = 0; i < 4; i++)
+      {
+      aligned[i] = sign * q[i];
+      }
+    }
+
+  int                 NumberOfComponents;
+  int                 Interpolation;
+  bool                Quaternion;
+  size_t              Cursor;
+  std::vector<double> Times;
+  std::vector<double> Values;
+  std::vector<double> Handles;
+  // A value and two control points for GetBounds.
+  std::vector<double> Scratch;
+};
+
+#endif
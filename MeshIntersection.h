@@ -0,0 +1,793 @@
+#ifndef __MeshIntersection_h
+#define __MeshIntersection_h
+#include <vtkActor.h>
+#include <vtkAnimationCue.h>
+#include <vtkCellArray.h>
+#include <vtkCommand.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "FrameProfiler.h"
+
+// Bounding volume hierarchy over the triangles of a mesh, in model
+// coordinates. Built once per mesh; moving the actor does not touch it.
+// Triangles are stored leaf by leaf (9 floats each) so a leaf is one
+// contiguous block.
+class MeshBVH
+{
+public:
+  struct Node
+    {
+    float Min[3];
+    float Max[3];
+    // Leaf: triangles First .. First + Count - 1.
+    // Internal (Count == 0): children First and First + 1.
+    int   First;
+    int   Count;
+    };
+
+  MeshBVH()
+    {
+    this->LeafSize = 4;
+    }
+
+  void SetLeafSize(int size) { this->LeafSize = size > 0 ? size : 1; }
+
+  // Polygons with more than 3 points are split into a triangle fan.
+  void Build(vtkPolyData *mesh)
+    {
+    this->Nodes.clear();
+    this->Vertices.clear();
+    this->CellIds.clear();
+
+    std::vector<float> vertices;
+    std::vector<vtkIdType> cellIds;
+    vtkPoints *points = mesh->GetPoints();
+    vtkCellArray *polys = mesh->GetPolys();
+    if (!points || !polys)
+      {
+      return;
+      }
+    vtkIdType npts;
+#if VTK_MAJOR_VERSION >= 9
+    const vtkIdType *pts;
+#else
+    vtkIdType *pts;
+#endif
+    vtkIdType cellId = mesh->GetNumberOfVerts() + mesh->GetNumberOfLines();
+    double p[3][3];
+    for (polys->InitTraversal(); polys->GetNextCell(npts, pts); cellId++)
+      {
+      for (vtkIdType i = 1; i + 1 < npts; i++)
+        {
+        points->GetPoint(pts[0], p[0]);
+        points->GetPoint(pts[i], p[1]);
+        points->GetPoint(pts[i + 1], p[2]);
+        for (int v = 0; v < 3; v++)
+          {
+          for (int c = 0; c < 3; c++)
+            {
+            vertices.push_back(static_cast<float>(p[v][c]));
+            }
+          }
+        cellIds.push_back(cellId);
+        }
+      }
+
+    int count = static_cast<int>(cellIds.size());
+    if (count == 0)
+      {
+      return;
+      }
+    std::vector<int> order(count);
+    std::vector<float> centroids(3 * count);
+    for (int t = 0; t < count; t++)
+      {
+      order[t] = t;
+      for (int c = 0; c < 3; c++)
+        {
+        centroids[3 * t + c] = (vertices[9 * t + c] + vertices[9 * t + 3 + c] +
+                                vertices[9 * t + 6 + c]) / 3.0f;
+        }
+      }
+    this->Nodes.reserve(2 * (count / this->LeafSize + 1));
+    this->Nodes.push_back(Node());
+    this->Split(0, &order[0], 0, count, vertices, centroids);
+
+    this->Vertices.resize(vertices.size());
+    this->CellIds.resize(count);
+    for (int t = 0; t < count; t++)
+      {
+      std::copy(&vertices[9 * order[t]], &vertices[9 * order[t]] + 9, &this->Vertices[9 * t]);
+      this->CellIds[t] = cellIds[order[t]];
+      }
+    }
+
+  bool IsEmpty() const                  { return this->Nodes.empty(); }
+  const Node &GetNode(int i) const      { return this->Nodes[i]; }
+  const float *GetTriangle(int t) const { return &this->Vertices[9 * t]; }
+  vtkIdType GetCellId(int t) const      { return this->CellIds[t]; }
+  int GetNumberOfTriangles() const      { return static_cast<int>(this->CellIds.size()); }
+
+  // Depth-first walk for ray queries. The query gives EnterBox(node),
+  // where its rays enter the node's box or DBL_MAX when none reaches it
+  // before its closest hit so far, and IntersectTriangle(triangle), called
+  // for every triangle of a reached leaf. With Query::NearestFirst set the
+  // children are visited in the order their boxes are entered, at the cost
+  // of testing them once more.
+  template <class Query>
+  void Traverse(Query &query) const
+    {
+    if (this->Nodes.empty())
+      {
+      return;
+      }
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top)
+      {
+      const Node &node = this->Nodes[stack[--top]];
+      if (query.EnterBox(node) == DBL_MAX)
+        {
+        continue;
+        }
+      if (node.Count)
+        {
+        for (int i = node.First; i < node.First + node.Count; i++)
+          {
+          query.IntersectTriangle(i);
+          }
+        }
+      else if (top + 2 <= 64)
+        {
+        int nearer = node.First, farther = node.First + 1;
+        if (Query::NearestFirst &&
+            query.EnterBox(this->Nodes[farther]) < query.EnterBox(this->Nodes[nearer]))
+          {
+          std::swap(nearer, farther);
+          }
+        stack[top++] = farther;
+        stack[top++] = nearer;
+        }
+      }
+    }
+
+  // Closest triangle hit by origin + t direction for t in [0, t); returns
+  // the triangle and lowers t, or returns -1. See IntersectTriangle for
+  // the tolerance.
+  int IntersectRay(const double origin[3], const double direction[3], double tolerance,
+                   double &t) const
+    {
+    RayQuery query(this, origin, direction, tolerance, t);
+    this->Traverse(query);
+    t = query.T;
+    return query.Triangle;
+    }
+
+  // Box around triangles grown by how far a triangle tolerance (see
+  // IntersectTriangle) lets hits lie outside of them, in the units of the
+  // box, and by a rounding epsilon.
+  template <class T>
+  static void GrowBox(const T min[3], const T max[3], double tolerance,
+                      double low[3], double high[3])
+    {
+    for (int c = 0; c < 3; c++)
+      {
+      double pad = 2.0 * tolerance * (max[c] - min[c]) +
+        FLT_EPSILON * (fabs(min[c]) + fabs(max[c]));
+      low[c] = min[c] - pad;
+      high[c] = max[c] + pad;
+      }
+    }
+
+  // Parameter where origin + t direction enters the box, or DBL_MAX when
+  // it misses it for t in [0, limit]; inverse is 1 / direction. The
+  // components of origin and inverse are stride apart, so that the rays
+  // of a packet stored by component are read in place.
+  static double EnterBox(const double low[3], const double high[3], const double *origin,
+                         const double *inverse, double limit, int stride = 1)
+    {
+    double tmin = 0.0, tmax = limit;
+    for (int c = 0; c < 3; c++)
+      {
+      double t0 = (low[c] - origin[c * stride]) * inverse[c * stride];
+      double t1 = (high[c] - origin[c * stride]) * inverse[c * stride];
+      tmin = std::max(tmin, std::min(t0, t1));
+      tmax = std::min(tmax, std::max(t0, t1));
+      }
+    return tmin <= tmax ? tmin : DBL_MAX;
+    }
+
+  // Moller-Trumbore test of origin + r direction against triangle v for r
+  // in [0, t); lowers t on a hit. Hits up to tolerance outside of the
+  // triangle, in its parametric coordinates, are accepted. Branch free, so
+  // that loops over the rays of a packet vectorize; origin and direction
+  // are strided as in EnterBox.
+  static bool IntersectTriangle(const float *v, const double *origin, const double *direction,
+                                double tolerance, double &t, int stride = 1)
+    {
+    double e1[3], e2[3], s[3], d[3];
+    for (int c = 0; c < 3; c++)
+      {
+      e1[c] = static_cast<double>(v[3 + c]) - v[c];
+      e2[c] = static_cast<double>(v[6 + c]) - v[c];
+      s[c] = origin[c * stride] - v[c];
+      d[c] = direction[c * stride];
+      }
+    double h[3] = { d[1] * e2[2] - d[2] * e2[1],
+                    d[2] * e2[0] - d[0] * e2[2],
+                    d[0] * e2[1] - d[1] * e2[0] };
+    double det = e1[0] * h[0] + e1[1] * h[1] + e1[2] * h[2];
+    double inv = fabs(det) > 1.0e-300 ? 1.0 / det : 0.0;
+    double u = (s[0] * h[0] + s[1] * h[1] + s[2] * h[2]) * inv;
+    double q[3] = { s[1] * e1[2] - s[2] * e1[1],
+                    s[2] * e1[0] - s[0] * e1[2],
+                    s[0] * e1[1] - s[1] * e1[0] };
+    double w = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+    double r = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+    bool hit = inv != 0.0 && u >= -tolerance && w >= -tolerance &&
+      u + w <= 1.0 + tolerance && r >= 0.0 && r < t;
+    t = hit ? r : t;
+    return hit;
+    }
+
+protected:
+  // A single ray; nearest child first, so that the farther child is
+  // culled by the hits in the nearer one more often.
+  struct RayQuery
+    {
+    enum { NearestFirst = 1 };
+
+    RayQuery(const MeshBVH *tree, const double origin[3], const double direction[3],
+             double tolerance, double t)
+      : Tree(tree), Tolerance(tolerance), T(t), Triangle(-1)
+      {
+      for (int c = 0; c < 3; c++)
+        {
+        this->Origin[c] = origin[c];
+        this->Direction[c] = direction[c];
+        this->Inverse[c] = fabs(direction[c]) > 1.0e-300 ? 1.0 / direction[c] :
+          (direction[c] < 0 ? -1.0e300 : 1.0e300);
+        }
+      }
+    double EnterBox(const Node &node) const
+      {
+      double low[3], high[3];
+      MeshBVH::GrowBox(node.Min, node.Max, this->Tolerance, low, high);
+      return MeshBVH::EnterBox(low, high, this->Origin, this->Inverse, this->T);
+      }
+    void IntersectTriangle(int triangle)
+      {
+      if (MeshBVH::IntersectTriangle(this->Tree->GetTriangle(triangle), this->Origin,
+                                     this->Direction, this->Tolerance, this->T))
+        {
+        this->Triangle = triangle;
+        }
+      }
+    const MeshBVH * Tree;
+    double          Origin[3];
+    double          Direction[3];
+    double          Inverse[3];
+    double          Tolerance;
+    double          T;
+    int             Triangle;
+    };
+
+  void Split(int nodeIndex, int *order, int begin, int end,
+             const std::vector<float> &vertices, const std::vector<float> &centroids)
+    {
+    Node node;
+    for (int c = 0; c < 3; c++)
+      {
+      node.Min[c] = FLT_MAX;
+      node.Max[c] = -FLT_MAX;
+      }
+    for (int i = begin; i < end; i++)
+      {
+      const float *tri = &vertices[9 * order[i]];
+      for (int v = 0; v < 3; v++)
+        {
+        for (int c = 0; c < 3; c++)
+          {
+          node.Min[c] = std::min(node.Min[c], tri[3 * v + c]);
+          node.Max[c] = std::max(node.Max[c], tri[3 * v + c]);
+          }
+        }
+      }
+
+    if (end - begin <= this->LeafSize)
+      {
+      node.First = begin;
+      node.Count = end - begin;
+      this->Nodes[nodeIndex] = node;
+      return;
+      }
+
+    // Median split along the longest axis.
+    int axis = 0;
+    for (int c = 1; c < 3; c++)
+      {
+      if (node.Max[c] - node.Min[c] > node.Max[axis] - node.Min[axis])
+        {
+        axis = c;
+        }
+      }
+    int middle = (begin + end) / 2;
+    std::nth_element(order + begin, order + middle, order + end,
+                     CentroidLess(&centroids[0], axis));
+
+    node.First = static_cast<int>(this->Nodes.size());
+    node.Count = 0;
+    this->Nodes[nodeIndex] = node;
+    this->Nodes.push_back(Node());
+    this->Nodes.push_back(Node());
+    this->Split(node.First, order, begin, middle, vertices, centroids);
+    this->Split(node.First + 1, order, middle, end, vertices, centroids);
+    }
+
+  struct CentroidLess
+    {
+    CentroidLess(const float *centroids, int axis) : Centroids(centroids), Axis(axis) {}
+    bool operator()(int a, int b) const
+      {
+      return this->Centroids[3 * a + this->Axis] < this->Centroids[3 * b + this->Axis];
+      }
+    const float *Centroids;
+    int Axis;
+    };
+
+  int                    LeafSize;
+  std::vector<Node>      Nodes;
+  std::vector<float>     Vertices;
+  std::vector<vtkIdType> CellIds;
+};
+
+// Intersection curve of two moving meshes, a per-frame replacement for
+// vtkIntersectionPolyDataFilter on actors.
+// Each mesh gets a MeshBVH in its model coordinates, rebuilt only when the
+// mesh is modified. Every update takes the current actor matrices, brings
+// mesh 1 into the model space of mesh 0 and walks both hierarchies
+// together, testing only overlapping node pairs.
+//
+// Candidate triangle pairs are collected with the boxes grown by Margin.
+// While the relative motion of the two meshes since then stays below
+// Margin, no triangle pair can have started touching, so the traversal is
+// skipped and only the previous candidates are re-tested.
+//
+// The output holds one line per intersecting triangle pair, in world
+// coordinates, and can be fed to a vtkPolyDataMapper with SetInputData.
+// When neither actor matrix nor mesh changed since the last update the
+// output is left alone, so its MTime only moves when the lines do.
+class MeshIntersector
+{
+public:
+  MeshIntersector()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Intersector = this;
+    this->Margin = 0.0;
+    this->CacheValid = false;
+    this->ContactSetReused = false;
+    this->OutputValid = false;
+    for (int i = 0; i < 2; i++)
+      {
+      this->Actors[i] = 0;
+      this->Meshes[i] = 0;
+      this->MeshMTime[i] = 0;
+      }
+    this->Output = vtkSmartPointer<vtkPolyData>::New();
+    this->Output->SetPoints(vtkSmartPointer<vtkPoints>::New());
+    this->Output->SetLines(vtkSmartPointer<vtkCellArray>::New());
+    }
+
+  ~MeshIntersector()
+    {
+    this->Observer->Intersector = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // index is 0 or 1. The actor supplies the transform, the mesh the
+  // geometry in model coordinates (usually the mapper input).
+  void SetInput(int index, vtkActor *actor, vtkPolyData *mesh)
+    {
+    this->Actors[index] = actor;
+    this->Meshes[index] = mesh;
+    this->MeshMTime[index] = 0;
+    this->CacheValid = false;
+    this->OutputValid = false;
+    }
+
+  // Distance, in the model coordinates of mesh 0, by which the contact set
+  // of the last traversal stays valid. 0 disables the reuse.
+  void SetMargin(double margin)
+    {
+    this->Margin = margin;
+    this->CacheValid = false;
+    }
+  double GetMargin() const { return this->Margin; }
+
+  vtkPolyData *GetOutput() { return this->Output; }
+
+  size_t GetNumberOfCandidatePairs() const { return this->Candidates.size(); }
+  bool GetContactSetReused() const         { return this->ContactSetReused; }
+
+  // Updates the intersection on every tick of the cue.
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    }
+
+  void Update()
+    {
+    FRAME_PROFILE_SCOPE("MeshIntersector::Update");
+    if (!this->Actors[0] || !this->Actors[1] || !this->Meshes[0] || !this->Meshes[1])
+      {
+      return;
+      }
+    for (int i = 0; i < 2; i++)
+      {
+      if (this->Meshes[i]->GetMTime() != this->MeshMTime[i])
+        {
+        this->Trees[i].Build(this->Meshes[i]);
+        this->MeshMTime[i] = this->Meshes[i]->GetMTime();
+        this->CacheValid = false;
+        this->OutputValid = false;
+        }
+      }
+
+    double world0[16], world1[16], inverse0[16], relative[16];
+    this->Actors[0]->GetMatrix(world0);
+    this->Actors[1]->GetMatrix(world1);
+    if (this->OutputValid &&
+        std::equal(world0, world0 + 16, this->OutputMatrix[0]) &&
+        std::equal(world1, world1 + 16, this->OutputMatrix[1]))
+      {
+      return;
+      }
+    std::copy(world0, world0 + 16, this->OutputMatrix[0]);
+    std::copy(world1, world1 + 16, this->OutputMatrix[1]);
+    this->OutputValid = true;
+    vtkMatrix4x4::Invert(world0, inverse0);
+    vtkMatrix4x4::Multiply4x4(inverse0, world1, relative);
+
+    this->ContactSetReused = this->CacheValid && this->Margin > 0.0 &&
+      this->GetMaxDisplacement(relative) < this->Margin;
+    if (!this->ContactSetReused)
+      {
+      this->Candidates.clear();
+      // An empty mesh has no candidates, and no box to measure the
+      // displacement of on the next update.
+      this->CacheValid = !this->Trees[0].IsEmpty() && !this->Trees[1].IsEmpty();
+      if (this->CacheValid)
+        {
+        this->Traverse(relative);
+        }
+      std::copy(relative, relative + 16, this->CachedRelative);
+      }
+    FRAME_PROFILE_COUNTER("MeshIntersector candidate pairs", static_cast<double>(this->Candidates.size()));
+
+    vtkPoints *points = this->Output->GetPoints();
+    vtkCellArray *lines = this->Output->GetLines();
+    points->Reset();
+    lines->Reset();
+    double a[3][3], b[3][3], p[2][3];
+    for (size_t i = 0; i < this->Candidates.size(); i++)
+      {
+      LoadTriangle(this->Trees[0].GetTriangle(this->Candidates[i].first), 0, a);
+      LoadTriangle(this->Trees[1].GetTriangle(this->Candidates[i].second), relative, b);
+      if (IntersectTriangles(a, b, p[0], p[1]))
+        {
+        vtkIdType ids[2];
+        for (int e = 0; e < 2; e++)
+          {
+          double w[3];
+          TransformPoint(world0, p[e], w);
+          ids[e] = points->InsertNextPoint(w);
+          }
+        lines->InsertNextCell(2, ids);
+        }
+      }
+    points->Modified();
+    lines->Modified();
+    this->Output->Modified();
+    }
+
+protected:
+  // Largest distance a point of mesh 1 moved, in mesh 0 model space, since
+  // the candidates were collected. The transforms are affine, so the
+  // largest move over the bounding box of mesh 1 is at one of its corners.
+  double GetMaxDisplacement(const double relative[16]) const
+    {
+    const MeshBVH::Node &root = this->Trees[1].GetNode(0);
+    double largest = 0.0;
+    for (int corner = 0; corner < 8; corner++)
+      {
+      double p[3] = { corner & 1 ? root.Max[0] : root.Min[0],
+                      corner & 2 ? root.Max[1] : root.Min[1],
+                      corner & 4 ? root.Max[2] : root.Min[2] };
+      double now[3], then[3];
+      TransformPoint(relative, p, now);
+      TransformPoint(this->CachedRelative, p, then);
+      double d2 = 0.0;
+      for (int c = 0; c < 3; c++)
+        {
+        d2 += (now[c] - then[c]) * (now[c] - then[c]);
+        }
+      largest = std::max(largest, d2);
+      }
+    return sqrt(largest);
+    }
+
+  void Traverse(const double relative[16])
+    {
+    std::vector<std::pair<int, int> > stack;
+    stack.push_back(std::make_pair(0, 0));
+    double a[3][3], b[3][3];
+    while (!stack.empty())
+      {
+      std::pair<int, int> top = stack.back();
+      stack.pop_back();
+      const MeshBVH::Node &na = this->Trees[0].GetNode(top.first);
+      const MeshBVH::Node &nb = this->Trees[1].GetNode(top.second);
+      double bmin[3], bmax[3];
+      TransformBox(relative, nb.Min, nb.Max, bmin, bmax);
+      if (!BoxesOverlap(na.Min, na.Max, bmin, bmax, this->Margin))
+        {
+        continue;
+        }
+
+      if (na.Count && nb.Count)
+        {
+        for (int i = na.First; i < na.First + na.Count; i++)
+          {
+          LoadTriangle(this->Trees[0].GetTriangle(i), 0, a);
+          double amin[3], amax[3];
+          TriangleBounds(a, amin, amax);
+          for (int j = nb.First; j < nb.First + nb.Count; j++)
+            {
+            LoadTriangle(this->Trees[1].GetTriangle(j), relative, b);
+            double tmin[3], tmax[3];
+            TriangleBounds(b, tmin, tmax);
+            if (BoxesOverlap(amin, amax, tmin, tmax, this->Margin))
+              {
+              this->Candidates.push_back(std::make_pair(i, j));
+              }
+            }
+          }
+        }
+      else if (nb.Count ||
+               (!na.Count && (na.Max[0] - na.Min[0]) + (na.Max[1] - na.Min[1]) + (na.Max[2] - na.Min[2]) >=
+                             (bmax[0] - bmin[0]) + (bmax[1] - bmin[1]) + (bmax[2] - bmin[2])))
+        {
+        // Descend into the larger node first.
+        stack.push_back(std::make_pair(na.First, top.second));
+        stack.push_back(std::make_pair(na.First + 1, top.second));
+        }
+      else
+        {
+        stack.push_back(std::make_pair(top.first, nb.First));
+        stack.push_back(std::make_pair(top.first, nb.First + 1));
+        }
+      }
+    }
+
+  static void TransformPoint(const double m[16], const double p[3], double out[3])
+    {
+    for (int r = 0; r < 3; r++)
+      {
+      out[r] = m[4 * r] * p[0] + m[4 * r + 1] * p[1] + m[4 * r + 2] * p[2] + m[4 * r + 3];
+      }
+    }
+
+  // Axis-aligned box enclosing the transformed box.
+  static void TransformBox(const double m[16], const float min[3], const float max[3],
+                           double outMin[3], double outMax[3])
+    {
+    double center[3], half[3];
+    for (int c = 0; c < 3; c++)
+      {
+      center[c] = 0.5 * (min[c] + max[c]);
+      half[c] = 0.5 * (max[c] - min[c]);
+      }
+    double moved[3];
+    TransformPoint(m, center, moved);
+    for (int r = 0; r < 3; r++)
+      {
+      double extent = fabs(m[4 * r]) * half[0] + fabs(m[4 * r + 1]) * half[1] +
+        fabs(m[4 * r + 2]) * half[2];
+      outMin[r] = moved[r] - extent;
+      outMax[r] = moved[r] + extent;
+      }
+    }
+
+  template <class T>
+  static bool BoxesOverlap(const T amin[3], const T amax[3],
+                           const double bmin[3], const double bmax[3], double margin)
+    {
+    for (int c = 0; c < 3; c++)
+      {
+      if (amin[c] - margin > bmax[c] || bmin[c] > amax[c] + margin)
+        {
+        return false;
+        }
+      }
+    return true;
+    }
+
+  static void LoadTriangle(const float *tri, const double *m, double out[3][3])
+    {
+    for (int v = 0; v < 3; v++)
+      {
+      double p[3] = { tri[3 * v], tri[3 * v + 1], tri[3 * v + 2] };
+      if (m)
+        {
+        TransformPoint(m, p, out[v]);
+        }
+      else
+        {
+        std::copy(p, p + 3, out[v]);
+        }
+      }
+    }
+
+  static void TriangleBounds(const double t[3][3], double min[3], double max[3])
+    {
+    for (int c = 0; c < 3; c++)
+      {
+      min[c] = std::min(t[0][c], std::min(t[1][c], t[2][c]));
+      max[c] = std::max(t[0][c], std::max(t[1][c], t[2][c]));
+      }
+    }
+
+  // Segment p0 p1 against triangle t (Moller-Trumbore), x is the hit point.
+  static bool IntersectSegment(const double p0[3], const double p1[3],
+                               const double t[3][3], double x[3])
+    {
+    double d[3], e1[3], e2[3], h[3], s[3], q[3];
+    for (int c = 0; c < 3; c++)
+      {
+      d[c] = p1[c] - p0[c];
+      e1[c] = t[1][c] - t[0][c];
+      e2[c] = t[2][c] - t[0][c];
+      s[c] = p0[c] - t[0][c];
+      }
+    Cross(d, e2, h);
+    double det = Dot(e1, h);
+    if (fabs(det) < 1.0e-14)
+      {
+      // Parallel or coplanar, not handled.
+      return false;
+      }
+    double inv = 1.0 / det;
+    double u = inv * Dot(s, h);
+    if (u < 0.0 || u > 1.0)
+      {
+      return false;
+      }
+    Cross(s, e1, q);
+    double v = inv * Dot(d, q);
+    if (v < 0.0 || u + v > 1.0)
+      {
+      return false;
+      }
+    double r = inv * Dot(e2, q);
+    if (r < 0.0 || r > 1.0)
+      {
+      return false;
+      }
+    for (int c = 0; c < 3; c++)
+      {
+      x[c] = p0[c] + r * d[c];
+      }
+    return true;
+    }
+
+  // Intersection segment of two triangles from the crossings of the edges
+  // of each triangle with the other one.
+  static bool IntersectTriangles(const double a[3][3], const double b[3][3],
+                                 double x0[3], double x1[3])
+    {
+    double hits[6][3];
+    int count = 0;
+    for (int e = 0; e < 3; e++)
+      {
+      if (IntersectSegment(a[e], a[(e + 1) % 3], b, hits[count]))
+        {
+        count++;
+        }
+      if (IntersectSegment(b[e], b[(e + 1) % 3], a, hits[count]))
+        {
+        count++;
+        }
+      }
+    if (count < 2)
+      {
+      return false;
+      }
+    // Take the two hits furthest apart; duplicates come from edges
+    // crossing exactly at a shared point.
+    double best = -1.0;
+    for (int i = 0; i < count; i++)
+      {
+      for (int j = i + 1; j < count; j++)
+        {
+        double d2 = 0.0;
+        for (int c = 0; c < 3; c++)
+          {
+          d2 += (hits[i][c] - hits[j][c]) * (hits[i][c] - hits[j][c]);
+          }
+        if (d2 > best)
+          {
+          best = d2;
+          std::copy(hits[i], hits[i] + 3, x0);
+          std::copy(hits[j], hits[j] + 3, x1);
+          }
+        }
+      }
+    return best > 0.0;
+    }
+
+  static void Cross(const double a[3], const double b[3], double c[3])
+    {
+    c[0] = a[1] * b[2] - a[2] * b[1];
+    c[1] = a[2] * b[0] - a[0] * b[2];
+    c[2] = a[0] * b[1] - a[1] * b[0];
+    }
+  static double Dot(const double a[3], const double b[3])
+    {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+  class AnimationCueObserver : public vtkCommand
+  {
+  public:
+    static AnimationCueObserver *New()
+      {
+      return new AnimationCueObserver;
+      }
+
+    virtual void Execute(vtkObject *vtkNotUsed(caller),
+                         unsigned long vtkNotUsed(event),
+                         void *vtkNotUsed(calldata))
+      {
+      if(this->Intersector != 0)
+        {
+        this->Intersector->Update();
+        }
+      }
+
+    AnimationCueObserver()
+      {
+      this->Intersector = 0;
+      }
+    MeshIntersector *Intersector;
+  };
+
+  AnimationCueObserver *          Observer;
+  vtkActor *                      Actors[2];
+  vtkPolyData *                   Meshes[2];
+  unsigned long                   MeshMTime[2];
+  MeshBVH                         Trees[2];
+  double                          Margin;
+  bool                            CacheValid;
+  bool                            ContactSetReused;
+  double                          CachedRelative[16];
+  // Actor matrices the output was computed for.
+  bool                            OutputValid;
+  double                          OutputMatrix[2][16];
+  std::vector<std::pair<int,int> > Candidates;
+  vtkSmartPointer<vtkPolyData>    Output;
+};
+
+#endif
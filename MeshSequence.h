@@ -0,0 +1,471 @@
+#ifndef __MeshSequence_h
+#define __MeshSequence_h
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+#include <vtkPLYReader.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataReader.h>
+#include <vtkSTLReader.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkXMLPolyDataReader.h>
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+
+// Plays a mesh sequence, one file per timestep, from a cue.
+// The cue time picks a timestep (see SetTimeSteps). A background thread
+// reads the timestep being shown and the next PrefetchCount ones in the
+// direction of playback, forward or reverse, each into a polydata of its
+// own. On the tick the timestep's polydata is shallow copied into the
+// output, so the render thread never reads a file: the worker fills the
+// back buffers, the tick swaps one to the front.
+// A timestep that is not read yet is a miss. By default the tick then
+// waits for the worker (the stall time is recorded), so every frame of a
+// sequence render shows the right mesh; with SetWaitForTimeSteps(false)
+// the output keeps the previous mesh instead, for real-time playback.
+// Timesteps behind the playhead or further ahead than PrefetchCount are
+// dropped on the next tick, so at most PrefetchCount + 1 meshes are held
+// besides the one shown.
+//
+// Files are read with the reader that matches their extension: .vtp,
+// .vtk (legacy polydata), .stl or .ply.
+class MeshSequencePlayer
+{
+public:
+  MeshSequencePlayer()
+    {
+    this->Output = vtkSmartPointer<vtkPolyData>::New();
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->PrefetchCount = 4;
+    this->WaitForTimeSteps = true;
+    this->Shown = -1;
+    this->Current = -1;
+    this->Direction = 1;
+    this->Generation = 0;
+    this->Done = false;
+    this->ResetStatistics();
+    }
+
+  ~MeshSequencePlayer()
+    {
+      {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Done = true;
+      }
+    this->WorkAvailable.notify_all();
+    if (this->Worker.joinable())
+      {
+      this->Worker.join();
+      }
+    this->Clear();
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // One file per timestep, in order. Drops everything read so far.
+  void SetFileNames(const std::vector<std::string> &fileNames)
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Clear();
+    this->FileNames = fileNames;
+    this->Generation++;
+    this->Current = -1;
+    this->Shown = -1;
+    }
+
+  // Files named by a printf pattern with one integer, e.g.
+  // "flow_%04d.vtp", from first up to the first number without a file.
+  // Returns the number of files found.
+  int SetFilePattern(const std::string &pattern, int first = 0)
+    {
+    std::vector<std::string> fileNames;
+    char name[4096];
+    for (int i = first; ; i++)
+      {
+      snprintf(name, sizeof(name), pattern.c_str(), i);
+      FILE *file = fopen(name, "rb");
+      if (!file)
+        {
+        break;
+        }
+      fclose(file);
+      fileNames.push_back(name);
+      }
+    this->SetFileNames(fileNames);
+    return static_cast<int>(fileNames.size());
+    }
+
+  int GetNumberOfTimeSteps() const
+    {
+    return static_cast<int>(this->FileNames.size());
+    }
+
+  // Time of each timestep, relative to the start of the cue and
+  // increasing; a timestep is shown from its time to the next one's.
+  // Without times the timesteps are spread evenly over the cue, the first
+  // at its start and the last at its end.
+  void SetTimeSteps(const std::vector<double> &times)
+    {
+    this->TimeSteps = times;
+    }
+
+  // Number of timesteps read ahead of the one shown.
+  void SetPrefetchCount(int count)
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->PrefetchCount = std::max(0, count);
+    }
+  int GetPrefetchCount() const { return this->PrefetchCount; }
+
+  void SetWaitForTimeSteps(bool wait) { this->WaitForTimeSteps = wait; }
+
+  // The polydata to render. Timesteps are shallow copied into it.
+  vtkPolyData *GetOutput() { return this->Output; }
+
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    }
+
+  // Timestep shown at time seconds into a cue lasting duration.
+  int GetTimeStep(double time, double duration) const
+    {
+    const int count = static_cast<int>(this->FileNames.size());
+    if (count == 0)
+      {
+      return -1;
+      }
+    int step;
+    if (this->TimeSteps.size() == this->FileNames.size())
+      {
+      step = static_cast<int>(std::upper_bound(this->TimeSteps.begin(), this->TimeSteps.end(), time) -
+                              this->TimeSteps.begin()) - 1;
+      }
+    else
+      {
+      double t = duration > 0 ? time / duration : 0.0;
+      step = static_cast<int>(t * (count - 1) + 0.5);
+      }
+    return std::max(0, std::min(count - 1, step));
+    }
+
+  // Shows a timestep; returns false if it is not available (still being
+  // read without waiting, or its file could not be read).
+  bool ShowTimeStep(int step)
+    {
+    if (step < 0 || step >= static_cast<int>(this->FileNames.size()))
+      {
+      return false;
+      }
+    vtkPolyData *data = 0;
+      {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      if (step != this->Current)
+        {
+        if (this->Current >= 0)
+          {
+          this->Direction = step > this->Current ? 1 : -1;
+          }
+        this->Current = step;
+        this->DropOutsideWindow();
+        this->WorkAvailable.notify_one();
+        }
+      if (!this->Worker.joinable())
+        {
+        this->Worker = std::thread(&MeshSequencePlayer::Work, this);
+        }
+      if (step == this->Shown)
+        {
+        return true;
+        }
+      std::map<int, vtkPolyData*>::iterator ready = this->Ready.find(step);
+      if (ready != this->Ready.end())
+        {
+        this->NumberOfHits++;
+        data = ready->second;
+        }
+      else if (this->Failed.count(step))
+        {
+        return false;
+        }
+      else
+        {
+        this->NumberOfMisses++;
+        if (!this->WaitForTimeSteps)
+          {
+          return false;
+          }
+        FRAME_PROFILE_SCOPE("MeshSequencePlayer stall");
+        double start = vtkTimerLog::GetUniversalTime();
+        this->TimeStepLoaded.wait(lock, [this, step]
+          {
+          return this->Ready.count(step) || this->Failed.count(step);
+          });
+        this->StallTime += vtkTimerLog::GetUniversalTime() - start;
+        if (!this->Ready.count(step))
+          {
+          return false;
+          }
+        data = this->Ready[step];
+        }
+      }
+    // Only this thread removes entries from Ready, so data stays valid.
+    this->Output->ShallowCopy(data);
+    this->Shown = step;
+    return true;
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *info)
+    {
+      {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Direction = 1;
+      }
+    this->ShowTimeStep(this->GetTimeStep(0.0, info->EndTime - info->StartTime));
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    FRAME_PROFILE_SCOPE("MeshSequencePlayer::Tick");
+    this->ShowTimeStep(this->GetTimeStep(info->AnimationTime - info->StartTime,
+                                         info->EndTime - info->StartTime));
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    double duration = info->EndTime - info->StartTime;
+    this->ShowTimeStep(this->GetTimeStep(duration, duration));
+    }
+
+  void ResetStatistics()
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->NumberOfHits = 0;
+    this->NumberOfMisses = 0;
+    this->NumberOfReads = 0;
+    this->NumberOfErrors = 0;
+    this->StallTime = 0;
+    this->ReadTime = 0;
+    }
+
+  // Timesteps that were read ahead when first shown.
+  unsigned long GetNumberOfHits() const   { return this->NumberOfHits; }
+  // Timesteps that were not, and were waited for (or skipped).
+  unsigned long GetNumberOfMisses() const { return this->NumberOfMisses; }
+  double GetHitRate() const
+    {
+    unsigned long total = this->NumberOfHits + this->NumberOfMisses;
+    return total ? static_cast<double>(this->NumberOfHits) / total : 0.0;
+    }
+  // Seconds the ticks spent waiting for the worker.
+  double GetStallTime() const             { return this->StallTime; }
+
+  void PrintStatistics(ostream &os)
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    os << "mesh sequence: " << this->FileNames.size() << " timesteps, prefetch "
+       << this->PrefetchCount << ", hits: " << this->NumberOfHits
+       << ", misses: " << this->NumberOfMisses << ", hit rate: " << this->GetHitRate()
+       << ", stalled: " << this->StallTime << " s" << endl;
+    os << "read: " << this->NumberOfReads << " files in " << this->ReadTime
+       << " s, errors: " << this->NumberOfErrors << endl;
+    }
+
+protected:
+  // Runs on the worker: reads a file with a reader of its own.
+  static vtkPolyData *Read(const std::string &fileName)
+    {
+    std::string extension;
+    size_t dot = fileName.find_last_of('.');
+    if (dot != std::string::npos)
+      {
+      extension = fileName.substr(dot + 1);
+      std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+      }
+    if (extension == "vtp")
+      {
+      return ReadWith<vtkXMLPolyDataReader>(fileName);
+      }
+    if (extension == "vtk")
+      {
+      return ReadWith<vtkPolyDataReader>(fileName);
+      }
+    if (extension == "stl")
+      {
+      return ReadWith<vtkSTLReader>(fileName);
+      }
+    if (extension == "ply")
+      {
+      return ReadWith<vtkPLYReader>(fileName);
+      }
+    return 0;
+    }
+
+  template <class Reader>
+  static vtkPolyData *ReadWith(const std::string &fileName)
+    {
+    vtkSmartPointer<Reader> reader = vtkSmartPointer<Reader>::New();
+    reader->SetFileName(fileName.c_str());
+    reader->Update();
+    if (!reader->GetOutput() || reader->GetOutput()->GetNumberOfPoints() == 0)
+      {
+      return 0;
+      }
+    vtkPolyData *data = vtkPolyData::New();
+    data->ShallowCopy(reader->GetOutput());
+    return data;
+    }
+
+  // Next timestep of the window the worker should read, or -1. Called
+  // with Mutex held.
+  int NextToRead() const
+    {
+    const int count = static_cast<int>(this->FileNames.size());
+    if (this->Current < 0)
+      {
+      return -1;
+      }
+    for (int k = 0; k <= this->PrefetchCount; k++)
+      {
+      int step = this->Current + k * this->Direction;
+      if (step < 0 || step >= count)
+        {
+        break;
+        }
+      if (!this->Ready.count(step) && !this->Failed.count(step))
+        {
+        return step;
+        }
+      }
+    return -1;
+    }
+
+  // Drops the timesteps outside the window, except the one shown. Called
+  // on the main thread with Mutex held.
+  void DropOutsideWindow()
+    {
+    std::map<int, vtkPolyData*>::iterator entry = this->Ready.begin();
+    while (entry != this->Ready.end())
+      {
+      int ahead = (entry->first - this->Current) * this->Direction;
+      if (entry->first != this->Shown && (ahead < 0 || ahead > this->PrefetchCount))
+        {
+        entry->second->Delete();
+        this->Ready.erase(entry++);
+        }
+      else
+        {
+        ++entry;
+        }
+      }
+    }
+
+  void Work()
+    {
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    for (;;)
+      {
+      int step;
+      this->WorkAvailable.wait(lock, [this, &step]
+        {
+        step = this->NextToRead();
+        return this->Done || step >= 0;
+        });
+      if (this->Done)
+        {
+        break;
+        }
+      std::string fileName = this->FileNames[step];
+      unsigned long generation = this->Generation;
+      lock.unlock();
+
+      double start = vtkTimerLog::GetUniversalTime();
+      vtkPolyData *data;
+        {
+        FRAME_PROFILE_SCOPE("MeshSequencePlayer read");
+        data = Read(fileName);
+        }
+      double elapsed = vtkTimerLog::GetUniversalTime() - start;
+
+      lock.lock();
+      if (generation != this->Generation)
+        {
+        // The file names changed while reading.
+        if (data)
+          {
+          data->Delete();
+          }
+        continue;
+        }
+      this->ReadTime += elapsed;
+      this->NumberOfReads++;
+      if (data)
+        {
+        this->Ready[step] = data;
+        }
+      else
+        {
+        this->Failed.insert(step);
+        this->NumberOfErrors++;
+        }
+      this->TimeStepLoaded.notify_all();
+      }
+    }
+
+  void Clear()
+    {
+    for (std::map<int, vtkPolyData*>::iterator entry = this->Ready.begin();
+         entry != this->Ready.end(); ++entry)
+      {
+      entry->second->Delete();
+      }
+    this->Ready.clear();
+    this->Failed.clear();
+    }
+
+  typedef AnimationCueAdapter<MeshSequencePlayer> AnimationCueObserver;
+
+  vtkSmartPointer<vtkPolyData>  Output;
+  AnimationCueObserver *        Observer;
+  std::vector<double>           TimeSteps;
+  bool                          WaitForTimeSteps;
+  int                           Shown;
+  unsigned long                 NumberOfHits;
+  unsigned long                 NumberOfMisses;
+  double                        StallTime;
+
+  // Shared with the worker, guarded by Mutex.
+  std::thread                   Worker;
+  std::mutex                    Mutex;
+  std::condition_variable       WorkAvailable;
+  std::condition_variable       TimeStepLoaded;
+  std::vector<std::string>      FileNames;
+  int                           PrefetchCount;
+  int                           Current;
+  int                           Direction;
+  unsigned long                 Generation;
+  bool                          Done;
+  std::map<int, vtkPolyData*>   Ready;
+  std::set<int>                 Failed;
+  unsigned long                 NumberOfReads;
+  unsigned long                 NumberOfErrors;
+  double                        ReadTime;
+};
+
+#endif
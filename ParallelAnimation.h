@@ -0,0 +1,137 @@
+#ifndef __ParallelAnimation_h
+#define __ParallelAnimation_h
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+#include <vector>
+
+#include "Animation.h"
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+#include "RenderScheduler.h"
+#include "WorkStealingPool.h"
+
+// Ticks a set of ActorAnimators from one cue in two phases. First every
+// animator evaluates its new state into its own buffer, spread over a
+// WorkStealingPool; then, back on the main thread, each state is committed
+// to its actor in the order the animators were added, and one render is
+// requested. Since the evaluation reads nothing but the animator's own
+// tracks and positions and the commits are done serially in a fixed
+// order, the actors end up exactly as if each animator had ticked itself.
+//
+// The animators must not also be added to the cue themselves.
+class ParallelActorAnimator
+{
+public:
+  ParallelActorAnimator()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->Pool = 0;
+    this->Scheduler = 0;
+    this->GrainSize = 16;
+    }
+
+  ~ParallelActorAnimator()
+    {
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // The animators are not owned.
+  void AddAnimator(ActorAnimator *animator)
+    {
+    this->Animators.push_back(animator);
+    }
+  void RemoveAllAnimators()
+    {
+    this->Animators.clear();
+    }
+  size_t GetNumberOfAnimators() const
+    {
+    return this->Animators.size();
+    }
+
+  // Without a pool the animators are evaluated on the calling thread.
+  void SetPool(WorkStealingPool *pool) { this->Pool = pool; }
+
+  // Number of animators evaluated per task; smaller grains balance better
+  // when animators differ in cost, larger ones cost less in queueing.
+  void SetGrainSize(size_t grain) { this->GrainSize = grain ? grain : 1; }
+
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    for (size_t a = 0; a < this->Animators.size(); a++)
+      {
+      this->Animators[a]->Start(info);
+      }
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    ActorAnimator **animators = this->Animators.empty() ? 0 : &this->Animators[0];
+      {
+      FRAME_PROFILE_SCOPE("ParallelActorAnimator Evaluate");
+      if (this->Pool)
+        {
+        this->Pool->ParallelFor(this->Animators.size(), this->GrainSize,
+          [animators, info](size_t begin, size_t end)
+            {
+            FRAME_PROFILE_SCOPE("ParallelActorAnimator Evaluate chunk");
+            for (size_t a = begin; a < end; a++)
+              {
+              animators[a]->Evaluate(info);
+              }
+            });
+        }
+      else
+        {
+        for (size_t a = 0; a < this->Animators.size(); a++)
+          {
+          animators[a]->Evaluate(info);
+          }
+        }
+      }
+      {
+      FRAME_PROFILE_SCOPE("ParallelActorAnimator Commit");
+      for (size_t a = 0; a < this->Animators.size(); a++)
+        {
+        animators[a]->Commit();
+        }
+      }
+    if (this->Scheduler)
+      {
+      this->Scheduler->RequestRender();
+      }
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    for (size_t a = 0; a < this->Animators.size(); a++)
+      {
+      this->Animators[a]->End(info);
+      }
+    }
+
+protected:
+  typedef AnimationCueAdapter<ParallelActorAnimator> AnimationCueObserver;
+
+  AnimationCueObserver *       Observer;
+  WorkStealingPool *           Pool;
+  RenderScheduler *            Scheduler;
+  std::vector<ActorAnimator*>  Animators;
+  size_t                       GrainSize;
+};
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef __Picking_h
+#define __Picking_h
+#include <vtkActor.h>
+#include <vtkMapper.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "FrameProfiler.h"
+#include "MeshIntersection.h"
+
+// Picks the closest actor cell along a ray, for hover and click picking in
+// scenes with many moving actors. A replacement for vtkCellPicker on
+// actors whose mapper input is a vtkPolyData.
+//
+// Each distinct mesh gets one MeshBVH in model coordinates, shared by all
+// the actors drawing it. Moving an actor never touches the hierarchy:
+// the ray is brought into the actor's model space with the inverse of the
+// actor's matrix instead, which for an affine matrix keeps the parameter
+// along the ray, so hits on different actors compare directly.
+//
+// Nothing is rebuilt when things change, only on the next pick and only
+// as far as that pick needs: an actor whose MTime changed gets its world
+// box and inverse matrix recomputed, a mesh whose MTime changed gets its
+// bounds refreshed, and its hierarchy is rebuilt only when a ray actually
+// reaches one of its actors. The ray is tested against the world boxes of
+// all actors first and the candidates are visited nearest box first,
+// stopping as soon as the next box starts beyond the closest hit.
+class ActorPicker
+{
+public:
+  struct Hit
+    {
+    vtkActor * Actor;
+    int        ActorId;
+    vtkIdType  CellId;
+    // Parameter along the ray, 0 at p1 and 1 at p2.
+    double     T;
+    double     WorldPoint[3];
+    double     ModelPoint[3];
+    };
+
+  ActorPicker()
+    {
+    this->Tolerance = 0.0;
+    this->NumberOfBuilds = 0;
+    }
+
+  ~ActorPicker()
+    {
+    this->RemoveAllActors();
+    }
+
+  // Registers an actor and returns its id. Without mesh the mapper's input
+  // is used; actors drawing the same mesh share its hierarchy.
+  int AddActor(vtkActor *actor, vtkPolyData *mesh = 0)
+    {
+    if (!mesh && actor->GetMapper())
+      {
+      mesh = vtkPolyData::SafeDownCast(actor->GetMapper()->GetInput());
+      }
+    if (!mesh)
+      {
+      return -1;
+      }
+    std::unordered_map<vtkPolyData*, int>::iterator found = this->MeshIndex.find(mesh);
+    int meshIndex;
+    if (found == this->MeshIndex.end())
+      {
+      mesh->Register(0);
+      meshIndex = static_cast<int>(this->Meshes.size());
+      this->Meshes.push_back(new Mesh(mesh));
+      this->MeshIndex[mesh] = meshIndex;
+      }
+    else
+      {
+      meshIndex = found->second;
+      }
+
+    int id = static_cast<int>(this->Actors.size());
+    actor->Register(0);
+    this->Actors.push_back(actor);
+    this->ActorMesh.push_back(meshIndex);
+    this->ActorMTime.push_back(0);
+    this->ActorMeshGeneration.push_back(0);
+    this->Inverse.insert(this->Inverse.end(), 16, 0.0);
+    for (int c = 0; c < 3; c++)
+      {
+      this->Min[c].push_back(0.0);
+      this->Max[c].push_back(0.0);
+      }
+    return id;
+    }
+
+  void RemoveAllActors()
+    {
+    for (size_t i = 0; i < this->Actors.size(); i++)
+      {
+      this->Actors[i]->UnRegister(0);
+      }
+    for (size_t m = 0; m < this->Meshes.size(); m++)
+      {
+      this->Meshes[m]->Data->UnRegister(0);
+      delete this->Meshes[m];
+      }
+    this->Actors.clear();
+    this->ActorMesh.clear();
+    this->ActorMTime.clear();
+    this->ActorMeshGeneration.clear();
+    this->Inverse.clear();
+    for (int c = 0; c < 3; c++)
+      {
+      this->Min[c].clear();
+      this->Max[c].clear();
+      }
+    this->Meshes.clear();
+    this->MeshIndex.clear();
+    }
+
+  int GetNumberOfActors() const    { return static_cast<int>(this->Actors.size()); }
+  vtkActor *GetActor(int id) const { return this->Actors[id]; }
+  int GetNumberOfMeshes() const    { return static_cast<int>(this->Meshes.size()); }
+  // Hierarchies built so far, for checking that the cache is used.
+  int GetNumberOfBuilds() const    { return this->NumberOfBuilds; }
+
+  // Hits slightly outside of a triangle are accepted, in parametric
+  // coordinates of the triangle, as in BatchRayIntersector.
+  void SetTolerance(double tolerance) { this->Tolerance = tolerance; }
+  double GetTolerance() const         { return this->Tolerance; }
+
+  // Closest hit on the world segment p1 -> p2 among the visible, pickable
+  // actors. Returns false when nothing is hit.
+  bool Pick(const double p1[3], const double p2[3], Hit &hit)
+    {
+    FRAME_PROFILE_SCOPE("ActorPicker::Pick");
+    this->Refresh();
+
+    double direction[3], inverse[3];
+    for (int c = 0; c < 3; c++)
+      {
+      direction[c] = p2[c] - p1[c];
+      inverse[c] = fabs(direction[c]) > 1.0e-300 ? 1.0 / direction[c] :
+        (direction[c] < 0 ? -1.0e300 : 1.0e300);
+      }
+
+    // Broad phase: slab test of every world box, grown for the tolerance
+    // as the hierarchy boxes are.
+    this->Candidates.clear();
+    const size_t n = this->Actors.size();
+    for (size_t a = 0; a < n; a++)
+      {
+      if (this->Min[0][a] > this->Max[0][a])
+        {
+        continue;
+        }
+      double min[3], max[3], low[3], high[3];
+      for (int c = 0; c < 3; c++)
+        {
+        min[c] = this->Min[c][a];
+        max[c] = this->Max[c][a];
+        }
+      MeshBVH::GrowBox(min, max, this->Tolerance, low, high);
+      double entry = MeshBVH::EnterBox(low, high, p1, inverse, 1.0);
+      if (entry != DBL_MAX)
+        {
+        this->Candidates.push_back(std::make_pair(entry, static_cast<int>(a)));
+        }
+      }
+    std::sort(this->Candidates.begin(), this->Candidates.end());
+
+    hit.Actor = 0;
+    hit.ActorId = -1;
+    hit.CellId = -1;
+    hit.T = 1.0;
+    int triangle = -1;
+    for (size_t i = 0; i < this->Candidates.size() && this->Candidates[i].first <= hit.T; i++)
+      {
+      int a = this->Candidates[i].second;
+      vtkActor *actor = this->Actors[a];
+      if (!actor->GetVisibility() || !actor->GetPickable())
+        {
+        continue;
+        }
+      Mesh *mesh = this->Meshes[this->ActorMesh[a]];
+      if (mesh->TreeMTime != mesh->Data->GetMTime())
+        {
+        mesh->Tree.Build(mesh->Data);
+        mesh->TreeMTime = mesh->Data->GetMTime();
+        this->NumberOfBuilds++;
+        }
+      if (mesh->Tree.IsEmpty())
+        {
+        continue;
+        }
+      const double *m = &this->Inverse[16 * a];
+      double origin[3], modelDirection[3];
+      TransformPoint(m, p1, origin);
+      for (int r = 0; r < 3; r++)
+        {
+        modelDirection[r] = m[4 * r] * direction[0] + m[4 * r + 1] * direction[1] +
+          m[4 * r + 2] * direction[2];
+        }
+      double t = hit.T;
+      int found = mesh->Tree.IntersectRay(origin, modelDirection, this->Tolerance, t);
+      if (found >= 0)
+        {
+        hit.T = t;
+        hit.ActorId = a;
+        triangle = found;
+        hit.CellId = mesh->Tree.GetCellId(found);
+        for (int c = 0; c < 3; c++)
+          {
+          hit.ModelPoint[c] = origin[c] + t * modelDirection[c];
+          }
+        }
+      }
+    if (triangle < 0)
+      {
+      hit.T = -1.0;
+      return false;
+      }
+    hit.Actor = this->Actors[hit.ActorId];
+    for (int c = 0; c < 3; c++)
+      {
+      hit.WorldPoint[c] = p1[c] + hit.T * direction[c];
+      }
+    return true;
+    }
+
+  // Picks along the line of sight through display position (x, y) of the
+  // renderer, between the near and far clipping planes, as vtkCellPicker
+  // does.
+  bool Pick(double x, double y, vtkRenderer *renderer, Hit &hit)
+    {
+    double p[2][3];
+    for (int i = 0; i < 2; i++)
+      {
+      double world[4];
+      renderer->SetDisplayPoint(x, y, i);
+      renderer->DisplayToWorld();
+      renderer->GetWorldPoint(world);
+      for (int c = 0; c < 3; c++)
+        {
+        p[i][c] = world[3] != 0.0 ? world[c] / world[3] : world[c];
+        }
+      }
+    return this->Pick(p[0], p[1], hit);
+    }
+
+protected:
+  struct Mesh
+    {
+    Mesh(vtkPolyData *data) : Data(data), TreeMTime(0), BoundsMTime(0), Generation(0) {}
+    vtkPolyData * Data;
+    MeshBVH       Tree;
+    unsigned long TreeMTime;
+    unsigned long BoundsMTime;
+    // Bumped whenever the bounds are refreshed, so the actors drawing the
+    // mesh recompute their world boxes.
+    unsigned long Generation;
+    double        Bounds[6];
+    };
+
+  // Brings the mesh bounds and the actor boxes and inverses up to date.
+  void Refresh()
+    {
+    for (size_t m = 0; m < this->Meshes.size(); m++)
+      {
+      Mesh *mesh = this->Meshes[m];
+      unsigned long mtime = mesh->Data->GetMTime();
+      if (mtime != mesh->BoundsMTime)
+        {
+        mesh->Data->GetBounds(mesh->Bounds);
+        mesh->BoundsMTime = mtime;
+        mesh->Generation++;
+        }
+      }
+    double matrix[16];
+    for (size_t a = 0; a < this->Actors.size(); a++)
+      {
+      vtkActor *actor = this->Actors[a];
+      const Mesh *mesh = this->Meshes[this->ActorMesh[a]];
+      unsigned long mtime = actor->GetMTime();
+      if (mtime == this->ActorMTime[a] && mesh->Generation == this->ActorMeshGeneration[a])
+        {
+        continue;
+        }
+      this->ActorMTime[a] = mtime;
+      this->ActorMeshGeneration[a] = mesh->Generation;
+      actor->GetMatrix(matrix);
+      InvertAffine(matrix, &this->Inverse[16 * a]);
+      const double *b = mesh->Bounds;
+      if (b[0] > b[1])
+        {
+        // Empty mesh: an inverted box, which the slab test would still
+        // pass, so Pick skips it explicitly.
+        for (int c = 0; c < 3; c++)
+          {
+          this->Min[c][a] = DBL_MAX;
+          this->Max[c][a] = -DBL_MAX;
+          }
+        continue;
+        }
+      double center[3], half[3], moved[3];
+      for (int c = 0; c < 3; c++)
+        {
+        center[c] = 0.5 * (b[2 * c] + b[2 * c + 1]);
+        half[c] = 0.5 * (b[2 * c + 1] - b[2 * c]);
+        }
+      TransformPoint(matrix, center, moved);
+      for (int r = 0; r < 3; r++)
+        {
+        double extent = fabs(matrix[4 * r]) * half[0] + fabs(matrix[4 * r + 1]) * half[1] +
+          fabs(matrix[4 * r + 2]) * half[2];
+        this->Min[r][a] = moved[r] - extent;
+        this->Max[r][a] = moved[r] + extent;
+        }
+      }
+    }
+
+  static void TransformPoint(const double m[16], const double p[3], double out[3])
+    {
+    for (int r = 0; r < 3; r++)
+      {
+      out[r] = m[4 * r] * p[0] + m[4 * r + 1] * p[1] + m[4 * r + 2] * p[2] + m[4 * r + 3];
+      }
+    }
+
+  // Inverse of a matrix whose last row is 0 0 0 1. A singular matrix (an
+  // actor scaled to nothing) gives zeros, which no ray hits.
+  static void InvertAffine(const double m[16], double out[16])
+    {
+    double c[9] = { m[5] * m[10] - m[6] * m[9], m[2] * m[9] - m[1] * m[10], m[1] * m[6] - m[2] * m[5],
+                    m[6] * m[8] - m[4] * m[10], m[0] * m[10] - m[2] * m[8], m[2] * m[4] - m[0] * m[6],
+                    m[4] * m[9] - m[5] * m[8], m[1] * m[8] - m[0] * m[9], m[0] * m[5] - m[1] * m[4] };
+    double det = m[0] * c[0] + m[1] * c[3] + m[2] * c[6];
+    double inv = fabs(det) > 1.0e-300 ? 1.0 / det : 0.0;
+    for (int r = 0; r < 3; r++)
+      {
+      for (int k = 0; k < 3; k++)
+        {
+        out[4 * r + k] = c[3 * r + k] * inv;
+        }
+      out[4 * r + 3] = -(out[4 * r] * m[3] + out[4 * r + 1] * m[7] + out[4 * r + 2] * m[11]);
+      }
+    out[12] = out[13] = out[14] = 0.0;
+    out[15] = 1.0;
+    }
+
+  std::vector<vtkActor*>                        Actors;
+  std::vector<int>                              ActorMesh;
+  std::vector<unsigned long>                    ActorMTime;
+  std::vector<unsigned long>                    ActorMeshGeneration;
+  std::vector<double>                           Inverse;
+  std::vector<double>                           Min[3];
+  std::vector<double>                           Max[3];
+  std::vector<Mesh*>                            Meshes;
+  std::unordered_map<vtkPolyData*, int>         MeshIndex;
+  std::vector<std::pair<double, int> >          Candidates;
+  double                                        Tolerance;
+  int                                           NumberOfBuilds;
+};
+
+#endif
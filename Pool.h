@@ -0,0 +1,115 @@
+#ifndef __Pool_h
+#define __Pool_h
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Fixed-size blocks for objects of type T, carved out of chunks of
+// ChunkSize blocks and recycled through an intrusive free list, so
+// Allocate and Free are a pointer pop and push. The global heap is only
+// touched when the free list runs dry and a new chunk is added; Reserve
+// adds them up front. Chunks are released with the pool, so every block
+// must be freed before then. Not thread safe.
+//
+// Classes use it through their own operator new and delete:
+//
+//   static void *operator new(size_t) { return GetPool().Allocate(); }
+//   static void operator delete(void *p) { GetPool().Free(p); }
+template <class T>
+class ObjectPool
+{
+public:
+  ObjectPool(size_t chunkSize = 256)
+    {
+    this->FreeList = 0;
+    this->ChunkSize = chunkSize ? chunkSize : 1;
+    this->Capacity = 0;
+    this->NumberInUse = 0;
+    }
+
+  ~ObjectPool()
+    {
+    for (size_t i = 0; i < this->Chunks.size(); i++)
+      {
+      delete [] this->Chunks[i];
+      }
+    }
+
+  void *Allocate()
+    {
+    if (!this->FreeList)
+      {
+      this->AddChunk(this->ChunkSize);
+      }
+    Block *block = this->FreeList;
+    this->FreeList = block->Next;
+    this->NumberInUse++;
+    return block;
+    }
+
+  void Free(void *pointer)
+    {
+    if (!pointer)
+      {
+      return;
+      }
+    Block *block = static_cast<Block*>(pointer);
+    block->Next = this->FreeList;
+    this->FreeList = block;
+    this->NumberInUse--;
+    }
+
+  // Makes sure count more objects can be allocated without growing.
+  void Reserve(size_t count)
+    {
+    size_t available = this->GetCapacity() - this->NumberInUse;
+    if (count > available)
+      {
+      this->AddChunk(count - available > this->ChunkSize ? count - available : this->ChunkSize);
+      }
+    }
+
+  size_t GetCapacity() const
+    {
+    return this->Capacity;
+    }
+  size_t GetNumberInUse() const
+    {
+    return this->NumberInUse;
+    }
+  size_t GetNumberOfChunks() const
+    {
+    return this->Chunks.size();
+    }
+
+private:
+  ObjectPool(const ObjectPool&);  // Not implemented.
+  void operator=(const ObjectPool&);  // Not implemented.
+
+  union Block
+    {
+    Block *Next;
+    typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type Storage;
+    };
+
+  void AddChunk(size_t count)
+    {
+    Block *chunk = new Block[count];
+    this->Chunks.push_back(chunk);
+    // Thread the new blocks in address order ahead of the free ones.
+    for (size_t i = count; i-- > 0;)
+      {
+      chunk[i].Next = this->FreeList;
+      this->FreeList = &chunk[i];
+      }
+    this->Capacity += count;
+    }
+
+  Block *              FreeList;
+  std::vector<Block*>  Chunks;
+  size_t               ChunkSize;
+  size_t               Capacity;
+  size_t               NumberInUse;
+};
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef __RayIntersection_h
+#define __RayIntersection_h
+#include <vtkPolyData.h>
+
+#include "MeshIntersection.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Intersects many segments with one vtkPolyData at once; the batch
+// counterpart of calling vtkCell::IntersectWithLine for every segment and
+// every cell.
+// The polygons are put in a MeshBVH once. Segments are sorted into
+// coherent groups and processed in packets of PacketSize: a packet walks
+// the hierarchy once with MeshBVH::Traverse, each node box and each
+// triangle is tested against all segments of the packet in one loop over
+// fixed-size lane arrays, and a node is skipped only when every segment of
+// the packet misses it. Packets are spread over NumberOfThreads threads.
+// For each segment the closest hit is returned: t in [0, 1] along p1 -> p2,
+// the hit point and the id of the cell, or t = -1 and cell id -1 when the
+// segment hits nothing.
+class BatchRayIntersector
+{
+public:
+  enum { PacketSize = 8 };
+
+  BatchRayIntersector()
+    {
+    this->Tolerance = 0.0;
+    this->SortSegments = true;
+    this->NumberOfThreads = std::thread::hardware_concurrency();
+    if (this->NumberOfThreads < 1)
+      {
+      this->NumberOfThreads = 1;
+      }
+    this->Input = 0;
+    this->InputMTime = 0;
+    }
+
+  void SetInput(vtkPolyData *input)
+    {
+    this->Input = input;
+    this->InputMTime = 0;
+    }
+
+  // Hits slightly outside of a triangle are accepted, as with the
+  // tolerance of IntersectWithLine. Measured in parametric coordinates of
+  // the triangle.
+  void SetTolerance(double tolerance) { this->Tolerance = tolerance; }
+  double GetTolerance() const         { return this->Tolerance; }
+
+  // Segments are regrouped into coherent packets before tracing (see
+  // OrderSegments). Turn off when the caller already passes them in a
+  // coherent order, e.g. scanlines of a sensor or camera.
+  void SetSortSegments(bool sort) { this->SortSegments = sort; }
+  bool GetSortSegments() const    { return this->SortSegments; }
+
+  void SetNumberOfThreads(int threads) { this->NumberOfThreads = threads > 0 ? threads : 1; }
+  int GetNumberOfThreads() const       { return this->NumberOfThreads; }
+
+  // Rebuilds the hierarchy if the input was modified. Called by
+  // IntersectSegments; call it beforehand to keep the build out of timings.
+  void Update()
+    {
+    if (this->Input && this->Input->GetMTime() != this->InputMTime)
+      {
+      this->Tree.Build(this->Input);
+      this->InputMTime = this->Input->GetMTime();
+      }
+    }
+
+  // p1, p2 and x hold 3 * count values, t and cellIds count values.
+  // x may be null when the points are not needed.
+  void IntersectSegments(vtkIdType count, const double *p1, const double *p2,
+                         double *t, double *x, vtkIdType *cellIds)
+    {
+    this->Update();
+    this->OrderSegments(count, p1, p2);
+    vtkIdType packets = (count + PacketSize - 1) / PacketSize;
+    int threads = static_cast<int>(std::min<vtkIdType>(this->NumberOfThreads, packets));
+    if (threads <= 1)
+      {
+      this->IntersectRange(0, count, p1, p2, t, x, cellIds);
+      return;
+      }
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++)
+      {
+      vtkIdType begin = packets * i / threads * PacketSize;
+      vtkIdType end = std::min(count, packets * (i + 1) / threads * PacketSize);
+      workers.push_back(std::thread(&BatchRayIntersector::IntersectRange, this,
+                                    begin, end, p1, p2, t, x, cellIds));
+      }
+    for (int i = 0; i < threads; i++)
+      {
+      workers[i].join();
+      }
+    }
+
+protected:
+  struct Packet
+    {
+    double Origin[3][PacketSize];
+    double Direction[3][PacketSize];
+    double InverseDirection[3][PacketSize];
+    double T[PacketSize];
+    int    Triangle[PacketSize];
+    };
+
+  // Orders the segments so that a packet holds segments pointing the same
+  // way from nearby origins: sorted by direction octant, then along a
+  // Morton curve through the box of the origins. Segments of one packet
+  // then visit mostly the same nodes.
+  void OrderSegments(vtkIdType count, const double *p1, const double *p2)
+    {
+    this->Order.resize(count);
+    if (!this->SortSegments)
+      {
+      for (vtkIdType i = 0; i < count; i++)
+        {
+        this->Order[i] = i;
+        }
+      return;
+      }
+    double low[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+    double high[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    for (vtkIdType i = 0; i < count; i++)
+      {
+      for (int c = 0; c < 3; c++)
+        {
+        low[c] = std::min(low[c], p1[3 * i + c]);
+        high[c] = std::max(high[c], p1[3 * i + c]);
+        }
+      }
+    double scale[3];
+    for (int c = 0; c < 3; c++)
+      {
+      scale[c] = high[c] > low[c] ? 1023.0 / (high[c] - low[c]) : 0.0;
+      }
+    this->Keys.resize(count);
+    for (vtkIdType i = 0; i < count; i++)
+      {
+      unsigned long long key = 0;
+      for (int c = 0; c < 3; c++)
+        {
+        unsigned int cell = static_cast<unsigned int>((p1[3 * i + c] - low[c]) * scale[c]);
+        for (int b = 0; b < 10; b++)
+          {
+          key |= static_cast<unsigned long long>((cell >> b) & 1) << (3 * b + c);
+          }
+        if (p2[3 * i + c] < p1[3 * i + c])
+          {
+          key |= 1ULL << (30 + c);
+          }
+        }
+      this->Keys[i] = std::make_pair(key, i);
+      }
+    std::sort(this->Keys.begin(), this->Keys.end());
+    for (vtkIdType i = 0; i < count; i++)
+      {
+      this->Order[i] = this->Keys[i].second;
+      }
+    }
+
+  void IntersectRange(vtkIdType begin, vtkIdType end, const double *p1, const double *p2,
+                      double *t, double *x, vtkIdType *cellIds)
+    {
+    Packet packet;
+    for (vtkIdType first = begin; first < end; first += PacketSize)
+      {
+      int lanes = static_cast<int>(std::min<vtkIdType>(PacketSize, end - first));
+      for (int l = 0; l < PacketSize; l++)
+        {
+        // Unused lanes repeat the first segment, their results are dropped.
+        vtkIdType s = this->Order[first + (l < lanes ? l : 0)];
+        for (int c = 0; c < 3; c++)
+          {
+          double d = p2[3 * s + c] - p1[3 * s + c];
+          packet.Origin[c][l] = p1[3 * s + c];
+          packet.Direction[c][l] = d;
+          packet.InverseDirection[c][l] = fabs(d) > 1.0e-300 ? 1.0 / d : (d < 0 ? -1.0e300 : 1.0e300);
+          }
+        packet.T[l] = 1.0;
+        packet.Triangle[l] = -1;
+        }
+
+      PacketQuery query(this->Tree, packet, this->Tolerance);
+      this->Tree.Traverse(query);
+
+      for (int l = 0; l < lanes; l++)
+        {
+        vtkIdType s = this->Order[first + l];
+        bool hit = packet.Triangle[l] >= 0;
+        t[s] = hit ? packet.T[l] : -1.0;
+        cellIds[s] = hit ? this->Tree.GetCellId(packet.Triangle[l]) : -1;
+        if (x)
+          {
+          for (int c = 0; c < 3; c++)
+            {
+            x[3 * s + c] = hit ? packet.Origin[c][l] + packet.T[l] * packet.Direction[c][l] : 0.0;
+            }
+          }
+        }
+      }
+    }
+
+  // MeshBVH query testing every lane of a packet: a node is entered when
+  // one lane reaches its box before that lane's closest hit.
+  struct PacketQuery
+    {
+    // Ordering the children would cost two more tests of all lanes per
+    // node.
+    enum { NearestFirst = 0 };
+
+    PacketQuery(const MeshBVH &tree, Packet &packet, double tolerance)
+      : Tree(tree), Rays(packet), Tolerance(tolerance) {}
+
+    double EnterBox(const MeshBVH::Node &node) const
+      {
+      double low[3], high[3];
+      MeshBVH::GrowBox(node.Min, node.Max, this->Tolerance, low, high);
+      double entry = DBL_MAX;
+      for (int l = 0; l < PacketSize; l++)
+        {
+        entry = std::min(entry, MeshBVH::EnterBox(low, high, &this->Rays.Origin[0][l],
+                                                  &this->Rays.InverseDirection[0][l],
+                                                  this->Rays.T[l], PacketSize));
+        }
+      return entry;
+      }
+
+    void IntersectTriangle(int triangle)
+      {
+      const float *v = this->Tree.GetTriangle(triangle);
+      for (int l = 0; l < PacketSize; l++)
+        {
+        bool hit = MeshBVH::IntersectTriangle(v, &this->Rays.Origin[0][l], &this->Rays.Direction[0][l],
+                                              this->Tolerance, this->Rays.T[l], PacketSize);
+        this->Rays.Triangle[l] = hit ? triangle : this->Rays.Triangle[l];
+        }
+      }
+
+    const MeshBVH & Tree;
+    Packet &        Rays;
+    double          Tolerance;
+    };
+
+  std::vector<std::pair<unsigned long long, vtkIdType> > Keys;
+  std::vector<vtkIdType> Order;
+  vtkPolyData * Input;
+  unsigned long InputMTime;
+  MeshBVH       Tree;
+  double        Tolerance;
+  bool          SortSegments;
+  int           NumberOfThreads;
+};
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef __RenderScheduler_h
+#define __RenderScheduler_h
+#include <vtkActor.h>
+#include <vtkAlgorithm.h>
+#include <vtkMapper.h>
+#include <vtkRenderWindow.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "FrameProfiler.h"
+
+// Collects render requests made during one scene tick and renders at most
+// once when the tick is over.
+// Animators call RequestRender() from their cue ticks; the
+// AnimationSceneObserver calls Flush() once the scene has ticked all of its
+// cues. Flush() renders only if one of the watched objects (actor transform
+// and property, mapper, mapper input) was modified since the last render.
+// When nothing is watched a pending request is enough to render.
+class RenderScheduler
+{
+public:
+  RenderScheduler()
+    {
+    this->RenderWindow = 0;
+    this->Pending = false;
+    this->LastRenderMTime = 0;
+    this->ResetCounters();
+    }
+
+  ~RenderScheduler()
+    {
+    this->RemoveAllWatches();
+    if (this->RenderWindow)
+      {
+      this->RenderWindow->UnRegister(0);
+      this->RenderWindow = 0;
+      }
+    }
+
+  void SetRenderWindow(vtkRenderWindow *renWin)
+    {
+    if (this->RenderWindow)
+      {
+      this->RenderWindow->UnRegister(0);
+      }
+    this->RenderWindow = renWin;
+    if (this->RenderWindow)
+      {
+      this->RenderWindow->Register(0);
+      }
+    }
+
+  // Any object whose modification should cause a render.
+  void Watch(vtkObject *object)
+    {
+    if (!object ||
+        std::find(this->Watched.begin(), this->Watched.end(), object) != this->Watched.end())
+      {
+      return;
+      }
+    object->Register(0);
+    this->Watched.push_back(object);
+    }
+
+  // Watches the actor (its transform and property), its mapper and the
+  // algorithm feeding the mapper.
+  void WatchActor(vtkActor *actor)
+    {
+    this->Watch(actor);
+    vtkMapper *mapper = actor->GetMapper();
+    if (mapper)
+      {
+      this->Watch(mapper);
+      if (mapper->GetNumberOfInputConnections(0))
+        {
+        this->Watch(mapper->GetInputAlgorithm());
+        }
+      }
+    }
+
+  void RemoveAllWatches()
+    {
+    for (size_t i = 0; i < this->Watched.size(); i++)
+      {
+      this->Watched[i]->UnRegister(0);
+      }
+    this->Watched.clear();
+    }
+
+  void RequestRender()
+    {
+    this->NumberOfRendersRequested++;
+    if (this->Pending)
+      {
+      this->NumberOfRendersCoalesced++;
+      }
+    this->Pending = true;
+    }
+
+  // True when a watched object changed since the last render.
+  bool IsModified()
+    {
+    if (this->Watched.empty())
+      {
+      return this->Pending;
+      }
+    return this->GetWatchedMTime() > this->LastRenderMTime;
+    }
+
+  // Called once per frame. Renders if something changed, returns true if
+  // it did.
+  bool Flush()
+    {
+    bool render = this->RenderWindow && this->IsModified();
+    this->Pending = false;
+    if (!render)
+      {
+      this->NumberOfRendersSkipped++;
+      return false;
+      }
+      {
+      FRAME_PROFILE_SCOPE("RenderScheduler Render");
+      this->RenderWindow->Render();
+      }
+    // Rendering brings the pipeline up to date, which can itself bump
+    // modification times; only changes after this point count.
+    this->LastRenderMTime = this->GetWatchedMTime();
+    this->NumberOfRenders++;
+    return true;
+    }
+
+  void ResetCounters()
+    {
+    this->NumberOfRendersRequested = 0;
+    this->NumberOfRendersCoalesced = 0;
+    this->NumberOfRendersSkipped = 0;
+    this->NumberOfRenders = 0;
+    }
+
+  // RequestRender() calls.
+  unsigned long GetNumberOfRendersRequested() const { return this->NumberOfRendersRequested; }
+  // Requests merged into a render that was already pending.
+  unsigned long GetNumberOfRendersCoalesced() const { return this->NumberOfRendersCoalesced; }
+  // Frames that did not render because nothing changed.
+  unsigned long GetNumberOfRendersSkipped() const   { return this->NumberOfRendersSkipped; }
+  // Renders actually issued.
+  unsigned long GetNumberOfRenders() const          { return this->NumberOfRenders; }
+
+protected:
+  unsigned long GetWatchedMTime()
+    {
+    unsigned long mtime = 0;
+    for (size_t i = 0; i < this->Watched.size(); i++)
+      {
+      mtime = std::max(mtime, this->Watched[i]->GetMTime());
+      }
+    return mtime;
+    }
+
+  vtkRenderWindow *        RenderWindow;
+  std::vector<vtkObject*>  Watched;
+  bool                     Pending;
+  unsigned long            LastRenderMTime;
+  unsigned long            NumberOfRendersRequested;
+  unsigned long            NumberOfRendersCoalesced;
+  unsigned long            NumberOfRendersSkipped;
+  unsigned long            NumberOfRenders;
+};
+
+#endif
@@ -22,11 +22,27 @@
 #include <vtkSliderRepresentation3D.h>
 #include <vtkImageTracerWidget.h>
 #include <vtkAnimationScene.h>
-#include <vtkIntersectionPolyDataFilter.h>
 
 #include "TimerCallback.h"
 #include "Animation.h"
+#include "MeshIntersection.h"
+#include "RayIntersection.h"
+#include "SequenceRenderer.h"
+#include "TessellationCache.h"
+#include "InstancedAnimator.h"
+#include "FrameProfiler.h"
+#include "AsyncLogger.h"
+#include "BakedAnimation.h"
+#include "MeshSequence.h"
+#include "DeformationAnimator.h"
+#include "Picking.h"
+#include "CueScheduler.h"
+#include "SceneLoader.h"
+#include "FrameBudget.h"
+#include "SimulationThread.h"
 
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 using namespace std;
@@ -68,15 +84,42 @@ class MyInteractorStyle : public vtkInteractorStyleTrackballActor
   public:
     static MyInteractorStyle* New();
     vtkTypeMacro(MyInteractorStyle, vtkInteractorStyleTrackballActor);
+
+    MyInteractorStyle() : Picker(0), Hovered(-1) {}
+
+    // Reports the actor under the mouse whenever it changes.
+    virtual void OnMouseMove()
+    {
+      ActorPicker::Hit hit;
+      if (this->PickAtEvent(hit) && hit.ActorId != this->Hovered)
+        {
+        AsyncLogger::GetInstance().Log(AsyncLogger::LOG_INFO, "Hovering actor %g cell %g.",
+                                       hit.ActorId, static_cast<double>(hit.CellId));
+        }
+      this->Hovered = hit.ActorId;
+
+      // Forward events
+      vtkInteractorStyleTrackballActor::OnMouseMove();
+    }
  
     virtual void OnLeftButtonDown() 
     {
-      std::cout << "Pressed left mouse button." << std::endl;
- 
-      vtkSmartPointer<vtkMatrix4x4> m = 
-          vtkSmartPointer<vtkMatrix4x4>::New();
-      this->Actor->GetMatrix(m);
-      std::cout << "Matrix: " << endl << *m << std::endl;
+      AsyncLogger &logger = AsyncLogger::GetInstance();
+      logger.Log(AsyncLogger::LOG_INFO, "Pressed left mouse button.");
+      ActorPicker::Hit hit;
+      if (this->PickAtEvent(hit))
+        {
+        logger.Log(AsyncLogger::LOG_INFO, "Picked actor %g at (%g, %g, %g).",
+                   hit.ActorId, hit.WorldPoint[0], hit.WorldPoint[1], hit.WorldPoint[2]);
+        this->Actor = hit.Actor;
+        }
+      if (this->Actor && logger.IsEnabled(AsyncLogger::LOG_DEBUG))
+        {
+        vtkSmartPointer<vtkMatrix4x4> m = 
+            vtkSmartPointer<vtkMatrix4x4>::New();
+        this->Actor->GetMatrix(m);
+        logger.LogMatrix(AsyncLogger::LOG_DEBUG, "Matrix", m);
+        }
  
       // Forward events
       vtkInteractorStyleTrackballActor::OnLeftButtonDown();
@@ -84,21 +127,41 @@ class MyInteractorStyle : public vtkInteractorStyleTrackballActor
  
     virtual void OnLeftButtonUp() 
     {
-      std::cout << "Released left mouse button." << std::endl;
- 
-      vtkSmartPointer<vtkMatrix4x4> m = 
-          vtkSmartPointer<vtkMatrix4x4>::New();
-      this->Actor->GetMatrix(m);
-      std::cout << "Matrix: " << endl << *m << std::endl;
+      AsyncLogger &logger = AsyncLogger::GetInstance();
+      logger.Log(AsyncLogger::LOG_INFO, "Released left mouse button.");
+      if (this->Actor && logger.IsEnabled(AsyncLogger::LOG_DEBUG))
+        {
+        vtkSmartPointer<vtkMatrix4x4> m = 
+            vtkSmartPointer<vtkMatrix4x4>::New();
+        this->Actor->GetMatrix(m);
+        logger.LogMatrix(AsyncLogger::LOG_DEBUG, "Matrix", m);
+        }
  
       // Forward events
       vtkInteractorStyleTrackballActor::OnLeftButtonUp();
     }
  
     void SetActor(vtkSmartPointer<vtkActor> actor) {this->Actor = actor;}
+    // Picks with picker instead of only reporting the actor set above.
+    void SetPicker(ActorPicker *picker) {this->Picker = picker;}
  
   private:
+    bool PickAtEvent(ActorPicker::Hit &hit)
+    {
+      hit.ActorId = -1;
+      if (!this->Picker)
+        {
+        return false;
+        }
+      int *position = this->GetInteractor()->GetEventPosition();
+      this->FindPokedRenderer(position[0], position[1]);
+      vtkRenderer *renderer = this->GetCurrentRenderer();
+      return renderer && this->Picker->Pick(position[0], position[1], renderer, hit);
+    }
+
     vtkSmartPointer<vtkActor> Actor;
+    ActorPicker *Picker;
+    int Hovered;
  
  
 };
@@ -109,6 +172,10 @@ vtkStandardNewMacro(MyInteractorStyle);
 // controlled. After constructing the callback, the program sets the
 // SphereSource of the callback to 
 // the object to be controlled.
+// When a TessellationCache is set the levels come from it instead, and
+// the sphere keeps its current level until the new one is generated.
+// When a FrameBudgetGovernor is set the slider only caps the level it
+// picks: the finest of its Resolutions not above the slider value.
 class vtkSliderCallback : public vtkCommand
 {
 public:
@@ -118,18 +185,151 @@ public:
     }
   virtual void Execute(vtkObject *caller, unsigned long, void*)
     {
+    FRAME_PROFILE_SCOPE("vtkSliderCallback");
     vtkSliderWidget *sliderWidget = reinterpret_cast<vtkSliderWidget*>(caller);
-    this->SphereSource->SetPhiResolution(static_cast<vtkSliderRepresentation *>(sliderWidget->GetRepresentation())->GetValue()/2);
-    this->SphereSource->SetThetaResolution(static_cast<vtkSliderRepresentation *>(sliderWidget->GetRepresentation())->GetValue());
+    double value = static_cast<vtkSliderRepresentation *>(sliderWidget->GetRepresentation())->GetValue();
+    if (this->Governor)
+      {
+      int level = 0;
+      while (level + 1 < this->NumberOfResolutions && this->Resolutions[level + 1] <= value)
+        {
+        level++;
+        }
+      this->Governor->SetMaximumLevel(this->GovernorId, level);
+      return;
+      }
+    if (this->Cache)
+      {
+      this->Cache->Request(static_cast<int>(value / 2), static_cast<int>(value));
+      return;
+      }
+    this->SphereSource->SetPhiResolution(value/2);
+    this->SphereSource->SetThetaResolution(value);
     }
-  vtkSliderCallback():SphereSource(0) {}
+  vtkSliderCallback():SphereSource(0),Cache(0),Governor(0),GovernorId(0),Resolutions(0),NumberOfResolutions(0) {}
   vtkSphereSource *SphereSource;
+  TessellationCache *Cache;
+  FrameBudgetGovernor *Governor;
+  int GovernorId;
+  const int *Resolutions;
+  int NumberOfResolutions;
 };
 //***************************************************************
 
 //***************************************************************
-int main(int, char *argv[])
+int main(int argc, char *argv[])
 {
+  // Scene -sequence <directory> [png|raw]
+  // renders the animation offscreen frame by frame and writes the frames
+  // to <directory> instead of opening an interactive window.
+  const char *sequenceDirectory = 0;
+  bool sequenceRaw = false;
+  if (argc > 2 && !strcmp(argv[1], "-sequence"))
+    {
+    sequenceDirectory = argv[2];
+    sequenceRaw = argc > 3 && !strcmp(argv[3], "raw");
+    }
+  // Scene -profile <trace.json>
+  // times the animation, intersection and render stages, prints a summary
+  // every 50 frames and writes a Chrome trace when the program exits. The
+  // FRAME_PROFILE environment variable does the same without the summary.
+  // Scene -instances <count>
+  // adds count small spheres animated and drawn as instances of one mesh.
+  // Scene -log <debug|info|warning|error>
+  // sets the lowest severity the callbacks log, info by default; debug
+  // adds the timer ticks and the actor matrices.
+  // Scene -bake <file>
+  // plays the animation once in sequence mode, writes the matrix of every
+  // animated actor at every frame to file and exits.
+  // Scene -replay <file>
+  // plays the actors from a file written by -bake instead of evaluating
+  // their animators.
+  // Scene -meshes <pattern>
+  // adds a mesh sequence read from the files named by the printf pattern
+  // (e.g. frame_%04d.vtp, numbered from 0 or 1), one file per timestep
+  // spread over the animation, streamed from disk ahead of playback.
+  // Scene -deform <resolution>
+  // adds a sphere of resolution x resolution vertices that stretches into
+  // an ellipsoid and back with a wave running over it, deformed in place.
+  int instanceCount = 0;
+  const char *meshPattern = 0;
+  // Scene -scene <file>
+  // adds the actors, cues and animations declared in a scene file, text
+  // or binary (see SceneLoader.h), identical meshes built once.
+  // Scene -pick
+  // manipulates the actors with the mouse instead of the camera and
+  // reports the actor and cell under the mouse and the point clicked.
+  // Scene -budget <milliseconds>
+  // picks the sphere's tessellation each frame to keep frames within
+  // the budget (100 matches the scene's 10 frames per second); the
+  // resolution slider then sets the finest tessellation allowed.
+  double frameBudget = 0.0;
+  // Scene -simulate <steps per second>
+  // moves the sphere on a thread of its own at a fixed rate; each render
+  // shows the newest pose, interpolated between the last two steps.
+  double simulationRate = 0.0;
+  int deformResolution = 0;
+  bool pick = false;
+  const char *bakeFile = 0;
+  const char *replayFile = 0;
+  const char *sceneFile = 0;
+  for (int i = 1; i < argc; i++)
+    {
+    pick = pick || !strcmp(argv[i], "-pick");
+    }
+  for (int i = 1; i + 1 < argc; i++)
+    {
+    if (!strcmp(argv[i], "-instances"))
+      {
+      instanceCount = atoi(argv[i + 1]);
+      }
+    if (!strcmp(argv[i], "-profile"))
+      {
+      FrameProfiler::GetInstance().EnableOn();
+      FrameProfiler::GetInstance().SetTraceFileOnExit(argv[i + 1]);
+      FrameProfiler::GetInstance().SetSummaryInterval(50);
+      }
+    if (!strcmp(argv[i], "-bake"))
+      {
+      bakeFile = argv[i + 1];
+      }
+    if (!strcmp(argv[i], "-replay"))
+      {
+      replayFile = argv[i + 1];
+      }
+    if (!strcmp(argv[i], "-meshes"))
+      {
+      meshPattern = argv[i + 1];
+      }
+    if (!strcmp(argv[i], "-scene"))
+      {
+      sceneFile = argv[i + 1];
+      }
+    if (!strcmp(argv[i], "-deform"))
+      {
+      deformResolution = atoi(argv[i + 1]);
+      }
+    if (!strcmp(argv[i], "-budget"))
+      {
+      frameBudget = atof(argv[i + 1]);
+      }
+    if (!strcmp(argv[i], "-simulate"))
+      {
+      simulationRate = atof(argv[i + 1]);
+      }
+    if (!strcmp(argv[i], "-log"))
+      {
+      const char *levels[] = {"debug", "info", "warning", "error"};
+      for (int level = 0; level < 4; level++)
+        {
+        if (!strcmp(argv[i + 1], levels[level]))
+          {
+          AsyncLogger::GetInstance().SetLevel(AsyncLogger::LOG_DEBUG + level);
+          }
+        }
+      }
+    }
+
   /*
 	 create a data source (cylinder)
 	 any data that can be visualized
@@ -153,12 +353,36 @@ int main(int, char *argv[])
   sphereSource->SetPhiResolution(4);
   sphereSource->SetThetaResolution(8);
 
+  // The resolution slider picks tessellations from this cache; the mapper
+  // and the intersector read its output.
+  TessellationCache sphereLevels;
+  sphereLevels.SetSource(sphereSource);
+  sphereLevels.SetMemoryBudget(256 * 1024);
+  sphereLevels.Load(sphereSource->GetPhiResolution(), sphereSource->GetThetaResolution());
+
   vtkSmartPointer<vtkPolyDataMapper> mapperSphere = vtkSmartPointer<vtkPolyDataMapper>::New();
-  mapperSphere->SetInputConnection(sphereSource->GetOutputPort());
+#if VTK_MAJOR_VERSION <= 5
+  mapperSphere->SetInput(sphereLevels.GetOutput());
+#else
+  mapperSphere->SetInputData(sphereLevels.GetOutput());
+#endif
  
   vtkSmartPointer<vtkActor> actorSphere = vtkSmartPointer<vtkActor>::New();
   actorSphere->SetMapper(mapperSphere);
   actorSphere->GetProperty()->SetInterpolationToFlat();
+
+  // With a frame budget the governor shows its own levels of the sphere
+  // in the same output instead.
+  FrameBudgetGovernor governor;
+  const int sphereResolutions[] = {4, 8, 12, 16, 24, 32, 40, 50};
+  const int numberOfSphereResolutions = sizeof(sphereResolutions) / sizeof(sphereResolutions[0]);
+  int governedSphere = -1;
+  if (frameBudget > 0.0)
+    {
+    governedSphere = governor.AddActor(actorSphere, sphereLevels.GetOutput());
+    governor.AddSphereLevels(governedSphere, sphereSource, sphereResolutions, numberOfSphereResolutions);
+    governor.SetFrameBudget(frameBudget / 1000.0);
+    }
   //-------------------------------------------------------
   vtkSmartPointer<vtkSphereSource> cylinderSource = vtkSmartPointer<vtkSphereSource>::New();
   cylinderSource->SetCenter(0.0, 0.0, 0.0);
@@ -176,28 +400,26 @@ int main(int, char *argv[])
   actor->GetProperty()->SetColor(0,1,0);
 
 
-  vtkSmartPointer<vtkSphereSource> cylinderSource1 = vtkSmartPointer<vtkSphereSource>::New();
-  cylinderSource1->SetCenter(0.0, 0.0, 0.0);
-  cylinderSource1->SetRadius(5.0);
-  //cylinderSource1->SetHeight(7.0);
-  //cylinderSource1->SetResolution(100);
-  cylinderSource1->Update();
-  
-  vtkSmartPointer<vtkPolyDataMapper> mapperx =  vtkSmartPointer<vtkPolyDataMapper>::New();
-  mapperx->SetInputConnection(cylinderSource1->GetOutputPort());
-  mapperx->ScalarVisibilityOff();
+  // Same sphere as actor, so it shares its source and mapper.
   vtkSmartPointer<vtkActor> actorx      = vtkSmartPointer<vtkActor>::New();
-  actorx->SetMapper(mapperx);
+  actorx->SetMapper(mapper);
   actorx->GetProperty()->SetOpacity(.3);
   actorx->GetProperty()->SetColor(1,0,0);  
   //-------------------------------------------------------
-	  vtkSmartPointer<vtkIntersectionPolyDataFilter> intersectionPolyDataFilter = vtkSmartPointer<vtkIntersectionPolyDataFilter>::New();
-	  intersectionPolyDataFilter->SetInputConnection( 0, cylinderSource->GetOutputPort() );
-	  intersectionPolyDataFilter->SetInputConnection( 1, cylinderSource1->GetOutputPort() );
-	  intersectionPolyDataFilter->Update();
+	  // Intersection of the animated sphere with actorx. The hierarchies are
+	  // built once, each tick only applies the actor matrices.
+	  MeshIntersector meshIntersector;
+	  meshIntersector.SetInput(0, actorSphere, sphereLevels.GetOutput());
+	  meshIntersector.SetInput(1, actorx, cylinderSource->GetOutput());
+	  meshIntersector.SetMargin(0.05);
+	  meshIntersector.Update();
  
 	  vtkSmartPointer<vtkPolyDataMapper> intersectionMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
-	  intersectionMapper->SetInputConnection( intersectionPolyDataFilter->GetOutputPort() );
+#if VTK_MAJOR_VERSION <= 5
+	  intersectionMapper->SetInput( meshIntersector.GetOutput() );
+#else
+	  intersectionMapper->SetInputData( meshIntersector.GetOutput() );
+#endif
 	  intersectionMapper->ScalarVisibilityOff();
  
 	  vtkSmartPointer<vtkActor> intersectionActor = vtkSmartPointer<vtkActor>::New();
@@ -256,6 +478,16 @@ int main(int, char *argv[])
   std::cout << "intersected? " << iD << std::endl;
   std::cout << "intersection: " << x[0] << " " << x[1] << " " << x[2] << std::endl;
 
+  // Same query through the batch API, which takes any number of segments.
+  BatchRayIntersector rayIntersector;
+  rayIntersector.SetInput(polygonPolyData);
+  rayIntersector.SetTolerance(tolerance);
+  double batchT, batchX[3];
+  vtkIdType batchCellId;
+  rayIntersector.IntersectSegments(1, p1, p2, &batchT, batchX, &batchCellId);
+  std::cout << "batch intersected? " << (batchCellId >= 0) << " cell " << batchCellId
+            << " at " << batchX[0] << " " << batchX[1] << " " << batchX[2] << std::endl;
+
   /*
 	create data filter
   */
@@ -308,6 +540,10 @@ int main(int, char *argv[])
   vtkSmartPointer<vtkRenderWindow> renderWindow = vtkSmartPointer<vtkRenderWindow>::New();
   renderWindow->AddRenderer(renderer);
   renderWindow->SetWindowName("test");
+  if (sequenceDirectory)
+    {
+    renderWindow->OffScreenRenderingOn();
+    }
   vtkSmartPointer<vtkRenderWindowInteractor> renderWindowInteractor = vtkSmartPointer<vtkRenderWindowInteractor>::New();
   renderWindowInteractor->SetRenderWindow(renderWindow);
 
@@ -347,6 +583,15 @@ int main(int, char *argv[])
  
 	  vtkSmartPointer<vtkSliderCallback> callback = vtkSmartPointer<vtkSliderCallback>::New();
 	  callback->SphereSource = sphereSource;
+	  callback->Cache = &sphereLevels;
+	  if (governedSphere >= 0)
+	    {
+	    callback->Governor = &governor;
+	    callback->GovernorId = governedSphere;
+	    callback->Resolutions = sphereResolutions;
+	    callback->NumberOfResolutions = numberOfSphereResolutions;
+	    callback->Execute(sliderWidget, vtkCommand::InteractionEvent, 0);
+	    }
 
 	  sliderWidget->AddObserver(vtkCommand::InteractionEvent,callback);
 
@@ -370,9 +615,31 @@ int main(int, char *argv[])
 		  scene->SetStartTime(0);
 		  scene->SetEndTime(5);
 
+		  // In sequence mode SequenceRenderer renders each frame itself.
 		  vtkSmartPointer<AnimationSceneObserver> sceneObserver = vtkSmartPointer<AnimationSceneObserver>::New();
 		  sceneObserver->SetRenderWindow(renderWindow);
-		  scene->AddObserver(vtkCommand::AnimationCueTickEvent,sceneObserver);
+
+		  // Render once per scene tick, and only when something on screen changed
+		  RenderScheduler renderScheduler;
+		  renderScheduler.SetRenderWindow(renderWindow);
+		  renderScheduler.WatchActor(actorSphere);
+		  renderScheduler.WatchActor(actorx);
+		  renderScheduler.WatchActor(intersectionActor);
+		  renderScheduler.Watch(meshIntersector.GetOutput());
+		  renderScheduler.Watch(sphereLevels.GetOutput());
+		  sceneObserver->SetRenderScheduler(&renderScheduler);
+		  if (!sequenceDirectory)
+		    {
+		    scene->AddObserver(vtkCommand::AnimationCueTickEvent,sceneObserver);
+		    }
+		  if (governedSphere >= 0)
+		    {
+		    governor.SetRenderer(renderer);
+		    governor.AddObserversToCue(scene);
+		    }
+		  // Play does not return to the event loop, so the interactor's timer
+		  // cannot show finished levels while the scene plays.
+		  sphereLevels.AddObserversToCue(scene);
  
 		  // Create an Animation Cue for each actor
 		  vtkSmartPointer<vtkAnimationCue> cue1 = vtkSmartPointer<vtkAnimationCue>::New();
@@ -386,19 +653,215 @@ int main(int, char *argv[])
 		  startPos[0] = 2;  startPos[1] = 1;  startPos[2] = 1;
 
 		  ActorAnimator animateSphere;
-		  animateSphere.SetActor(actorSphere);
-		  animateSphere.SetStartPosition(startPos);
-		  animateSphere.SetEndPosition(endPos);
-		  animateSphere.AddObserversToCue(cue1);
+		  ThreadedActorAnimator simulation;
+		  BakedAnimationPlayer bakedPlayer;
+		  if (replayFile && bakedPlayer.Open(replayFile))
+		    {
+		    bakedPlayer.SetActor(0, actorSphere);
+		    bakedPlayer.SetRenderScheduler(&renderScheduler);
+		    bakedPlayer.AddObserversToCue(cue1);
+		    }
+		  else
+		    {
+		    if (replayFile)
+		      {
+		      std::cerr << "Cannot replay " << replayFile << ", animating instead." << std::endl;
+		      }
+		    animateSphere.SetActor(actorSphere);
+		    animateSphere.SetStartPosition(startPos);
+		    animateSphere.SetEndPosition(endPos);
+		    // Baking and sequences step the scene faster than real time,
+		    // which a simulation running on the clock cannot follow.
+		    if (simulationRate > 0.0 && !bakeFile && !sequenceDirectory)
+		      {
+		      simulation.AddAnimator(&animateSphere);
+		      simulation.SetStepsPerSecond(simulationRate);
+		      simulation.SetRenderScheduler(&renderScheduler);
+		      simulation.AddObserversToCue(cue1);
+		      simulation.AddObserversToRenderWindow(renderWindow);
+		      }
+		    else
+		      {
+		      animateSphere.SetRenderScheduler(&renderScheduler);
+		      animateSphere.AddObserversToCue(cue1);
+		      }
+		    }
+		  meshIntersector.AddObserversToCue(cue1);
+
+		  if (bakeFile)
+		    {
+		    AnimationBaker baker;
+		    baker.SetScene(scene);
+		    baker.AddActor(actorSphere);
+		    baker.Bake();
+		    if (!baker.Write(bakeFile))
+		      {
+		      std::cerr << "Cannot write " << bakeFile << std::endl;
+		      return EXIT_FAILURE;
+		      }
+		    std::cout << "baked " << baker.GetNumberOfFrames() << " frames to " << bakeFile << std::endl;
+		    return EXIT_SUCCESS;
+		    }
 
+		  // Optional crowd of instanced spheres on the same cue.
+		  vtkSmartPointer<vtkSphereSource> instanceSource = vtkSmartPointer<vtkSphereSource>::New();
+		  instanceSource->SetRadius(0.3);
+		  InstancedActorAnimator instances;
+		  if (instanceCount > 0)
+		    {
+		    instances.SetSourceConnection(instanceSource->GetOutputPort());
+		    instances.Reserve(instanceCount);
+		    for (int i = 0; i < instanceCount; i++)
+		      {
+		      double start[3], end[3], color[3];
+		      for (int k = 0; k < 3; k++)
+		        {
+		        start[k] = 16.0 * rand() / RAND_MAX - 8.0;
+		        end[k] = 16.0 * rand() / RAND_MAX - 8.0;
+		        color[k] = static_cast<double>(rand()) / RAND_MAX;
+		        }
+		      instances.AddInstance(start, end, color);
+		      }
+		    instances.SetRenderScheduler(&renderScheduler);
+		    instances.AddObserversToCue(cue1);
+		    renderer->AddActor(instances.GetActor());
+		    renderScheduler.Watch(instances.GetInstances());
+		    }
+
+		  // Optional time-varying mesh on the same cue.
+		  MeshSequencePlayer meshes;
+		  vtkSmartPointer<vtkPolyDataMapper> meshMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+		  vtkSmartPointer<vtkActor> meshActor = vtkSmartPointer<vtkActor>::New();
+		  if (meshPattern && (meshes.SetFilePattern(meshPattern, 0) || meshes.SetFilePattern(meshPattern, 1)))
+		    {
+#if VTK_MAJOR_VERSION <= 5
+		    meshMapper->SetInput(meshes.GetOutput());
+#else
+		    meshMapper->SetInputData(meshes.GetOutput());
+#endif
+		    meshActor->SetMapper(meshMapper);
+		    meshes.AddObserversToCue(cue1);
+		    renderer->AddActor(meshActor);
+		    renderScheduler.Watch(meshes.GetOutput());
+		    }
+		  else if (meshPattern)
+		    {
+		    std::cerr << "No files match " << meshPattern << std::endl;
+		    }
+
+		  // Optional deforming sphere on the same cue.
+		  MeshDeformationAnimator deformation;
+		  vtkSmartPointer<vtkPolyData> deformed = vtkSmartPointer<vtkPolyData>::New();
+		  vtkSmartPointer<vtkPolyDataMapper> deformedMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+		  vtkSmartPointer<vtkActor> deformedActor = vtkSmartPointer<vtkActor>::New();
+		  if (deformResolution > 0)
+		    {
+		    vtkSmartPointer<vtkSphereSource> deformSource = vtkSmartPointer<vtkSphereSource>::New();
+		    deformSource->SetCenter(0.0, 0.0, 0.0);
+		    deformSource->SetRadius(2.0);
+		    deformSource->SetPhiResolution(deformResolution);
+		    deformSource->SetThetaResolution(deformResolution);
+		    deformSource->Update();
+		    deformed->DeepCopy(deformSource->GetOutput());
+		    deformation.SetPolyData(deformed);
+
+		    vtkSmartPointer<vtkPoints> ellipsoid = vtkSmartPointer<vtkPoints>::New();
+		    ellipsoid->DeepCopy(deformed->GetPoints());
+		    for (vtkIdType p = 0; p < ellipsoid->GetNumberOfPoints(); p++)
+		      {
+		      double x[3];
+		      ellipsoid->GetPoint(p, x);
+		      ellipsoid->SetPoint(p, 1.6 * x[0], 0.7 * x[1], x[2]);
+		      }
+		    int target = deformation.AddTarget(ellipsoid);
+		    double weights[3] = {0.0, 1.0, 0.0};
+		    for (int k = 0; k < 3; k++)
+		      {
+		      deformation.GetWeightTrack(target)->AddKey(2.5 * k, &weights[k]);
+		      }
+		    double waveDirection[3] = {0.0, 0.0, 1.0};
+		    deformation.SetWave(0.1, 1.0, 0.5, waveDirection);
+		    deformation.SetRenderScheduler(&renderScheduler);
+		    deformation.AddObserversToCue(cue1);
+
+#if VTK_MAJOR_VERSION <= 5
+		    deformedMapper->SetInput(deformed);
+#else
+		    deformedMapper->SetInputData(deformed);
+#endif
+		    deformedActor->SetMapper(deformedMapper);
+		    deformedActor->SetPosition(-5.0, 0.0, 0.0);
+		    renderer->AddActor(deformedActor);
+		    renderScheduler.Watch(deformed);
+		    }
+
+		  // Optional scene file. Its cues are ticked by a scheduler on the
+		  // scene, which only touches the cues running at each tick.
+		  SceneLoader sceneLoader;
+		  CueScheduler cueScheduler;
+		  if (sceneFile && sceneLoader.Read(sceneFile))
+		    {
+		    sceneLoader.SetRenderScheduler(&renderScheduler);
+		    sceneLoader.SetCueScheduler(&cueScheduler);
+		    cueScheduler.AddObserversToCue(scene);
+		    sceneLoader.Build(renderer, scene);
+		    std::cout << "scene " << sceneFile << ": " << sceneLoader.GetNumberOfActors() << " actors, "
+		              << sceneLoader.GetNumberOfSources() << " meshes from "
+		              << sceneLoader.GetNumberOfSourceDeclarations() << " sources" << std::endl;
+		    }
+		  else if (sceneFile)
+		    {
+		    std::cerr << "Cannot load scene: " << sceneLoader.GetErrorMessage() << std::endl;
+		    }
+
+		  // Mouse picking of the meshes on screen.
+		  ActorPicker scenePicker;
+		  vtkSmartPointer<MyInteractorStyle> style = vtkSmartPointer<MyInteractorStyle>::New();
+		  if (pick)
+		    {
+		    scenePicker.AddActor(actorSphere, sphereLevels.GetOutput());
+		    scenePicker.AddActor(actorx, cylinderSource->GetOutput());
+		    if (meshActor->GetMapper())
+		      {
+		      scenePicker.AddActor(meshActor, meshes.GetOutput());
+		      }
+		    if (deformResolution > 0)
+		      {
+		      scenePicker.AddActor(deformedActor, deformed);
+		      }
+		    style->SetPicker(&scenePicker);
+		    style->SetDefaultRenderer(renderer);
+		    renderWindowInteractor->SetInteractorStyle(style);
+		    }
 
 		  
 		  //renWin->Render();
 		  renderer->ResetCamera();
 		  //renderer->GetActiveCamera()->Dolly(.5);		  
 		  //renderer->ResetCameraClippingRange();		  
+
+		  if (sequenceDirectory)
+		    {
+		    FrameExporter exporter;
+		    exporter.SetDirectory(sequenceDirectory);
+		    exporter.SetFormat(sequenceRaw ? FrameExporter::RAW : FrameExporter::PNG);
+
+		    SequenceRenderer sequence;
+		    sequence.SetScene(scene);
+		    sequence.SetRenderWindow(renderWindow);
+		    sequence.SetExporter(&exporter);
+		    sequence.Run();
+		    sequence.PrintStatistics(std::cout);
+		    if (meshPattern)
+		      {
+		      meshes.PrintStatistics(std::cout);
+		      }
+		    return EXIT_SUCCESS;
+		    }
 		  renderWindow->Render();
 		  renderWindowInteractor->Initialize();		  
+		  // Timers need an initialized interactor.
+		  sphereLevels.AddObserversToInteractor(renderWindowInteractor);
 
   //-----------------------------------------
 
@@ -415,6 +878,18 @@ int main(int, char *argv[])
   // Create Cue observer.
   scene->Play();
   scene->Stop();
+  if (meshPattern)
+    {
+    meshes.PrintStatistics(std::cout);
+    }
+  if (governedSphere >= 0)
+    {
+    governor.PrintStatistics(std::cout);
+    }
+  if (simulation.GetNumberOfAnimators())
+    {
+    simulation.PrintStatistics(std::cout);
+    }
   
 
   /*
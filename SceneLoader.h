@@ -0,0 +1,904 @@
+#ifndef __SceneLoader_h
+#define __SceneLoader_h
+#include <vtkActor.h>
+#include <vtkAnimationCue.h>
+#include <vtkAnimationScene.h>
+#include <vtkConeSource.h>
+#include <vtkCubeSource.h>
+#include <vtkCylinderSource.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include <vtkRegularPolygonSource.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Animation.h"
+#include "BakedAnimation.h"
+#include "CueScheduler.h"
+#include "RenderScheduler.h"
+
+// Records of a scene description. The binary scene file is these records
+// as they are in memory, so they only hold fixed-size fields.
+struct SceneSource
+{
+  int    Type;
+  int    Reserved;
+  double Parameters[8];
+};
+
+struct SceneProperty
+{
+  double Color[3];
+  double Opacity;
+  int    Flat;
+  int    Reserved;
+};
+
+struct SceneActor
+{
+  int    Source;
+  int    Property;   // -1 for the default property
+  double Position[3];
+  double Orientation[3];
+  double Scale[3];
+};
+
+struct SceneCue
+{
+  double StartTime;
+  double EndTime;
+};
+
+struct SceneAnimation
+{
+  int    Actor;
+  int    Cue;
+  double From[3];
+  double To[3];
+  double AngularVelocity;
+};
+
+// Layout of a binary scene file, in the byte order of the machine that
+// wrote it (a file from the other byte order fails the version check):
+//
+//   SceneFileHeader
+//   NumberOfSources x SceneSource
+//   NumberOfProperties x SceneProperty
+//   NumberOfActors x SceneActor
+//   NumberOfCues x SceneCue
+//   NumberOfAnimations x SceneAnimation
+struct SceneFileHeader
+{
+  char         Magic[8];
+  unsigned int Version;
+  unsigned int NumberOfSources;
+  unsigned int NumberOfProperties;
+  unsigned int NumberOfActors;
+  unsigned int NumberOfCues;
+  unsigned int NumberOfAnimations;
+};
+
+static const char SceneFileMagic[8] = {'V', 'T', 'K', 'S', 'C', 'E', 'N', '\0'};
+static const unsigned int SceneFileVersion = 1;
+
+// Builds actors, properties, cues and animators from a scene file instead
+// of by hand. A text file has one declaration per line, '#' starting a
+// comment; the keyword arguments are optional and may come in any order:
+//
+//   source <name> sphere   [center x y z] [radius r] [phi n] [theta n]
+//   source <name> cylinder [center x y z] [radius r] [height h] [resolution n]
+//   source <name> cone     [center x y z] [radius r] [height h] [resolution n]
+//   source <name> cube     [center x y z] [size x y z]
+//   source <name> polygon  [center x y z] [radius r] [sides n]
+//   property <name> [color r g b] [opacity o] [flat]
+//   actor <name> <source> [property <name>] [position x y z]
+//         [orientation x y z] [scale x y z]
+//   cue <name> <start> <end>
+//   animate <actor> <cue> [from x y z] [to x y z] [velocity degrees/s]
+//
+// Names are only used to refer to earlier declarations. An animated
+// actor is placed by its animator, not by its position and orientation.
+// The binary variant (see SceneFileHeader and WriteBinary) holds the same
+// records with indices instead of names and is read from a mapping.
+//
+// Sources are keyed by a hash of their type and parameters, so identical
+// sources, named differently or not, are one geometry. Build makes one
+// source and one mapper per geometry, shared by all the actors drawing
+// it, and does not update them: each source runs on the first render
+// that needs it. Memory and startup time go with the number of distinct
+// meshes; an object only costs its actor.
+class SceneLoader
+{
+public:
+  enum SourceTypes
+    {
+    SPHERE,
+    CYLINDER,
+    CONE,
+    CUBE,
+    POLYGON,
+    NUMBER_OF_SOURCE_TYPES
+    };
+
+  SceneLoader()
+    {
+    this->Scheduler = 0;
+    this->CueTimeline = 0;
+    this->NumberOfSourceDeclarations = 0;
+    }
+
+  ~SceneLoader()
+    {
+    this->ClearBuilt();
+    }
+
+  // Reads a text or binary scene file, replacing the current description.
+  // Returns false, with a message in GetErrorMessage, if the file cannot
+  // be read or has an error; the description is then empty.
+  bool Read(const std::string &fileName)
+    {
+    this->Clear();
+    this->ErrorMessage.clear();
+    MappedFile file;
+    if (!file.Open(fileName))
+      {
+      this->ErrorMessage = "cannot open " + fileName;
+      return false;
+      }
+    bool ok = file.GetSize() >= sizeof(SceneFileMagic) &&
+              !memcmp(file.GetData(), SceneFileMagic, sizeof(SceneFileMagic)) ?
+      this->ParseBinary(file.GetData(), file.GetSize()) :
+      this->ParseText(file.GetData(), file.GetSize());
+    if (!ok)
+      {
+      this->ErrorMessage = fileName + ": " + this->ErrorMessage;
+      this->Clear();
+      }
+    return ok;
+    }
+
+  // Parses a text description held in memory.
+  bool ReadText(const char *text, size_t size)
+    {
+    this->Clear();
+    this->ErrorMessage.clear();
+    bool ok = this->ParseText(text, size);
+    if (!ok)
+      {
+      this->Clear();
+      }
+    return ok;
+    }
+
+  // Writes the current description as a binary scene file.
+  bool WriteBinary(const std::string &fileName) const
+    {
+    FILE *file = fopen(fileName.c_str(), "wb");
+    if (!file)
+      {
+      return false;
+      }
+    SceneFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Magic, SceneFileMagic, sizeof(header.Magic));
+    header.Version = SceneFileVersion;
+    header.NumberOfSources = static_cast<unsigned int>(this->Sources.size());
+    header.NumberOfProperties = static_cast<unsigned int>(this->Properties.size());
+    header.NumberOfActors = static_cast<unsigned int>(this->Actors.size());
+    header.NumberOfCues = static_cast<unsigned int>(this->Cues.size());
+    header.NumberOfAnimations = static_cast<unsigned int>(this->Animations.size());
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              WriteRecords(file, this->Sources) &&
+              WriteRecords(file, this->Properties) &&
+              WriteRecords(file, this->Actors) &&
+              WriteRecords(file, this->Cues) &&
+              WriteRecords(file, this->Animations);
+    ok = fclose(file) == 0 && ok;
+    return ok;
+    }
+
+  const std::string &GetErrorMessage() const { return this->ErrorMessage; }
+
+  // Distinct geometries, after deduplication.
+  size_t GetNumberOfSources() const    { return this->Sources.size(); }
+  // Source declarations read, before deduplication.
+  size_t GetNumberOfSourceDeclarations() const { return this->NumberOfSourceDeclarations; }
+  size_t GetNumberOfProperties() const { return this->Properties.size(); }
+  size_t GetNumberOfActors() const     { return this->Actors.size(); }
+  size_t GetNumberOfCues() const       { return this->Cues.size(); }
+  size_t GetNumberOfAnimations() const { return this->Animations.size(); }
+
+  const SceneActor &GetActorDescription(size_t index) const { return this->Actors[index]; }
+
+  // Animators built by Build ask this scheduler for renders.
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+
+  // When set, Build adds the cues to this scheduler instead of the scene,
+  // for timelines with many cues.
+  void SetCueScheduler(CueScheduler *scheduler)
+    {
+    this->CueTimeline = scheduler;
+    }
+
+  // Creates the pipelines, actors and cues of the description, adding the
+  // actors to the renderer and the cues to the scene (or cue scheduler)
+  // when given. Replaces
+  // what an earlier Build made; the renderer and scene of that build are
+  // left alone. No source is updated here.
+  void Build(vtkRenderer *renderer, vtkAnimationScene *scene)
+    {
+    this->ClearBuilt();
+
+    // Only the geometries some actor draws get a pipeline.
+    this->Mappers.assign(this->Sources.size(), vtkSmartPointer<vtkPolyDataMapper>());
+    this->Algorithms.assign(this->Sources.size(), vtkSmartPointer<vtkPolyDataAlgorithm>());
+    for (size_t a = 0; a < this->Actors.size(); a++)
+      {
+      int source = this->Actors[a].Source;
+      if (!this->Mappers[source])
+        {
+        this->Algorithms[source] = NewSource(this->Sources[source]);
+        this->Mappers[source] = vtkSmartPointer<vtkPolyDataMapper>::New();
+        this->Mappers[source]->SetInputConnection(this->Algorithms[source]->GetOutputPort());
+        this->Mappers[source]->ScalarVisibilityOff();
+        }
+      }
+
+    this->BuiltProperties.resize(this->Properties.size());
+    for (size_t p = 0; p < this->Properties.size(); p++)
+      {
+      const SceneProperty &description = this->Properties[p];
+      vtkSmartPointer<vtkProperty> property = vtkSmartPointer<vtkProperty>::New();
+      property->SetColor(description.Color[0], description.Color[1], description.Color[2]);
+      property->SetOpacity(description.Opacity);
+      if (description.Flat)
+        {
+        property->SetInterpolationToFlat();
+        }
+      this->BuiltProperties[p] = property;
+      }
+
+    this->BuiltActors.resize(this->Actors.size());
+    for (size_t a = 0; a < this->Actors.size(); a++)
+      {
+      const SceneActor &description = this->Actors[a];
+      vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+      actor->SetMapper(this->Mappers[description.Source]);
+      if (description.Property >= 0)
+        {
+        actor->SetProperty(this->BuiltProperties[description.Property]);
+        }
+      actor->SetPosition(description.Position[0], description.Position[1], description.Position[2]);
+      actor->SetOrientation(description.Orientation[0], description.Orientation[1], description.Orientation[2]);
+      actor->SetScale(description.Scale[0], description.Scale[1], description.Scale[2]);
+      if (renderer)
+        {
+        renderer->AddActor(actor);
+        }
+      this->BuiltActors[a] = actor;
+      }
+
+    this->BuiltCues.resize(this->Cues.size());
+    for (size_t c = 0; c < this->Cues.size(); c++)
+      {
+      vtkSmartPointer<vtkAnimationCue> cue = vtkSmartPointer<vtkAnimationCue>::New();
+      cue->SetStartTime(this->Cues[c].StartTime);
+      cue->SetEndTime(this->Cues[c].EndTime);
+      if (this->CueTimeline)
+        {
+        this->CueTimeline->AddCue(cue);
+        }
+      else if (scene)
+        {
+        scene->AddCue(cue);
+        }
+      this->BuiltCues[c] = cue;
+      }
+
+    ActorAnimator::GetObserverPool().Reserve(this->Animations.size());
+    this->Animators.reserve(this->Animations.size());
+    for (size_t i = 0; i < this->Animations.size(); i++)
+      {
+      const SceneAnimation &description = this->Animations[i];
+      ActorAnimator *animator = new ActorAnimator;
+      animator->SetActor(this->BuiltActors[description.Actor]);
+      animator->SetStartPosition(description.From);
+      animator->SetEndPosition(description.To);
+      animator->SetAngularVelocity(description.AngularVelocity);
+      animator->SetRenderScheduler(this->Scheduler);
+      animator->AddObserversToCue(this->BuiltCues[description.Cue]);
+      this->Animators.push_back(animator);
+      }
+    }
+
+  // Built objects, valid until the next Build or Read.
+  vtkActor *GetActor(size_t index)        { return this->BuiltActors[index]; }
+  vtkAnimationCue *GetCue(size_t index)   { return this->BuiltCues[index]; }
+
+  // The mesh an actor draws, updated on first access; for intersection
+  // and picking, which need the geometry before the first render.
+  vtkPolyData *GetPolyData(size_t actorIndex)
+    {
+    vtkPolyDataAlgorithm *source = this->Algorithms[this->Actors[actorIndex].Source];
+    source->Update();
+    return source->GetOutput();
+    }
+
+  // Drops the description, not what was built from it.
+  void Clear()
+    {
+    this->Sources.clear();
+    this->SourceIndex.clear();
+    this->Properties.clear();
+    this->Actors.clear();
+    this->Cues.clear();
+    this->Animations.clear();
+    this->NumberOfSourceDeclarations = 0;
+    }
+
+protected:
+  // Keyword argument of a source: Count values stored from Offset.
+  struct SourceParameter
+    {
+    const char * Key;
+    int          Offset;
+    int          Count;
+    };
+
+  struct SourceTypeInfo
+    {
+    const char *     Name;
+    double           Defaults[8];
+    SourceParameter  Parameters[4];
+    };
+
+  static const SourceTypeInfo &GetSourceTypeInfo(int type)
+    {
+    static const SourceTypeInfo types[NUMBER_OF_SOURCE_TYPES] =
+      {
+      {"sphere",   {0, 0, 0, 0.5, 8, 8},
+                   {{"center", 0, 3}, {"radius", 3, 1}, {"phi", 4, 1}, {"theta", 5, 1}}},
+      {"cylinder", {0, 0, 0, 0.5, 1, 6},
+                   {{"center", 0, 3}, {"radius", 3, 1}, {"height", 4, 1}, {"resolution", 5, 1}}},
+      {"cone",     {0, 0, 0, 0.5, 1, 6},
+                   {{"center", 0, 3}, {"radius", 3, 1}, {"height", 4, 1}, {"resolution", 5, 1}}},
+      {"cube",     {0, 0, 0, 1, 1, 1},
+                   {{"center", 0, 3}, {"size", 3, 3}, {0, 0, 0}, {0, 0, 0}}},
+      {"polygon",  {0, 0, 0, 0.5, 6},
+                   {{"center", 0, 3}, {"radius", 3, 1}, {"sides", 4, 1}, {0, 0, 0}}},
+      };
+    return types[type];
+    }
+
+  static vtkSmartPointer<vtkPolyDataAlgorithm> NewSource(const SceneSource &source)
+    {
+    const double *p = source.Parameters;
+    switch (source.Type)
+      {
+      case SPHERE:
+        {
+        vtkSmartPointer<vtkSphereSource> sphere = vtkSmartPointer<vtkSphereSource>::New();
+        sphere->SetCenter(p[0], p[1], p[2]);
+        sphere->SetRadius(p[3]);
+        sphere->SetPhiResolution(static_cast<int>(p[4]));
+        sphere->SetThetaResolution(static_cast<int>(p[5]));
+        return sphere;
+        }
+      case CYLINDER:
+        {
+        vtkSmartPointer<vtkCylinderSource> cylinder = vtkSmartPointer<vtkCylinderSource>::New();
+        cylinder->SetCenter(p[0], p[1], p[2]);
+        cylinder->SetRadius(p[3]);
+        cylinder->SetHeight(p[4]);
+        cylinder->SetResolution(static_cast<int>(p[5]));
+        return cylinder;
+        }
+      case CONE:
+        {
+        vtkSmartPointer<vtkConeSource> cone = vtkSmartPointer<vtkConeSource>::New();
+        cone->SetCenter(p[0], p[1], p[2]);
+        cone->SetRadius(p[3]);
+        cone->SetHeight(p[4]);
+        cone->SetResolution(static_cast<int>(p[5]));
+        return cone;
+        }
+      case CUBE:
+        {
+        vtkSmartPointer<vtkCubeSource> cube = vtkSmartPointer<vtkCubeSource>::New();
+        cube->SetCenter(p[0], p[1], p[2]);
+        cube->SetXLength(p[3]);
+        cube->SetYLength(p[4]);
+        cube->SetZLength(p[5]);
+        return cube;
+        }
+      default:
+        {
+        vtkSmartPointer<vtkRegularPolygonSource> polygon = vtkSmartPointer<vtkRegularPolygonSource>::New();
+        polygon->SetCenter(p[0], p[1], p[2]);
+        polygon->SetRadius(p[3]);
+        polygon->SetNumberOfSides(static_cast<int>(p[4]));
+        return polygon;
+        }
+      }
+    }
+
+  // FNV-1a over the type and parameters, with -0 taken as 0 so that
+  // equal values hash equally.
+  static unsigned long long HashSource(const SceneSource &source)
+    {
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&source.Type);
+    for (size_t i = 0; i < sizeof(source.Type); i++)
+      {
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+      }
+    for (int k = 0; k < 8; k++)
+      {
+      double value = source.Parameters[k] == 0.0 ? 0.0 : source.Parameters[k];
+      bytes = reinterpret_cast<const unsigned char*>(&value);
+      for (size_t i = 0; i < sizeof(value); i++)
+        {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+      }
+    return hash;
+    }
+
+  // Index of the geometry for a source, adding it if no equal one exists.
+  int AddSource(const SceneSource &source)
+    {
+    this->NumberOfSourceDeclarations++;
+    unsigned long long hash = HashSource(source);
+    std::pair<SourceMap::iterator, SourceMap::iterator> range = this->SourceIndex.equal_range(hash);
+    for (SourceMap::iterator i = range.first; i != range.second; ++i)
+      {
+      const SceneSource &other = this->Sources[i->second];
+      bool equal = other.Type == source.Type;
+      for (int k = 0; k < 8 && equal; k++)
+        {
+        equal = other.Parameters[k] == source.Parameters[k];
+        }
+      if (equal)
+        {
+        return i->second;
+        }
+      }
+    int index = static_cast<int>(this->Sources.size());
+    this->Sources.push_back(source);
+    this->Sources.back().Reserved = 0;
+    this->SourceIndex.insert(std::make_pair(hash, index));
+    return index;
+    }
+
+  template <class Record>
+  static bool WriteRecords(FILE *file, const std::vector<Record> &records)
+    {
+    return records.empty() ||
+           fwrite(&records[0], sizeof(Record), records.size(), file) == records.size();
+    }
+
+  template <class Record>
+  static const char *ReadRecords(const char *data, unsigned int count, std::vector<Record> &records)
+    {
+    records.resize(count);
+    if (count)
+      {
+      memcpy(&records[0], data, count * sizeof(Record));
+      }
+    return data + count * sizeof(Record);
+    }
+
+  bool ParseBinary(const char *data, size_t size)
+    {
+    SceneFileHeader header;
+    if (size < sizeof(header))
+      {
+      this->ErrorMessage = "truncated header";
+      return false;
+      }
+    memcpy(&header, data, sizeof(header));
+    if (header.Version != SceneFileVersion)
+      {
+      this->ErrorMessage = "unsupported version";
+      return false;
+      }
+    unsigned long long expected = sizeof(header) +
+      header.NumberOfSources * static_cast<unsigned long long>(sizeof(SceneSource)) +
+      header.NumberOfProperties * static_cast<unsigned long long>(sizeof(SceneProperty)) +
+      header.NumberOfActors * static_cast<unsigned long long>(sizeof(SceneActor)) +
+      header.NumberOfCues * static_cast<unsigned long long>(sizeof(SceneCue)) +
+      header.NumberOfAnimations * static_cast<unsigned long long>(sizeof(SceneAnimation));
+    if (size < expected)
+      {
+      this->ErrorMessage = "truncated records";
+      return false;
+      }
+
+    // Sources go through AddSource too, since the file may repeat one.
+    std::vector<SceneSource> sources;
+    const char *next = ReadRecords(data + sizeof(header), header.NumberOfSources, sources);
+    std::vector<int> remap(sources.size());
+    for (size_t s = 0; s < sources.size(); s++)
+      {
+      if (sources[s].Type < 0 || sources[s].Type >= NUMBER_OF_SOURCE_TYPES)
+        {
+        this->ErrorMessage = "bad source type";
+        return false;
+        }
+      remap[s] = this->AddSource(sources[s]);
+      }
+    next = ReadRecords(next, header.NumberOfProperties, this->Properties);
+    next = ReadRecords(next, header.NumberOfActors, this->Actors);
+    next = ReadRecords(next, header.NumberOfCues, this->Cues);
+    ReadRecords(next, header.NumberOfAnimations, this->Animations);
+
+    for (size_t a = 0; a < this->Actors.size(); a++)
+      {
+      SceneActor &actor = this->Actors[a];
+      if (actor.Source < 0 || actor.Source >= static_cast<int>(remap.size()) ||
+          actor.Property < -1 || actor.Property >= static_cast<int>(this->Properties.size()))
+        {
+        this->ErrorMessage = "bad actor reference";
+        return false;
+        }
+      actor.Source = remap[actor.Source];
+      }
+    for (size_t i = 0; i < this->Animations.size(); i++)
+      {
+      const SceneAnimation &animation = this->Animations[i];
+      if (animation.Actor < 0 || animation.Actor >= static_cast<int>(this->Actors.size()) ||
+          animation.Cue < 0 || animation.Cue >= static_cast<int>(this->Cues.size()))
+        {
+        this->ErrorMessage = "bad animation reference";
+        return false;
+        }
+      }
+    return true;
+    }
+
+  // Splits [begin, end) on whitespace into Tokens, stopping at '#'.
+  void Tokenize(const char *begin, const char *end)
+    {
+    this->Tokens.clear();
+    const char *p = begin;
+    while (p < end)
+      {
+      while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        {
+        p++;
+        }
+      if (p == end || *p == '#')
+        {
+        break;
+        }
+      const char *start = p;
+      while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+        {
+        p++;
+        }
+      this->Tokens.push_back(std::string(start, p));
+      }
+    }
+
+  // Reads count numbers from the tokens after index i into values.
+  bool ReadNumbers(size_t &i, int count, double *values)
+    {
+    for (int k = 0; k < count; k++)
+      {
+      if (++i >= this->Tokens.size())
+        {
+        return false;
+        }
+      const char *token = this->Tokens[i].c_str();
+      char *end;
+      values[k] = strtod(token, &end);
+      if (end == token || *end)
+        {
+        return false;
+        }
+      }
+    return true;
+    }
+
+  bool ParseText(const char *text, size_t size)
+    {
+    std::map<std::string, int> sourceNames, propertyNames, actorNames, cueNames;
+    const char *end = text + size;
+    int line = 0;
+    for (const char *p = text; p < end; line++)
+      {
+      const char *lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+      if (!lineEnd)
+        {
+        lineEnd = end;
+        }
+      this->Tokenize(p, lineEnd);
+      this->ErrorDetail.clear();
+      p = lineEnd + 1;
+      if (this->Tokens.empty())
+        {
+        continue;
+        }
+      const std::string &keyword = this->Tokens[0];
+      bool ok = true;
+      if (keyword == "source" && this->Tokens.size() >= 3)
+        {
+        ok = this->ParseSource(sourceNames);
+        }
+      else if (keyword == "property" && this->Tokens.size() >= 2)
+        {
+        ok = this->ParseProperty(propertyNames);
+        }
+      else if (keyword == "actor" && this->Tokens.size() >= 3)
+        {
+        ok = this->ParseActor(sourceNames, propertyNames, actorNames);
+        }
+      else if (keyword == "cue" && this->Tokens.size() == 4)
+        {
+        SceneCue cue;
+        size_t i = 1;
+        ok = this->ReadNumbers(i, 1, &cue.StartTime) && this->ReadNumbers(i, 1, &cue.EndTime);
+        cueNames[this->Tokens[1]] = static_cast<int>(this->Cues.size());
+        this->Cues.push_back(cue);
+        }
+      else if (keyword == "animate" && this->Tokens.size() >= 3)
+        {
+        ok = this->ParseAnimation(actorNames, cueNames);
+        }
+      else
+        {
+        ok = false;
+        }
+      if (!ok)
+        {
+        char number[32];
+        snprintf(number, sizeof(number), "%d", line + 1);
+        this->ErrorMessage = std::string("line ") + number + ": cannot parse '" + keyword + "'";
+        if (!this->ErrorDetail.empty())
+          {
+          this->ErrorMessage += ", " + this->ErrorDetail;
+          }
+        return false;
+        }
+      }
+    return true;
+    }
+
+  static int FindName(const std::map<std::string, int> &names, const std::string &name)
+    {
+    std::map<std::string, int>::const_iterator i = names.find(name);
+    return i == names.end() ? -1 : i->second;
+    }
+
+  bool ParseSource(std::map<std::string, int> &names)
+    {
+    SceneSource source;
+    memset(&source, 0, sizeof(source));
+    source.Type = -1;
+    for (int t = 0; t < NUMBER_OF_SOURCE_TYPES; t++)
+      {
+      if (this->Tokens[2] == GetSourceTypeInfo(t).Name)
+        {
+        source.Type = t;
+        }
+      }
+    if (source.Type < 0)
+      {
+      this->ErrorDetail = "unknown source type " + this->Tokens[2];
+      return false;
+      }
+    const SourceTypeInfo &info = GetSourceTypeInfo(source.Type);
+    memcpy(source.Parameters, info.Defaults, sizeof(source.Parameters));
+    for (size_t i = 3; i < this->Tokens.size(); i++)
+      {
+      const SourceParameter *parameter = 0;
+      for (int k = 0; k < 4 && info.Parameters[k].Key; k++)
+        {
+        if (this->Tokens[i] == info.Parameters[k].Key)
+          {
+          parameter = &info.Parameters[k];
+          }
+        }
+      if (!parameter)
+        {
+        this->ErrorDetail = "unknown argument " + this->Tokens[i];
+        return false;
+        }
+      if (!this->ReadNumbers(i, parameter->Count, source.Parameters + parameter->Offset))
+        {
+        return false;
+        }
+      }
+    names[this->Tokens[1]] = this->AddSource(source);
+    return true;
+    }
+
+  bool ParseProperty(std::map<std::string, int> &names)
+    {
+    SceneProperty property;
+    memset(&property, 0, sizeof(property));
+    property.Color[0] = property.Color[1] = property.Color[2] = 1.0;
+    property.Opacity = 1.0;
+    for (size_t i = 2; i < this->Tokens.size(); i++)
+      {
+      const std::string &key = this->Tokens[i];
+      bool ok = true;
+      if (key == "color")
+        {
+        ok = this->ReadNumbers(i, 3, property.Color);
+        }
+      else if (key == "opacity")
+        {
+        ok = this->ReadNumbers(i, 1, &property.Opacity);
+        }
+      else if (key == "flat")
+        {
+        property.Flat = 1;
+        }
+      else
+        {
+        this->ErrorDetail = "unknown argument " + key;
+        return false;
+        }
+      if (!ok)
+        {
+        return false;
+        }
+      }
+    names[this->Tokens[1]] = static_cast<int>(this->Properties.size());
+    this->Properties.push_back(property);
+    return true;
+    }
+
+  bool ParseActor(const std::map<std::string, int> &sourceNames,
+                  const std::map<std::string, int> &propertyNames,
+                  std::map<std::string, int> &names)
+    {
+    SceneActor actor;
+    memset(&actor, 0, sizeof(actor));
+    actor.Source = FindName(sourceNames, this->Tokens[2]);
+    actor.Property = -1;
+    actor.Scale[0] = actor.Scale[1] = actor.Scale[2] = 1.0;
+    if (actor.Source < 0)
+      {
+      this->ErrorDetail = "unknown source " + this->Tokens[2];
+      return false;
+      }
+    for (size_t i = 3; i < this->Tokens.size(); i++)
+      {
+      const std::string &key = this->Tokens[i];
+      bool ok = true;
+      if (key == "property" && i + 1 < this->Tokens.size())
+        {
+        actor.Property = FindName(propertyNames, this->Tokens[++i]);
+        if (actor.Property < 0)
+          {
+          this->ErrorDetail = "unknown property " + this->Tokens[i];
+          return false;
+          }
+        }
+      else if (key == "position")
+        {
+        ok = this->ReadNumbers(i, 3, actor.Position);
+        }
+      else if (key == "orientation")
+        {
+        ok = this->ReadNumbers(i, 3, actor.Orientation);
+        }
+      else if (key == "scale")
+        {
+        ok = this->ReadNumbers(i, 3, actor.Scale);
+        }
+      else
+        {
+        this->ErrorDetail = "unknown argument " + key;
+        return false;
+        }
+      if (!ok)
+        {
+        return false;
+        }
+      }
+    names[this->Tokens[1]] = static_cast<int>(this->Actors.size());
+    this->Actors.push_back(actor);
+    return true;
+    }
+
+  bool ParseAnimation(const std::map<std::string, int> &actorNames,
+                      const std::map<std::string, int> &cueNames)
+    {
+    SceneAnimation animation;
+    memset(&animation, 0, sizeof(animation));
+    animation.Actor = FindName(actorNames, this->Tokens[1]);
+    animation.Cue = FindName(cueNames, this->Tokens[2]);
+    // ActorAnimator's defaults.
+    animation.To[0] = animation.To[1] = animation.To[2] = 0.5;
+    animation.AngularVelocity = 20.0;
+    if (animation.Actor < 0 || animation.Cue < 0)
+      {
+      this->ErrorDetail = animation.Actor < 0 ? "unknown actor " + this->Tokens[1]
+                                              : "unknown cue " + this->Tokens[2];
+      return false;
+      }
+    for (size_t i = 3; i < this->Tokens.size(); i++)
+      {
+      const std::string &key = this->Tokens[i];
+      bool ok = true;
+      if (key == "from")
+        {
+        ok = this->ReadNumbers(i, 3, animation.From);
+        }
+      else if (key == "to")
+        {
+        ok = this->ReadNumbers(i, 3, animation.To);
+        }
+      else if (key == "velocity")
+        {
+        ok = this->ReadNumbers(i, 1, &animation.AngularVelocity);
+        }
+      else
+        {
+        this->ErrorDetail = "unknown argument " + key;
+        return false;
+        }
+      if (!ok)
+        {
+        return false;
+        }
+      }
+    this->Animations.push_back(animation);
+    return true;
+    }
+
+  void ClearBuilt()
+    {
+    for (size_t i = 0; i < this->Animators.size(); i++)
+      {
+      delete this->Animators[i];
+      }
+    this->Animators.clear();
+    this->BuiltActors.clear();
+    this->BuiltCues.clear();
+    this->BuiltProperties.clear();
+    this->Mappers.clear();
+    this->Algorithms.clear();
+    }
+
+  typedef std::unordered_multimap<unsigned long long, int> SourceMap;
+
+  std::vector<SceneSource>                          Sources;
+  SourceMap                                         SourceIndex;
+  std::vector<SceneProperty>                        Properties;
+  std::vector<SceneActor>                           Actors;
+  std::vector<SceneCue>                             Cues;
+  std::vector<SceneAnimation>                       Animations;
+  size_t                                            NumberOfSourceDeclarations;
+  std::vector<std::string>                          Tokens;
+  std::string                                       ErrorMessage;
+  std::string                                       ErrorDetail;
+
+  RenderScheduler *                                 Scheduler;
+  CueScheduler *                                    CueTimeline;
+  std::vector<vtkSmartPointer<vtkPolyDataAlgorithm> > Algorithms;
+  std::vector<vtkSmartPointer<vtkPolyDataMapper> >  Mappers;
+  std::vector<vtkSmartPointer<vtkProperty> >        BuiltProperties;
+  std::vector<vtkSmartPointer<vtkActor> >           BuiltActors;
+  std::vector<vtkSmartPointer<vtkAnimationCue> >    BuiltCues;
+  std::vector<ActorAnimator*>                       Animators;
+};
+
+#endif
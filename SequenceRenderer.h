@@ -0,0 +1,392 @@
+#ifndef __SequenceRenderer_h
+#define __SequenceRenderer_h
+#include <vtkAnimationScene.h>
+#include <vtkImageData.h>
+#include <vtkPNGWriter.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameProfiler.h"
+
+// One captured RGB frame, bottom row first as returned by the render window.
+struct SequenceFrame
+{
+  int                        Index;
+  int                        Width;
+  int                        Height;
+  std::vector<unsigned char> Pixels;
+};
+
+// Writes frames to disk on a pool of worker threads.
+// Frames go through a bounded queue: Push blocks when the queue is full so
+// memory stays bounded, and the time it blocks is the time the renderer was
+// stalled by encoding. Workers record the time they waited for a frame,
+// which is the time encoding was stalled by rendering.
+class FrameExporter
+{
+public:
+  enum
+    {
+    PNG = 0,
+    RAW
+    };
+
+  FrameExporter()
+    {
+    this->Format = PNG;
+    this->Directory = ".";
+    this->Prefix = "frame";
+    this->NumberOfThreads = std::thread::hardware_concurrency();
+    if (this->NumberOfThreads < 1)
+      {
+      this->NumberOfThreads = 1;
+      }
+    this->QueueSize = 2 * this->NumberOfThreads;
+    this->Done = false;
+    this->ResetStatistics();
+    }
+
+  ~FrameExporter()
+    {
+    this->Finish();
+    for (size_t i = 0; i < this->FreeFrames.size(); i++)
+      {
+      delete this->FreeFrames[i];
+      }
+    }
+
+  void SetDirectory(const std::string &directory) { this->Directory = directory; }
+  void SetPrefix(const std::string &prefix)       { this->Prefix = prefix; }
+  // PNG goes through vtkPNGWriter. RAW writes binary PPM files (raw RGB
+  // behind a short text header), which costs no compression at all.
+  void SetFormat(int format)                      { this->Format = format; }
+  void SetFormatToPNG()                           { this->Format = PNG; }
+  void SetFormatToRAW()                           { this->Format = RAW; }
+  void SetNumberOfThreads(int threads)            { this->NumberOfThreads = threads > 0 ? threads : 1; }
+  void SetQueueSize(size_t size)                  { this->QueueSize = size > 0 ? size : 1; }
+
+  void Start()
+    {
+    this->Finish();
+    this->Done = false;
+    for (int i = 0; i < this->NumberOfThreads; i++)
+      {
+      this->Workers.push_back(std::thread(&FrameExporter::Work, this));
+      }
+    }
+
+  // Returns a frame buffer to fill, reusing the buffers of frames already
+  // written so the pixel storage is not reallocated for every frame.
+  SequenceFrame *AcquireFrame()
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (this->FreeFrames.empty())
+      {
+      return new SequenceFrame;
+      }
+    SequenceFrame *frame = this->FreeFrames.back();
+    this->FreeFrames.pop_back();
+    return frame;
+    }
+
+  // Queues a frame for writing. The exporter takes the frame back once it
+  // is written.
+  void Push(SequenceFrame *frame)
+    {
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    if (this->Queue.size() >= this->QueueSize)
+      {
+      double start = vtkTimerLog::GetUniversalTime();
+      this->NotFull.wait(lock, [this]{ return this->Queue.size() < this->QueueSize; });
+      this->ProducerStallTime += vtkTimerLog::GetUniversalTime() - start;
+      }
+    this->Queue.push_back(frame);
+    this->NotEmpty.notify_one();
+    }
+
+  // Writes out everything still queued and stops the workers.
+  void Finish()
+    {
+    if (this->Workers.empty())
+      {
+      return;
+      }
+      {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Done = true;
+      }
+    this->NotEmpty.notify_all();
+    for (size_t i = 0; i < this->Workers.size(); i++)
+      {
+      this->Workers[i].join();
+      }
+    this->Workers.clear();
+    }
+
+  void ResetStatistics()
+    {
+    this->ProducerStallTime = 0;
+    this->WorkerStallTime = 0;
+    this->EncodeTime = 0;
+    this->NumberOfFramesWritten = 0;
+    this->NumberOfErrors = 0;
+    }
+
+  // Time Push spent waiting for room in the queue.
+  double GetProducerStallTime() const { return this->ProducerStallTime; }
+  // Time the workers spent waiting for a frame, summed over all workers.
+  double GetWorkerStallTime() const   { return this->WorkerStallTime; }
+  // Time spent encoding and writing, summed over all workers.
+  double GetEncodeTime() const        { return this->EncodeTime; }
+  int GetNumberOfFramesWritten() const { return this->NumberOfFramesWritten; }
+  int GetNumberOfErrors() const       { return this->NumberOfErrors; }
+
+protected:
+  void Work()
+    {
+    double stalled = 0;
+    double encoding = 0;
+    int written = 0;
+    int errors = 0;
+    for (;;)
+      {
+      SequenceFrame *frame = 0;
+        {
+        std::unique_lock<std::mutex> lock(this->Mutex);
+        double start = vtkTimerLog::GetUniversalTime();
+        this->NotEmpty.wait(lock, [this]{ return this->Done || !this->Queue.empty(); });
+        stalled += vtkTimerLog::GetUniversalTime() - start;
+        if (this->Queue.empty())
+          {
+          break;
+          }
+        frame = this->Queue.front();
+        this->Queue.pop_front();
+        }
+      this->NotFull.notify_one();
+
+      double start = vtkTimerLog::GetUniversalTime();
+      if (this->Write(frame))
+        {
+        written++;
+        }
+      else
+        {
+        errors++;
+        }
+      encoding += vtkTimerLog::GetUniversalTime() - start;
+
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->FreeFrames.push_back(frame);
+      }
+
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->WorkerStallTime += stalled;
+    this->EncodeTime += encoding;
+    this->NumberOfFramesWritten += written;
+    this->NumberOfErrors += errors;
+    }
+
+  bool Write(SequenceFrame *frame)
+    {
+    char name[32];
+    snprintf(name, sizeof(name), "_%05d.%s", frame->Index,
+             this->Format == PNG ? "png" : "ppm");
+    std::string fileName = this->Directory + "/" + this->Prefix + name;
+
+    if (this->Format == PNG)
+      {
+      vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+      image->SetDimensions(frame->Width, frame->Height, 1);
+#if VTK_MAJOR_VERSION <= 5
+      image->SetScalarTypeToUnsignedChar();
+      image->SetNumberOfScalarComponents(3);
+      image->AllocateScalars();
+#else
+      image->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+#endif
+      memcpy(image->GetScalarPointer(), &frame->Pixels[0], frame->Pixels.size());
+      vtkSmartPointer<vtkPNGWriter> writer = vtkSmartPointer<vtkPNGWriter>::New();
+      writer->SetFileName(fileName.c_str());
+#if VTK_MAJOR_VERSION <= 5
+      writer->SetInput(image);
+#else
+      writer->SetInputData(image);
+#endif
+      writer->Write();
+      // Set when the file cannot be opened or the disk fills up.
+      return writer->GetErrorCode() == 0;
+      }
+
+    FILE *file = fopen(fileName.c_str(), "wb");
+    if (!file)
+      {
+      return false;
+      }
+    fprintf(file, "P6\n%d %d\n255\n", frame->Width, frame->Height);
+    // PPM is stored top row first.
+    size_t rowSize = 3 * static_cast<size_t>(frame->Width);
+    bool ok = true;
+    for (int row = frame->Height - 1; row >= 0 && ok; row--)
+      {
+      ok = fwrite(&frame->Pixels[row * rowSize], 1, rowSize, file) == rowSize;
+      }
+    return fclose(file) == 0 && ok;
+    }
+
+  int                          Format;
+  std::string                  Directory;
+  std::string                  Prefix;
+  int                          NumberOfThreads;
+  size_t                       QueueSize;
+  bool                         Done;
+  std::vector<std::thread>     Workers;
+  std::deque<SequenceFrame*>   Queue;
+  std::vector<SequenceFrame*>  FreeFrames;
+  std::mutex                   Mutex;
+  std::condition_variable      NotEmpty;
+  std::condition_variable      NotFull;
+  double                       ProducerStallTime;
+  double                       WorkerStallTime;
+  double                       EncodeTime;
+  int                          NumberOfFramesWritten;
+  int                          NumberOfErrors;
+};
+
+// Plays a vtkAnimationScene frame by frame without an interactor.
+// Frame i is ticked at exactly StartTime + i / FrameRate, so the output does
+// not depend on how fast the machine is. Each frame is rendered, read back
+// and handed to the FrameExporter, whose workers encode it while the next
+// frame renders. The render window should be set to offscreen rendering,
+// and the scene should not also have an AnimationSceneObserver rendering
+// on every tick.
+class SequenceRenderer
+{
+public:
+  SequenceRenderer()
+    {
+    this->Scene = 0;
+    this->RenderWindow = 0;
+    this->Exporter = 0;
+    this->NumberOfFrames = 0;
+    this->TotalTime = 0;
+    this->TickTime = 0;
+    this->RenderTime = 0;
+    this->CaptureTime = 0;
+    this->Pixels = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    }
+
+  void SetScene(vtkAnimationScene *scene)            { this->Scene = scene; }
+  void SetRenderWindow(vtkRenderWindow *renderWindow) { this->RenderWindow = renderWindow; }
+  void SetExporter(FrameExporter *exporter)          { this->Exporter = exporter; }
+
+  void Run()
+    {
+    double startTime = this->Scene->GetStartTime();
+    double endTime = this->Scene->GetEndTime();
+    double frameRate = this->Scene->GetFrameRate();
+    int frames = static_cast<int>((endTime - startTime) * frameRate + 0.5) + 1;
+
+    this->NumberOfFrames = 0;
+    this->TickTime = this->RenderTime = this->CaptureTime = 0;
+    if (this->Exporter)
+      {
+      this->Exporter->ResetStatistics();
+      this->Exporter->Start();
+      }
+
+    double begin = vtkTimerLog::GetUniversalTime();
+    this->Scene->SetModeToSequence();
+    this->Scene->Initialize();
+    for (int i = 0; i < frames; i++)
+      {
+      double time = i + 1 < frames ? startTime + i / frameRate : endTime;
+      double t0 = vtkTimerLog::GetUniversalTime();
+      this->Scene->Tick(time, i ? 1.0 / frameRate : 0.0, time);
+      double t1 = vtkTimerLog::GetUniversalTime();
+        {
+        FRAME_PROFILE_SCOPE("SequenceRenderer Render");
+        this->RenderWindow->Render();
+        }
+      double t2 = vtkTimerLog::GetUniversalTime();
+      if (this->Exporter)
+        {
+        FRAME_PROFILE_SCOPE("SequenceRenderer Capture");
+        this->Capture(i);
+        }
+      double t3 = vtkTimerLog::GetUniversalTime();
+      FrameProfiler::GetInstance().EndFrame();
+      this->TickTime += t1 - t0;
+      this->RenderTime += t2 - t1;
+      this->CaptureTime += t3 - t2;
+      this->NumberOfFrames++;
+      }
+    this->Scene->Finalize();
+    if (this->Exporter)
+      {
+      this->Exporter->Finish();
+      }
+    this->TotalTime = vtkTimerLog::GetUniversalTime() - begin;
+    }
+
+  int GetNumberOfFrames() const { return this->NumberOfFrames; }
+  double GetFramesPerSecond() const
+    {
+    return this->TotalTime > 0 ? this->NumberOfFrames / this->TotalTime : 0.0;
+    }
+
+  void PrintStatistics(ostream &os)
+    {
+    os << "frames: " << this->NumberOfFrames
+       << " in " << this->TotalTime << " s, "
+       << this->GetFramesPerSecond() << " fps" << endl;
+    os << "tick: " << this->TickTime << " s, render: " << this->RenderTime
+       << " s, capture: " << this->CaptureTime << " s" << endl;
+    if (this->Exporter)
+      {
+      os << "render stalled on export: " << this->Exporter->GetProducerStallTime()
+         << " s, export stalled on render: " << this->Exporter->GetWorkerStallTime()
+         << " s (all workers), encode: " << this->Exporter->GetEncodeTime()
+         << " s (all workers), written: " << this->Exporter->GetNumberOfFramesWritten()
+         << ", errors: " << this->Exporter->GetNumberOfErrors() << endl;
+      }
+    }
+
+protected:
+  void Capture(int index)
+    {
+    int *size = this->RenderWindow->GetSize();
+    SequenceFrame *frame = this->Exporter->AcquireFrame();
+    frame->Index = index;
+    frame->Width = size[0];
+    frame->Height = size[1];
+    this->RenderWindow->GetPixelData(0, 0, size[0] - 1, size[1] - 1, 0, this->Pixels);
+    frame->Pixels.resize(3 * static_cast<size_t>(size[0]) * size[1]);
+    memcpy(&frame->Pixels[0], this->Pixels->GetPointer(0), frame->Pixels.size());
+    this->Exporter->Push(frame);
+    }
+
+  vtkAnimationScene *                   Scene;
+  vtkRenderWindow *                     RenderWindow;
+  FrameExporter *                       Exporter;
+  vtkSmartPointer<vtkUnsignedCharArray> Pixels;
+  int                                   NumberOfFrames;
+  double                                TotalTime;
+  double                                TickTime;
+  double                                RenderTime;
+  double                                CaptureTime;
+};
+
+#endif
@@ -0,0 +1,565 @@
+#ifndef __SimulationThread_h
+#define __SimulationThread_h
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+#include <vtkRenderWindow.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "Animation.h"
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+#include "KeyframeTrack.h"
+#include "RenderScheduler.h"
+#include "TripleBuffer.h"
+
+// Runs a set of ActorAnimators on a thread of their own at a fixed
+// timestep, apart from the thread that ticks the scene, renders and
+// handles interaction. Every step the simulation thread evaluates the
+// matrix of every animator for the step's time (steps are due every
+// 1 / StepsPerSecond seconds of the clock since Start) and publishes the
+// whole set as one snapshot through a TripleBuffer. Apply, on the main
+// thread, takes the newest snapshot and commits it to the actors; neither
+// side ever waits for the other, so a slow render no longer holds the
+// animation back and a heavy step no longer holds up interaction.
+//
+// With interpolation on (the default) the actors are shown one step
+// behind the clock, between the last two snapshots: positions and scales
+// are interpolated linearly and rotations along the shortest arc, so the
+// motion is smooth at any frame rate. Otherwise the newest snapshot is
+// shown as it is.
+//
+// A simulation thread that falls more than a step behind skips to the
+// step due rather than running the missed ones, since the poses depend on
+// time alone. Apply is called on every cue tick and, once
+// AddObserversToRenderWindow was called, before every render. At the end
+// of the cue the thread is stopped and every actor set to its exact final
+// pose.
+//
+// While the thread runs nothing else may tick the animators or change
+// their motion, and animators cannot be added.
+class ThreadedActorAnimator
+{
+public:
+  ThreadedActorAnimator()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->Scheduler = 0;
+    this->Step = 1.0 / 60.0;
+    this->Interpolate = true;
+    this->Duration = 0.0;
+    this->Stopping.store(false);
+    this->HasCurrent = false;
+    this->HasPrevious = false;
+    this->LastU = -1.0;
+    this->ResetCounters();
+    }
+
+  ~ThreadedActorAnimator()
+    {
+    this->StopSimulation();
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // The animators are not owned.
+  void AddAnimator(ActorAnimator *animator)
+    {
+    this->Animators.push_back(animator);
+    }
+  void RemoveAllAnimators()
+    {
+    this->Animators.clear();
+    }
+  size_t GetNumberOfAnimators() const
+    {
+    return this->Animators.size();
+    }
+
+  // Rate of the fixed timestep, 60 by default. Takes effect on the next
+  // start.
+  void SetStepsPerSecond(double rate)
+    {
+    this->Step = rate > 0.0 ? 1.0 / rate : this->Step;
+    }
+  double GetStep() const
+    {
+    return this->Step;
+    }
+
+  void SetInterpolate(bool interpolate)
+    {
+    this->Interpolate = interpolate;
+    }
+
+  // Asked for a render whenever Apply moves the actors from a cue tick.
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+
+  // Starts the simulation thread at time 0 of a run lasting duration
+  // seconds, stopping the previous run first.
+  void StartSimulation(double duration)
+    {
+    this->StopSimulation();
+    this->Duration = duration;
+    const size_t n = 16 * this->Animators.size();
+    for (int i = 0; i < 3; i++)
+      {
+      Snapshot &snapshot = this->Buffer.GetBuffer(i);
+      snapshot.Matrices.assign(n, 0.0);
+      }
+    this->Current.Matrices.assign(n, 0.0);
+    this->Previous.Matrices.assign(n, 0.0);
+    this->Blended.assign(n, 0.0);
+    // The last snapshot of a previous run may still be marked new.
+    this->Buffer.Acquire();
+    this->HasCurrent = false;
+    this->HasPrevious = false;
+    this->LastU = -1.0;
+    this->ResetCounters();
+    this->Origin = std::chrono::steady_clock::now();
+    this->Thread = std::thread(&ThreadedActorAnimator::Simulate, this);
+    }
+
+  // Waits for the simulation thread to stop, at most about one step.
+  void StopSimulation()
+    {
+    if (!this->Thread.joinable())
+      {
+      return;
+      }
+    this->Stopping.store(true, std::memory_order_release);
+    this->Thread.join();
+    this->Stopping.store(false, std::memory_order_relaxed);
+    }
+
+  bool IsRunning() const
+    {
+    return this->Thread.joinable();
+    }
+
+  // Commits the newest snapshot, or the interpolation due now, to the
+  // actors. Returns true when they moved. Main thread only.
+  bool Apply()
+    {
+    FRAME_PROFILE_SCOPE("ThreadedActorAnimator::Apply");
+    double now = this->Now();
+    bool fresh = this->Buffer.Acquire();
+    if (fresh)
+      {
+      std::swap(this->Previous, this->Current);
+      this->Current = this->Buffer.GetReadBuffer();
+      this->HasPrevious = this->HasCurrent;
+      this->HasCurrent = true;
+      this->NumberOfSnapshotsApplied++;
+      }
+    if (!this->HasCurrent)
+      {
+      return false;
+      }
+    const double *matrices = this->Current.Matrices.empty() ? 0 : &this->Current.Matrices[0];
+    double shown = this->Current.Time;
+    if (this->Interpolate && this->HasPrevious && this->Current.Time > this->Previous.Time)
+      {
+      double u = (now - this->Step - this->Previous.Time) / (this->Current.Time - this->Previous.Time);
+      u = std::min(1.0, std::max(0.0, u));
+      if (!fresh && u == this->LastU)
+        {
+        return false;
+        }
+      this->LastU = u;
+      for (size_t a = 0; a < this->Animators.size(); a++)
+        {
+        InterpolateMatrix(&this->Previous.Matrices[16 * a], &this->Current.Matrices[16 * a], u,
+                          &this->Blended[16 * a]);
+        }
+      matrices = this->Blended.empty() ? 0 : &this->Blended[0];
+      shown = this->Previous.Time + u * (this->Current.Time - this->Previous.Time);
+      }
+    else if (!fresh)
+      {
+      return false;
+      }
+    for (size_t a = 0; a < this->Animators.size(); a++)
+      {
+      this->Animators[a]->Commit(matrices + 16 * a);
+      }
+
+    // How far the poses shown trail the clock, and how regularly they
+    // are shown.
+    double latency = now - shown;
+    this->NumberOfApplies++;
+    this->LatencySum += latency;
+    this->LatencySquareSum += latency * latency;
+    this->MaximumLatency = std::max(this->MaximumLatency, latency);
+    if (this->LastApply >= 0.0)
+      {
+      double interval = now - this->LastApply;
+      this->NumberOfIntervals++;
+      this->IntervalSum += interval;
+      this->IntervalSquareSum += interval * interval;
+      this->MaximumInterval = std::max(this->MaximumInterval, interval);
+      }
+    this->LastApply = now;
+    return true;
+    }
+
+  void ResetCounters()
+    {
+    this->NumberOfSnapshotsApplied = 0;
+    this->NumberOfApplies = 0;
+    this->LatencySum = 0.0;
+    this->LatencySquareSum = 0.0;
+    this->MaximumLatency = 0.0;
+    this->NumberOfIntervals = 0;
+    this->IntervalSum = 0.0;
+    this->IntervalSquareSum = 0.0;
+    this->MaximumInterval = 0.0;
+    this->LastApply = -1.0;
+    }
+
+  // Simulation thread statistics, as of the newest snapshot applied.
+  unsigned long GetNumberOfSteps() const
+    {
+    return this->HasCurrent ? this->Current.Steps : 0;
+    }
+  // Steps skipped because the thread woke too late for them.
+  unsigned long GetNumberOfDroppedSteps() const
+    {
+    return this->HasCurrent ? this->Current.DroppedSteps : 0;
+    }
+  // Snapshots published but replaced before Apply took them.
+  unsigned long GetNumberOfOverwrittenSnapshots() const
+    {
+    return this->HasCurrent ? this->Current.Overwritten : 0;
+    }
+  // Standard deviation and maximum, in seconds, of how late steps ran.
+  double GetStepJitter() const
+    {
+    return this->HasCurrent ?
+      Deviation(this->Current.Steps, this->Current.LatenessSum, this->Current.LatenessSquareSum) : 0.0;
+    }
+  double GetMaximumStepLateness() const
+    {
+    return this->HasCurrent ? this->Current.MaximumLateness : 0.0;
+    }
+
+  // Main thread statistics, in seconds.
+  unsigned long GetNumberOfApplies() const
+    {
+    return this->NumberOfApplies;
+    }
+  unsigned long GetNumberOfSnapshotsApplied() const
+    {
+    return this->NumberOfSnapshotsApplied;
+    }
+  double GetMeanLatency() const
+    {
+    return this->NumberOfApplies ? this->LatencySum / this->NumberOfApplies : 0.0;
+    }
+  // Standard deviation of the latency: how unevenly the motion shown
+  // keeps up with the clock.
+  double GetLatencyJitter() const
+    {
+    return Deviation(this->NumberOfApplies, this->LatencySum, this->LatencySquareSum);
+    }
+  double GetMaximumLatency() const
+    {
+    return this->MaximumLatency;
+    }
+  // Standard deviation of the time between applies.
+  double GetApplyJitter() const
+    {
+    return Deviation(this->NumberOfIntervals, this->IntervalSum, this->IntervalSquareSum);
+    }
+
+  void PrintStatistics(ostream &os)
+    {
+    os << "simulation: " << this->GetNumberOfSteps() << " steps of " << 1000.0 * this->Step
+       << " ms, dropped: " << this->GetNumberOfDroppedSteps()
+       << ", overwritten: " << this->GetNumberOfOverwrittenSnapshots()
+       << ", step jitter: " << 1000.0 * this->GetStepJitter()
+       << " ms, latest step: " << 1000.0 * this->GetMaximumStepLateness() << " ms" << endl;
+    os << "display: " << this->NumberOfApplies << " applies of "
+       << this->NumberOfSnapshotsApplied << " snapshots, latency: "
+       << 1000.0 * this->GetMeanLatency() << " ms, jitter: " << 1000.0 * this->GetLatencyJitter()
+       << " ms, max: " << 1000.0 * this->MaximumLatency << " ms, interval jitter: "
+       << 1000.0 * this->GetApplyJitter() << " ms" << endl;
+    }
+
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    }
+
+  // Applies the newest poses before every render, including those made
+  // by interaction between ticks.
+  void AddObserversToRenderWindow(vtkRenderWindow *renderWindow)
+    {
+    renderWindow->AddObserver(vtkCommand::StartEvent,this->Observer);
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    this->StartSimulation(info->EndTime - info->StartTime);
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    if (this->Apply() && this->Scheduler)
+      {
+      this->Scheduler->RequestRender();
+      }
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    this->StopSimulation();
+    // Nothing left over may be applied over the final poses.
+    this->Buffer.Acquire();
+    this->HasPrevious = false;
+    for (size_t a = 0; a < this->Animators.size(); a++)
+      {
+      this->Animators[a]->End(info);
+      }
+    }
+
+  // Row-major matrices made of a translation, a rotation and a positive
+  // scale along the rotated axes, as ActorAnimator composes them.
+  static void InterpolateMatrix(const double *m0, const double *m1, double u, double *m)
+    {
+    if (u <= 0.0 || u >= 1.0)
+      {
+      std::copy(u <= 0.0 ? m0 : m1, (u <= 0.0 ? m0 : m1) + 16, m);
+      return;
+      }
+    double q0[4], q1[4], q[4], scale0[3], scale1[3];
+    Decompose(m0, q0, scale0);
+    Decompose(m1, q1, scale1);
+    KeyframeTrack::Slerp(q0, q1, u, q);
+    double w = q[0], x = q[1], y = q[2], z = q[3];
+    double r[9] =
+      {
+      1 - 2 * (y * y + z * z), 2 * (x * y - w * z),     2 * (x * z + w * y),
+      2 * (x * y + w * z),     1 - 2 * (x * x + z * z), 2 * (y * z - w * x),
+      2 * (x * z - w * y),     2 * (y * z + w * x),     1 - 2 * (x * x + y * y)
+      };
+    for (int i = 0; i < 3; i++)
+      {
+      for (int j = 0; j < 3; j++)
+        {
+        m[4 * i + j] = r[3 * i + j] * (scale0[j] + u * (scale1[j] - scale0[j]));
+        }
+      m[4 * i + 3] = m0[4 * i + 3] + u * (m1[4 * i + 3] - m0[4 * i + 3]);
+      }
+    m[12] = m[13] = m[14] = 0.0;
+    m[15] = 1.0;
+    }
+
+protected:
+  struct Snapshot
+    {
+    Snapshot()
+      {
+      this->Time = 0.0;
+      this->Steps = this->DroppedSteps = this->Overwritten = 0;
+      this->LatenessSum = this->LatenessSquareSum = this->MaximumLateness = 0.0;
+      }
+    // Simulation time of the poses.
+    double              Time;
+    // 16 per animator.
+    std::vector<double> Matrices;
+    // Statistics of the simulation thread up to this snapshot, carried
+    // along so reading them needs nothing shared.
+    unsigned long       Steps;
+    unsigned long       DroppedSteps;
+    unsigned long       Overwritten;
+    double              LatenessSum;
+    double              LatenessSquareSum;
+    double              MaximumLateness;
+    };
+
+  // Seconds since the start of the run.
+  double Now() const
+    {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - this->Origin).count();
+    }
+
+  static double Deviation(unsigned long count, double sum, double squareSum)
+    {
+    if (count < 2)
+      {
+      return 0.0;
+      }
+    double mean = sum / count;
+    return sqrt(std::max(0.0, squareSum / count - mean * mean));
+    }
+
+  // Rotation as a unit quaternion (w, x, y, z) and the column lengths.
+  static void Decompose(const double *m, double q[4], double scale[3])
+    {
+    double r[9];
+    for (int j = 0; j < 3; j++)
+      {
+      scale[j] = sqrt(m[j] * m[j] + m[4 + j] * m[4 + j] + m[8 + j] * m[8 + j]);
+      for (int i = 0; i < 3; i++)
+        {
+        r[3 * i + j] = scale[j] > 0.0 ? m[4 * i + j] / scale[j] : (i == j ? 1.0 : 0.0);
+        }
+      }
+    double trace = r[0] + r[4] + r[8];
+    if (trace > 0.0)
+      {
+      double s = 0.5 / sqrt(trace + 1.0);
+      q[0] = 0.25 / s;
+      q[1] = (r[7] - r[5]) * s;
+      q[2] = (r[2] - r[6]) * s;
+      q[3] = (r[3] - r[1]) * s;
+      }
+    else if (r[0] > r[4] && r[0] > r[8])
+      {
+      double s = 2.0 * sqrt(1.0 + r[0] - r[4] - r[8]);
+      q[0] = (r[7] - r[5]) / s;
+      q[1] = 0.25 * s;
+      q[2] = (r[1] + r[3]) / s;
+      q[3] = (r[2] + r[6]) / s;
+      }
+    else if (r[4] > r[8])
+      {
+      double s = 2.0 * sqrt(1.0 + r[4] - r[0] - r[8]);
+      q[0] = (r[2] - r[6]) / s;
+      q[1] = (r[1] + r[3]) / s;
+      q[2] = 0.25 * s;
+      q[3] = (r[5] + r[7]) / s;
+      }
+    else
+      {
+      double s = 2.0 * sqrt(1.0 + r[8] - r[0] - r[4]);
+      q[0] = (r[3] - r[1]) / s;
+      q[1] = (r[2] + r[6]) / s;
+      q[2] = (r[5] + r[7]) / s;
+      q[3] = 0.25 * s;
+      }
+    KeyframeTrack::NormalizeQuaternion(q);
+    }
+
+  // The simulation thread.
+  void Simulate()
+    {
+    const size_t n = this->Animators.size();
+    unsigned long steps = 0, dropped = 0, overwritten = 0;
+    double latenessSum = 0.0, latenessSquareSum = 0.0, maximumLateness = 0.0;
+    long next = 0;
+    while (!this->Stopping.load(std::memory_order_acquire))
+      {
+      double due = next * this->Step;
+      double now = this->Now();
+      if (now < due)
+        {
+        std::this_thread::sleep_until(this->Origin +
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(due)));
+        continue;
+        }
+      FRAME_PROFILE_SCOPE("ThreadedActorAnimator step");
+      double lateness = now - due;
+      long step = std::max(next, static_cast<long>(now / this->Step));
+      dropped += step - next;
+      double time = std::min(step * this->Step, this->Duration);
+      Snapshot &snapshot = this->Buffer.GetWriteBuffer();
+      for (size_t a = 0; a < n; a++)
+        {
+        this->Animators[a]->EvaluateMatrix(time, this->Duration, &snapshot.Matrices[16 * a]);
+        }
+      steps++;
+      latenessSum += lateness;
+      latenessSquareSum += lateness * lateness;
+      maximumLateness = std::max(maximumLateness, lateness);
+      snapshot.Time = time;
+      snapshot.Steps = steps;
+      snapshot.DroppedSteps = dropped;
+      snapshot.Overwritten = overwritten;
+      snapshot.LatenessSum = latenessSum;
+      snapshot.LatenessSquareSum = latenessSquareSum;
+      snapshot.MaximumLateness = maximumLateness;
+      if (this->Buffer.Publish())
+        {
+        overwritten++;
+        }
+      next = step + 1;
+      if (time >= this->Duration)
+        {
+        break;
+        }
+      }
+    }
+
+  // The cue events go through AnimationCueAdapter; the render window's
+  // StartEvent applies the latest snapshot.
+  class AnimationCueObserver : public AnimationCueAdapter<ThreadedActorAnimator>
+  {
+  public:
+    static AnimationCueObserver *New()
+      {
+      return new AnimationCueObserver;
+      }
+
+    virtual void Execute(vtkObject *caller,
+                         unsigned long event,
+                         void *calldata)
+      {
+      if(event != vtkCommand::StartEvent)
+        {
+        this->AnimationCueAdapter<ThreadedActorAnimator>::Execute(caller, event, calldata);
+        }
+      else if(this->Animator != 0)
+        {
+        this->Animator->Apply();
+        }
+      }
+  };
+
+  AnimationCueObserver *                 Observer;
+  RenderScheduler *                      Scheduler;
+  std::vector<ActorAnimator*>            Animators;
+  double                                 Step;
+  bool                                   Interpolate;
+  double                                 Duration;
+
+  // Shared with the simulation thread.
+  std::thread                            Thread;
+  std::atomic<bool>                      Stopping;
+  std::chrono::steady_clock::time_point  Origin;
+  TripleBuffer<Snapshot>                 Buffer;
+
+  // Main thread only.
+  Snapshot                               Current;
+  Snapshot                               Previous;
+  bool                                   HasCurrent;
+  bool                                   HasPrevious;
+  std::vector<double>                    Blended;
+  double                                 LastU;
+  unsigned long                          NumberOfSnapshotsApplied;
+  unsigned long                          NumberOfApplies;
+  double                                 LatencySum;
+  double                                 LatencySquareSum;
+  double                                 MaximumLatency;
+  unsigned long                          NumberOfIntervals;
+  double                                 IntervalSum;
+  double                                 IntervalSquareSum;
+  double                                 MaximumInterval;
+  double                                 LastApply;
+};
+
+#endif
@@ -0,0 +1,365 @@
+#ifndef __TemplateAnimator_h
+#define __TemplateAnimator_h
+#include <vtkActor.h>
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+
+#include <tuple>
+#include <vector>
+
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+#include "RenderScheduler.h"
+
+// Easing curves mapping normalized time 0..1 onto 0..1. They are
+// constexpr, so they fold away for constant arguments and inline into the
+// tick loop otherwise.
+struct EaseLinear
+{
+  template <class T> static constexpr T Apply(T t)
+    {
+    return t;
+    }
+};
+
+struct EaseSmoothStep
+{
+  template <class T> static constexpr T Apply(T t)
+    {
+    return t * t * (T(3) - T(2) * t);
+    }
+};
+
+struct EaseInCubic
+{
+  template <class T> static constexpr T Apply(T t)
+    {
+    return t * t * t;
+    }
+};
+
+struct EaseOutCubic
+{
+  template <class T> static constexpr T Apply(T t)
+    {
+    return T(1) - (T(1) - t) * (T(1) - t) * (T(1) - t);
+    }
+};
+
+struct EaseInOutCubic
+{
+  template <class T> static constexpr T Apply(T t)
+    {
+    return t < T(0.5) ? T(4) * t * t * t
+                      : T(1) - T(4) * (T(1) - t) * (T(1) - t) * (T(1) - t);
+    }
+};
+
+static_assert(EaseSmoothStep::Apply(0.5) == 0.5, "smoothstep is symmetric");
+static_assert(EaseInOutCubic::Apply(1.0) == 1.0 && EaseOutCubic::Apply(0.0) == 0.0,
+              "easing curves keep their end points");
+
+// Animated channels of an actor: three components each, with the value an
+// actor has when the channel is not animated and how to hand the value to
+// the actor.
+struct PositionChannel
+{
+  static constexpr double Default() { return 0.0; }
+  static void Apply(vtkActor *actor, double x, double y, double z)
+    {
+    actor->SetPosition(x, y, z);
+    }
+};
+
+// Orientation as angles in degrees about X, Y and Z, as vtkProp3D uses.
+struct RotationChannel
+{
+  static constexpr double Default() { return 0.0; }
+  static void Apply(vtkActor *actor, double x, double y, double z)
+    {
+    actor->SetOrientation(x, y, z);
+    }
+};
+
+struct ScaleChannel
+{
+  static constexpr double Default() { return 1.0; }
+  static void Apply(vtkActor *actor, double x, double y, double z)
+    {
+    actor->SetScale(x, y, z);
+    }
+};
+
+// Animates many actors from one cue, like BatchActorAnimator, with the
+// choices made at compile time: T is the value type (float or double),
+// Easing one of the Ease* curves above and Channels any of
+// PositionChannel, RotationChannel and ScaleChannel.
+//
+// Every item goes from a start to an end value per channel, starting
+// Delay into the cue and taking Duration, both as fractions of the cue.
+// A tick first eases the local time of every item into one array, then
+// lerps every channel component from it; both loops run over plain
+// arrays of T with the easing inlined, so the compiler vectorizes them.
+// Items may have no actor, in which case only the values are computed
+// (see GetValues), e.g. to fill an instancing buffer.
+//
+//   TemplateActorAnimator<float, EaseSmoothStep, PositionChannel, ScaleChannel> a;
+//   size_t i = a.AddItem(actor);
+//   a.Set<PositionChannel>(i, start, end);
+template <class T, class Easing, class... Channels>
+class TemplateActorAnimator
+{
+public:
+  typedef TemplateActorAnimator<T, Easing, Channels...> Self;
+
+  TemplateActorAnimator()
+    {
+    this->Observer = AnimationCueAdapter<Self>::New();
+    this->Observer->Animator = this;
+    this->Scheduler = 0;
+    this->HasActors = false;
+    }
+
+  ~TemplateActorAnimator()
+    {
+    this->RemoveAllItems();
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // Adds an item and returns its index. Every channel starts and ends at
+  // its default value until Set.
+  size_t AddItem(vtkActor *actor = 0, double delay = 0.0, double duration = 1.0)
+    {
+    if (actor)
+      {
+      actor->Register(0);
+      this->HasActors = true;
+      }
+    this->Actors.push_back(actor);
+    this->Delay.push_back(static_cast<T>(delay));
+    this->Rate.push_back(static_cast<T>(duration > 0.0 ? 1.0 / duration : 1.0e30));
+    this->Eased.push_back(T(0));
+    int expand[] = { 0, (this->template Data<Channels>().Add(), 0)... };
+    (void)expand;
+    return this->Actors.size() - 1;
+    }
+
+  void RemoveAllItems()
+    {
+    for (size_t i = 0; i < this->Actors.size(); i++)
+      {
+      if (this->Actors[i])
+        {
+        this->Actors[i]->UnRegister(0);
+        }
+      }
+    this->Actors.clear();
+    this->Delay.clear();
+    this->Rate.clear();
+    this->Eased.clear();
+    this->HasActors = false;
+    int expand[] = { 0, (this->template Data<Channels>().Clear(), 0)... };
+    (void)expand;
+    }
+
+  // Reserves storage so that adding items does not reallocate.
+  void Reserve(size_t count)
+    {
+    this->Actors.reserve(count);
+    this->Delay.reserve(count);
+    this->Rate.reserve(count);
+    this->Eased.reserve(count);
+    int expand[] = { 0, (this->template Data<Channels>().Reserve(count), 0)... };
+    (void)expand;
+    }
+
+  size_t GetNumberOfItems() const
+    {
+    return this->Actors.size();
+    }
+
+  template <class Channel>
+  void Set(size_t index, const double start[3], const double end[3])
+    {
+    ChannelData<Channel> &data = this->template Data<Channel>();
+    for (int c = 0; c < 3; c++)
+      {
+      data.Start[c][index] = static_cast<T>(start[c]);
+      data.Delta[c][index] = static_cast<T>(end[c] - start[c]);
+      }
+    }
+
+  // Values of one component of a channel for all items, from the last
+  // Evaluate.
+  template <class Channel>
+  const T *GetValues(int component)
+    {
+    ChannelData<Channel> &data = this->template Data<Channel>();
+    return data.Value[component].empty() ? 0 : &data.Value[component][0];
+    }
+
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    }
+
+  // Computes every channel at normalized cue time t (0..1) without
+  // touching the actors.
+  void Evaluate(T t)
+    {
+    const size_t n = this->Actors.size();
+    if (!n)
+      {
+      return;
+      }
+    const T *delay = &this->Delay[0];
+    const T *rate = &this->Rate[0];
+    T *eased = &this->Eased[0];
+    for (size_t i = 0; i < n; i++)
+      {
+      T u = (t - delay[i]) * rate[i];
+      u = u < T(0) ? T(0) : u;
+      u = u > T(1) ? T(1) : u;
+      eased[i] = Easing::Apply(u);
+      }
+    int expand[] = { 0, (this->template Data<Channels>().Lerp(eased, n), 0)... };
+    (void)expand;
+    }
+
+  // Hands the last evaluated values to the actors.
+  void Apply()
+    {
+    if (!this->HasActors)
+      {
+      return;
+      }
+    int expand[] = { 0, (this->template ApplyChannel<Channels>(), 0)... };
+    (void)expand;
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    this->Evaluate(T(0));
+    this->Apply();
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    FRAME_PROFILE_SCOPE("TemplateActorAnimator::Tick");
+    double duration = info->EndTime - info->StartTime;
+    this->Evaluate(static_cast<T>(duration > 0 ?
+                                  (info->AnimationTime - info->StartTime) / duration : 0.0));
+    this->Apply();
+    if (this->Scheduler)
+      {
+      this->Scheduler->RequestRender();
+      }
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *vtkNotUsed(info))
+    {
+    this->Evaluate(T(1));
+    this->Apply();
+    }
+
+protected:
+  // Structure of arrays for one channel.
+  template <class Channel>
+  struct ChannelData
+    {
+    void Add()
+      {
+      for (int c = 0; c < 3; c++)
+        {
+        this->Start[c].push_back(static_cast<T>(Channel::Default()));
+        this->Delta[c].push_back(T(0));
+        this->Value[c].push_back(static_cast<T>(Channel::Default()));
+        }
+      }
+    void Clear()
+      {
+      for (int c = 0; c < 3; c++)
+        {
+        this->Start[c].clear();
+        this->Delta[c].clear();
+        this->Value[c].clear();
+        }
+      }
+    void Reserve(size_t count)
+      {
+      for (int c = 0; c < 3; c++)
+        {
+        this->Start[c].reserve(count);
+        this->Delta[c].reserve(count);
+        this->Value[c].reserve(count);
+        }
+      }
+    void Lerp(const T *eased, size_t n)
+      {
+      for (int c = 0; c < 3; c++)
+        {
+        const T *start = &this->Start[c][0];
+        const T *delta = &this->Delta[c][0];
+        T *value = &this->Value[c][0];
+        for (size_t i = 0; i < n; i++)
+          {
+          value[i] = start[i] + delta[i] * eased[i];
+          }
+        }
+      }
+    std::vector<T> Start[3];
+    std::vector<T> Delta[3];
+    std::vector<T> Value[3];
+    };
+
+  // Position of Channel in Channels.
+  template <class Channel, class... List> struct IndexOf;
+  template <class Channel, class... List>
+  struct IndexOf<Channel, Channel, List...>
+    {
+    enum { value = 0 };
+    };
+  template <class Channel, class Other, class... List>
+  struct IndexOf<Channel, Other, List...>
+    {
+    enum { value = 1 + IndexOf<Channel, List...>::value };
+    };
+
+  template <class Channel>
+  ChannelData<Channel> &Data()
+    {
+    return std::get<IndexOf<Channel, Channels...>::value>(this->ChannelSet);
+    }
+
+  template <class Channel>
+  void ApplyChannel()
+    {
+    ChannelData<Channel> &data = this->template Data<Channel>();
+    for (size_t i = 0; i < this->Actors.size(); i++)
+      {
+      if (this->Actors[i])
+        {
+        Channel::Apply(this->Actors[i], data.Value[0][i], data.Value[1][i], data.Value[2][i]);
+        }
+      }
+    }
+
+  AnimationCueAdapter<Self> *            Observer;
+  RenderScheduler *                      Scheduler;
+  std::vector<vtkActor*>                 Actors;
+  std::vector<T>                         Delay;
+  std::vector<T>                         Rate;
+  std::vector<T>                         Eased;
+  std::tuple<ChannelData<Channels>...>   ChannelSet;
+  bool                                   HasActors;
+};
+
+#endif
@@ -0,0 +1,414 @@
+#ifndef __TessellationCache_h
+#define __TessellationCache_h
+#include <vtkAnimationCue.h>
+#include <vtkCommand.h>
+#include <vtkPolyData.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "FrameProfiler.h"
+
+// Parameters of a vtkSphereSource that decide its tessellation.
+struct TessellationKey
+{
+  double Center[3];
+  double Radius;
+  int    PhiResolution;
+  int    ThetaResolution;
+
+  bool operator<(const TessellationKey &other) const
+    {
+    if (this->PhiResolution != other.PhiResolution)
+      {
+      return this->PhiResolution < other.PhiResolution;
+      }
+    if (this->ThetaResolution != other.ThetaResolution)
+      {
+      return this->ThetaResolution < other.ThetaResolution;
+      }
+    if (this->Radius != other.Radius)
+      {
+      return this->Radius < other.Radius;
+      }
+    return std::lexicographical_compare(this->Center, this->Center + 3,
+                                        other.Center, other.Center + 3);
+    }
+  bool operator==(const TessellationKey &other) const
+    {
+    return !(*this < other) && !(other < *this);
+    }
+};
+
+// Keeps tessellated levels of a sphere so the resolution slider does not
+// re-tessellate on the interaction thread.
+// Request() shows a cached level at once by shallow copying it into the
+// output. A missing level is generated by a background thread while the
+// output keeps showing the last level; Poll() (called from an interactor
+// timer, see AddObserversToInteractor, and on every tick of a scene, see
+// AddObserversToCue) shows it once it is ready. Only the
+// latest request is kept, so dragging over many values only generates the
+// value the slider stops on, plus the one in progress.
+// Levels are evicted least recently used first when their total size goes
+// over the memory budget. The cache itself is only touched on the main
+// thread; the worker only builds polydata.
+class TessellationCache
+{
+public:
+  TessellationCache()
+    {
+    this->Source = 0;
+    this->Output = vtkSmartPointer<vtkPolyData>::New();
+    this->MemoryBudget = 64 * 1024;
+    this->MemorySize = 0;
+    this->HasShown = false;
+    this->HasRequested = false;
+    this->HasPending = false;
+    this->HasInFlight = false;
+    this->Done = false;
+    this->Observer = TimerObserver::New();
+    this->Observer->Cache = this;
+    this->ResetCounters();
+    }
+
+  ~TessellationCache()
+    {
+      {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Done = true;
+      }
+    this->WorkAvailable.notify_all();
+    if (this->Worker.joinable())
+      {
+      this->Worker.join();
+      }
+    for (size_t i = 0; i < this->Finished.size(); i++)
+      {
+      this->Finished[i].second->Delete();
+      }
+    for (LevelMap::iterator level = this->Levels.begin(); level != this->Levels.end(); ++level)
+      {
+      level->second.Data->Delete();
+      }
+    this->Observer->Cache = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // Center and radius are taken from this source when a level is
+  // requested; its own resolution is not used.
+  void SetSource(vtkSphereSource *source) { this->Source = source; }
+
+  // The polydata to render. Levels are shallow copied into it, so mappers
+  // and filters connected to it follow the level changes.
+  vtkPolyData *GetOutput() { return this->Output; }
+
+  // In kilobytes, as returned by vtkPolyData::GetActualMemorySize.
+  void SetMemoryBudget(unsigned long kilobytes)
+    {
+    this->MemoryBudget = kilobytes;
+    this->Evict();
+    }
+  unsigned long GetMemoryBudget() const { return this->MemoryBudget; }
+  unsigned long GetMemorySize() const   { return this->MemorySize; }
+  int GetNumberOfLevels() const         { return static_cast<int>(this->Levels.size()); }
+
+  // Shows the level right away if it is cached and returns true. Otherwise
+  // schedules it and returns false; the output keeps the current level.
+  bool Request(int phiResolution, int thetaResolution)
+    {
+    this->Collect();
+    TessellationKey key = this->MakeKey(phiResolution, thetaResolution);
+    this->Requested = key;
+    this->HasRequested = true;
+    if (this->Show(key))
+      {
+      this->NumberOfHits++;
+      return true;
+      }
+    this->NumberOfMisses++;
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (this->HasInFlight && this->InFlight == key)
+      {
+      this->HasPending = false;
+      return false;
+      }
+    this->Pending = key;
+    this->HasPending = true;
+    if (!this->Worker.joinable())
+      {
+      this->Worker = std::thread(&TessellationCache::Work, this);
+      }
+    this->WorkAvailable.notify_one();
+    return false;
+    }
+
+  // Generates the level on the calling thread if needed and shows it. Used
+  // for the first level, before there is anything to keep on screen.
+  void Load(int phiResolution, int thetaResolution)
+    {
+    TessellationKey key = this->MakeKey(phiResolution, thetaResolution);
+    this->Requested = key;
+    this->HasRequested = true;
+    if (!this->Show(key))
+      {
+      this->Insert(key, this->Generate(key));
+      this->Show(key);
+      }
+    }
+
+  // Moves levels finished by the worker into the cache. Returns true if
+  // the output changed, i.e. the requested level became available.
+  bool Poll()
+    {
+    if (!this->Collect() || !this->HasRequested)
+      {
+      return false;
+      }
+    bool changed = !this->HasShown || !(this->Shown == this->Requested);
+    return this->Show(this->Requested) && changed;
+    }
+
+  // Polls every interval milliseconds from the interactor's timer and
+  // renders when a requested level came in. The interactor must have been
+  // initialized, or the timer is never created.
+  void AddObserversToInteractor(vtkRenderWindowInteractor *interactor, int interval = 50)
+    {
+    interactor->AddObserver(vtkCommand::TimerEvent, this->Observer);
+    interactor->CreateRepeatingTimer(interval);
+    }
+
+  // Polls on every tick of the cue, typically the scene, since a playing
+  // scene does not return to the interactor's event loop. No render is
+  // issued; a RenderScheduler watching the output picks the change up.
+  // The priority runs it before the scene's render observers.
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent, this->Observer, 0.5);
+    }
+
+  void ResetCounters()
+    {
+    this->NumberOfHits = 0;
+    this->NumberOfMisses = 0;
+    this->NumberOfEvictions = 0;
+    this->GenerateTime = 0;
+    }
+
+  // Requests answered from the cache.
+  unsigned long GetNumberOfHits() const      { return this->NumberOfHits; }
+  // Requests that had to wait for the worker.
+  unsigned long GetNumberOfMisses() const    { return this->NumberOfMisses; }
+  unsigned long GetNumberOfEvictions() const { return this->NumberOfEvictions; }
+  // Seconds spent tessellating, on any thread.
+  double GetGenerateTime()
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    return this->GenerateTime;
+    }
+
+protected:
+  struct Level
+    {
+    vtkPolyData *                        Data;
+    unsigned long                        Size;
+    std::list<TessellationKey>::iterator Use;
+    };
+  typedef std::map<TessellationKey, Level> LevelMap;
+
+  TessellationKey MakeKey(int phiResolution, int thetaResolution) const
+    {
+    TessellationKey key;
+    key.Center[0] = key.Center[1] = key.Center[2] = 0.0;
+    key.Radius = 0.5;
+    if (this->Source)
+      {
+      this->Source->GetCenter(key.Center);
+      key.Radius = this->Source->GetRadius();
+      }
+    key.PhiResolution = phiResolution;
+    key.ThetaResolution = thetaResolution;
+    return key;
+    }
+
+  // Inserts the levels finished by the worker, returns false if there were
+  // none.
+  bool Collect()
+    {
+    std::vector<std::pair<TessellationKey, vtkPolyData*> > finished;
+      {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      finished.swap(this->Finished);
+      }
+    for (size_t i = 0; i < finished.size(); i++)
+      {
+      this->Insert(finished[i].first, finished[i].second);
+      }
+    return !finished.empty();
+    }
+
+  // Runs on any thread: builds the level with its own source so nothing is
+  // shared with the rendered pipeline.
+  vtkPolyData *Generate(const TessellationKey &key)
+    {
+    FRAME_PROFILE_SCOPE("TessellationCache::Generate");
+    double start = vtkTimerLog::GetUniversalTime();
+    vtkSmartPointer<vtkSphereSource> source = vtkSmartPointer<vtkSphereSource>::New();
+    source->SetCenter(key.Center[0], key.Center[1], key.Center[2]);
+    source->SetRadius(key.Radius);
+    source->SetPhiResolution(key.PhiResolution);
+    source->SetThetaResolution(key.ThetaResolution);
+    source->Update();
+    vtkPolyData *data = vtkPolyData::New();
+    data->ShallowCopy(source->GetOutput());
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->GenerateTime += elapsed;
+    return data;
+    }
+
+  void Work()
+    {
+    for (;;)
+      {
+      TessellationKey key;
+        {
+        std::unique_lock<std::mutex> lock(this->Mutex);
+        this->WorkAvailable.wait(lock, [this]{ return this->Done || this->HasPending; });
+        if (this->Done)
+          {
+          break;
+          }
+        key = this->Pending;
+        this->HasPending = false;
+        this->InFlight = key;
+        this->HasInFlight = true;
+        }
+      vtkPolyData *data = this->Generate(key);
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Finished.push_back(std::make_pair(key, data));
+      this->HasInFlight = false;
+      }
+    }
+
+  // Shows a cached level and marks it most recently used.
+  bool Show(const TessellationKey &key)
+    {
+    LevelMap::iterator level = this->Levels.find(key);
+    if (level == this->Levels.end())
+      {
+      return false;
+      }
+    this->Uses.splice(this->Uses.begin(), this->Uses, level->second.Use);
+    if (!this->HasShown || !(this->Shown == key))
+      {
+      this->Output->ShallowCopy(level->second.Data);
+      this->Shown = key;
+      this->HasShown = true;
+      }
+    return true;
+    }
+
+  void Insert(const TessellationKey &key, vtkPolyData *data)
+    {
+    LevelMap::iterator existing = this->Levels.find(key);
+    if (existing != this->Levels.end())
+      {
+      data->Delete();
+      return;
+      }
+    this->Uses.push_front(key);
+    Level level;
+    level.Data = data;
+    level.Size = data->GetActualMemorySize();
+    level.Use = this->Uses.begin();
+    this->Levels[key] = level;
+    this->MemorySize += level.Size;
+    this->Evict();
+    }
+
+  // Drops least recently used levels until the budget is met. The most
+  // recently used level is always kept, even if it alone is over budget;
+  // the output shares its arrays anyway.
+  void Evict()
+    {
+    while (this->MemorySize > this->MemoryBudget && this->Uses.size() > 1)
+      {
+      LevelMap::iterator level = this->Levels.find(this->Uses.back());
+      this->MemorySize -= level->second.Size;
+      level->second.Data->Delete();
+      this->Levels.erase(level);
+      this->Uses.pop_back();
+      this->NumberOfEvictions++;
+      }
+    }
+
+  class TimerObserver : public vtkCommand
+  {
+  public:
+    static TimerObserver *New()
+      {
+      return new TimerObserver;
+      }
+
+    virtual void Execute(vtkObject *caller,
+                         unsigned long vtkNotUsed(event),
+                         void *vtkNotUsed(calldata))
+      {
+      if (this->Cache != 0 && this->Cache->Poll())
+        {
+        vtkRenderWindowInteractor *interactor = vtkRenderWindowInteractor::SafeDownCast(caller);
+        if (interactor && interactor->GetRenderWindow())
+          {
+          interactor->GetRenderWindow()->Render();
+          }
+        }
+      }
+
+    TimerObserver()
+      {
+      this->Cache = 0;
+      }
+    TessellationCache *Cache;
+  };
+
+  vtkSphereSource *            Source;
+  vtkSmartPointer<vtkPolyData> Output;
+  TimerObserver *              Observer;
+  LevelMap                     Levels;
+  // Most recently used first.
+  std::list<TessellationKey>   Uses;
+  unsigned long                MemoryBudget;
+  unsigned long                MemorySize;
+  TessellationKey              Shown;
+  bool                         HasShown;
+  TessellationKey              Requested;
+  bool                         HasRequested;
+  unsigned long                NumberOfHits;
+  unsigned long                NumberOfMisses;
+  unsigned long                NumberOfEvictions;
+
+  // Shared with the worker, guarded by Mutex.
+  std::thread                  Worker;
+  std::mutex                   Mutex;
+  std::condition_variable      WorkAvailable;
+  TessellationKey              Pending;
+  bool                         HasPending;
+  TessellationKey              InFlight;
+  bool                         HasInFlight;
+  bool                         Done;
+  std::vector<std::pair<TessellationKey, vtkPolyData*> > Finished;
+  double                       GenerateTime;
+};
+
+#endif
@@ -4,6 +4,13 @@
 #include "vtkCommand.h"
 #include "vtkRenderWindowInteractor.h"
 #include "vtkActor.h"
+#include "vtkMatrix4x4.h"
+#include "vtkSmartPointer.h"
+#include "vtkTimerLog.h"
+
+#include <cmath>
+
+#include "AsyncLogger.h"
 
 class vtkTimerCallback2 : public vtkCommand
 {
@@ -12,6 +19,11 @@ class vtkTimerCallback2 : public vtkCommand
     {
       vtkTimerCallback2 *cb = new vtkTimerCallback2;
       cb->TimerCount = 0;
+      cb->LogLimit.SetInterval(1000.0);
+      cb->AngularVelocity = 20.0;
+      cb->StartTime = -1.0;
+      cb->Matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      cb->Initial = vtkSmartPointer<vtkMatrix4x4>::New();
       return cb;
     }
  
@@ -22,15 +34,46 @@ class vtkTimerCallback2 : public vtkCommand
         {
         ++this->TimerCount;
         }
-      std::cout << this->TimerCount << std::endl;
+      AsyncLogger::GetInstance().Log(this->LogLimit, AsyncLogger::LOG_DEBUG,
+                                     "timer tick %g", this->TimerCount);
       //actor->SetPosition(this->TimerCount, this->TimerCount,0);
-	  actor->RotateX(2.0);
+      // The angle follows the time since the first tick rather than the
+      // number of ticks, so late or dropped timer events do not slow the
+      // spin down. The actor's transform on the first tick is kept and the
+      // rotation about its own X axis is appended to it.
+      double now = vtkTimerLog::GetUniversalTime();
+      if (this->StartTime < 0)
+        {
+        this->StartTime = now;
+        actor->GetMatrix(this->Initial);
+        actor->SetPosition(0, 0, 0);
+        actor->SetOrientation(0, 0, 0);
+        actor->SetScale(1.0);
+        actor->SetOrigin(0, 0, 0);
+        actor->SetUserMatrix(this->Matrix);
+        }
+      double angle = this->AngularVelocity * (now - this->StartTime) * 3.14159265358979323846 / 180.0;
+      double c = cos(angle), s = sin(angle);
+      double rotation[16] = {1, 0, 0, 0,
+                             0, c, -s, 0,
+                             0, s, c, 0,
+                             0, 0, 0, 1};
+      vtkMatrix4x4::Multiply4x4(&this->Initial->Element[0][0], rotation, &this->Matrix->Element[0][0]);
+      this->Matrix->Modified();
       vtkRenderWindowInteractor *iren = vtkRenderWindowInteractor::SafeDownCast(caller);
       iren->GetRenderWindow()->Render();
     }
  
   private:
     int TimerCount;
+    AsyncLogRateLimit LogLimit;
+    double StartTime;
+    vtkSmartPointer<vtkMatrix4x4> Initial;
+    vtkSmartPointer<vtkMatrix4x4> Matrix;
+  public:
+    // Spin about X in degrees per second, 20 by default: the 2 degrees per
+    // tick of the 100 ms timer this callback is used with.
+    double AngularVelocity;
   public:
     vtkActor* actor;
 };
@@ -0,0 +1,87 @@
+#ifndef __TripleBuffer_h
+#define __TripleBuffer_h
+#include <atomic>
+
+// Hands the latest value of T from one writer thread to one reader thread
+// without either ever waiting. Of the three buffers the writer owns one,
+// the reader another, and the third holds the value published last. The
+// writer fills its buffer and swaps it with the published one; the reader,
+// when something new was published, swaps its buffer with that one. Both
+// swaps are a single atomic exchange of an index, so neither side can
+// block the other, and values the reader did not get to are overwritten
+// by newer ones rather than queued.
+//
+// The buffers are never reallocated, so a T sized once before the threads
+// start is filled in place:
+//
+//   writer: T &value = buffer.GetWriteBuffer(); ...; buffer.Publish();
+//   reader: if (buffer.Acquire()) use(buffer.GetReadBuffer());
+template <class T>
+class TripleBuffer
+{
+public:
+  TripleBuffer()
+    {
+    this->Write = 0;
+    this->Middle.store(1);
+    this->Read = 2;
+    }
+
+  // For setting up the buffers, before the threads start.
+  T &GetBuffer(int i)
+    {
+    return this->Buffers[i];
+    }
+
+  T &GetWriteBuffer()
+    {
+    return this->Buffers[this->Write];
+    }
+
+  // Makes the write buffer the latest value. Returns true when the value
+  // it replaces had not been acquired.
+  bool Publish()
+    {
+    int previous = this->Middle.exchange(this->Write | Fresh, std::memory_order_acq_rel);
+    this->Write = previous & Index;
+    return (previous & Fresh) != 0;
+    }
+
+  // Takes the latest value if one was published since the last call.
+  // Returns false, keeping the read buffer, otherwise.
+  bool Acquire()
+    {
+    if (!(this->Middle.load(std::memory_order_relaxed) & Fresh))
+      {
+      return false;
+      }
+    int previous = this->Middle.exchange(this->Read, std::memory_order_acq_rel);
+    this->Read = previous & Index;
+    return true;
+    }
+
+  const T &GetReadBuffer() const
+    {
+    return this->Buffers[this->Read];
+    }
+
+private:
+  TripleBuffer(const TripleBuffer&);  // Not implemented.
+  void operator=(const TripleBuffer&);  // Not implemented.
+
+  enum
+    {
+    Index = 3,
+    Fresh = 4
+    };
+
+  T                 Buffers[3];
+  // Touched by the writer only.
+  int               Write;
+  // Index of the published buffer, with Fresh set until it is acquired.
+  alignas(64) std::atomic<int> Middle;
+  // Touched by the reader only.
+  alignas(64) int   Read;
+};
+
+#endif
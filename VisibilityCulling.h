@@ -0,0 +1,369 @@
+#ifndef __VisibilityCulling_h
+#define __VisibilityCulling_h
+#include <vtkActor.h>
+#include <vtkAnimationCue.h>
+#include <vtkCamera.h>
+#include <vtkCommand.h>
+#include <vtkMapper.h>
+#include <vtkRenderer.h>
+#include <vector>
+
+#include "Animation.h"
+#include "AnimationCueAdapter.h"
+#include "FrameProfiler.h"
+#include "RenderScheduler.h"
+
+// Ticks a set of ActorAnimators from one cue, leaving alone those whose
+// actor cannot be seen. Each animator is classified against the active
+// camera's view frustum using the box its actor sweeps over a look-ahead
+// window of the cue (ActorAnimator::GetMotionBounds); an actor whose box
+// stays outside for the whole window, or that is hidden, is deferred:
+// neither evaluated nor committed until the window runs out, the camera
+// changes or the actor is shown again. Since an animator's pose is a
+// function of the cue time alone, a deferred actor catches up in one
+// evaluation when it becomes visible, as does every actor at the end of
+// the cue or on CatchUp.
+//
+// Only the side planes of the frustum are used: the clipping range is
+// reset from the bounds of the visible props, which would leave out the
+// deferred ones. Deferred actors keep their last committed matrix, so
+// anything else reading it (picking, collisions) should call CatchUp
+// first.
+//
+// With SetSkipInvisibleRenders on, a render is requested only when a
+// visible actor moved. A RenderScheduler watching the actors sees no
+// change from deferred ones either way.
+//
+// The animators must not also be added to the cue themselves. Call
+// Modified after changing their motion.
+class CullingActorAnimator
+{
+public:
+  CullingActorAnimator()
+    {
+    this->Observer = AnimationCueObserver::New();
+    this->Observer->Animator = this;
+    this->Renderer = 0;
+    this->Scheduler = 0;
+    this->LookAhead = 0.5;
+    this->SkipInvisibleRenders = false;
+    this->PlanesMTime = 0;
+    this->PlanesAspect = 0.0;
+    this->Generation = 1;
+    this->Time = 0.0;
+    this->Duration = 0.0;
+    this->NumberOfCommitted = 0;
+    this->NumberOfDeferred = 0;
+    this->NumberOfClassified = 0;
+    }
+
+  ~CullingActorAnimator()
+    {
+    this->SetRenderer(0);
+    this->Observer->Animator = 0;
+    this->Observer->UnRegister(0);
+    }
+
+  // The animators are not owned. Their actors' model bounds are taken
+  // from modelBounds when given, otherwise from the actor's mapper when
+  // first needed; an actor without either is always treated as visible.
+  void AddAnimator(ActorAnimator *animator, const double modelBounds[6] = 0)
+    {
+    Entry entry;
+    entry.Animator = animator;
+    entry.BoundsSource = modelBounds ? Entry::Given : Entry::None;
+    for (int i = 0; i < 6; i++)
+      {
+      entry.ModelBounds[i] = modelBounds ? modelBounds[i] : 0.0;
+      }
+    entry.Generation = 0;
+    entry.From = entry.Until = 0.0;
+    entry.Visible = true;
+    entry.Deferred = false;
+    this->Entries.push_back(entry);
+    }
+  void RemoveAllAnimators()
+    {
+    this->Entries.clear();
+    }
+  size_t GetNumberOfAnimators() const
+    {
+    return this->Entries.size();
+    }
+
+  // The renderer whose active camera decides what is visible. Without one
+  // every animator ticks.
+  void SetRenderer(vtkRenderer *renderer)
+    {
+    if (this->Renderer)
+      {
+      this->Renderer->UnRegister(0);
+      }
+    this->Renderer = renderer;
+    if (this->Renderer)
+      {
+      this->Renderer->Register(0);
+      }
+    this->Modified();
+    }
+
+  void SetRenderScheduler(RenderScheduler *scheduler)
+    {
+    this->Scheduler = scheduler;
+    }
+
+  // Seconds of cue time a classification holds for. Longer windows
+  // classify less often but sweep larger boxes, so fewer actors are
+  // found outside.
+  void SetLookAhead(double seconds)
+    {
+    this->LookAhead = seconds > 0.0 ? seconds : 0.0;
+    this->Modified();
+    }
+  double GetLookAhead() const
+    {
+    return this->LookAhead;
+    }
+
+  void SetSkipInvisibleRenders(bool skip)
+    {
+    this->SkipInvisibleRenders = skip;
+    }
+
+  // Call after changing the motion or geometry of animators already
+  // added; every actor is classified again on the next tick, and model
+  // bounds taken from mappers are read again.
+  void Modified()
+    {
+    this->Generation++;
+    for (size_t i = 0; i < this->Entries.size(); i++)
+      {
+      if (this->Entries[i].BoundsSource == Entry::FromMapper)
+        {
+        this->Entries[i].BoundsSource = Entry::None;
+        }
+      }
+    }
+
+  // Counts for the last tick.
+  size_t GetNumberOfCommitted() const
+    {
+    return this->NumberOfCommitted;
+    }
+  size_t GetNumberOfDeferred() const
+    {
+    return this->NumberOfDeferred;
+    }
+  size_t GetNumberOfClassified() const
+    {
+    return this->NumberOfClassified;
+    }
+
+  void AddObserversToCue(vtkAnimationCue *cue)
+    {
+    cue->AddObserver(vtkCommand::StartAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::EndAnimationCueEvent,this->Observer);
+    cue->AddObserver(vtkCommand::AnimationCueTickEvent,this->Observer);
+    }
+
+  void Start(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    this->Generation++;
+    this->Update(info);
+    }
+
+  void Tick(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    FRAME_PROFILE_SCOPE("CullingActorAnimator::Tick");
+    this->Update(info);
+    if (this->Scheduler && (this->NumberOfCommitted || !this->SkipInvisibleRenders))
+      {
+      this->Scheduler->RequestRender();
+      }
+    }
+
+  void End(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    for (size_t i = 0; i < this->Entries.size(); i++)
+      {
+      this->Entries[i].Animator->End(info);
+      this->Entries[i].Deferred = false;
+      }
+    this->Generation++;
+    }
+
+  // Commits the pose of every deferred actor at the time of the last
+  // tick.
+  void CatchUp()
+    {
+    vtkAnimationCue::AnimationCueInfo info;
+    info.StartTime = 0.0;
+    info.EndTime = this->Duration;
+    info.AnimationTime = this->Time;
+    info.DeltaTime = 0.0;
+    info.ClockTime = this->Time;
+    for (size_t i = 0; i < this->Entries.size(); i++)
+      {
+      Entry &entry = this->Entries[i];
+      if (entry.Deferred)
+        {
+        entry.Animator->Evaluate(&info);
+        entry.Animator->Commit();
+        entry.Deferred = false;
+        }
+      }
+    }
+
+protected:
+  struct Entry
+    {
+    enum { None, FromMapper, Given };
+    ActorAnimator * Animator;
+    int             BoundsSource;
+    double          ModelBounds[6];
+    // The last classification, valid over [From, Until] of cue time while
+    // Generation is current.
+    unsigned long   Generation;
+    double          From;
+    double          Until;
+    bool            Visible;
+    // Committed pose older than the last tick.
+    bool            Deferred;
+    };
+
+  void Update(vtkAnimationCue::AnimationCueInfo *info)
+    {
+    this->Time = info->AnimationTime - info->StartTime;
+    this->Duration = info->EndTime - info->StartTime;
+    bool cull = this->UpdatePlanes();
+    this->NumberOfCommitted = 0;
+    this->NumberOfDeferred = 0;
+    this->NumberOfClassified = 0;
+    for (size_t i = 0; i < this->Entries.size(); i++)
+      {
+      Entry &entry = this->Entries[i];
+      if (cull && !this->IsVisible(entry))
+        {
+        entry.Deferred = true;
+        this->NumberOfDeferred++;
+        continue;
+        }
+      entry.Animator->Evaluate(info);
+      entry.Animator->Commit();
+      entry.Deferred = false;
+      this->NumberOfCommitted++;
+      }
+    }
+
+  // Recomputes the planes when the camera or the aspect ratio changed.
+  // Returns false when there is nothing to cull against.
+  bool UpdatePlanes()
+    {
+    if (!this->Renderer)
+      {
+      return false;
+      }
+    vtkCamera *camera = this->Renderer->GetActiveCamera();
+    double aspect = this->Renderer->GetTiledAspectRatio();
+    if (camera->GetMTime() != this->PlanesMTime || aspect != this->PlanesAspect)
+      {
+      camera->GetFrustumPlanes(aspect, this->Planes);
+      this->PlanesMTime = camera->GetMTime();
+      this->PlanesAspect = aspect;
+      this->Generation++;
+      }
+    return true;
+    }
+
+  // Classifies the entry again unless its last classification still
+  // holds at the current time.
+  bool IsVisible(Entry &entry)
+    {
+    vtkActor *actor = entry.Animator->GetActor();
+    if (!actor || !actor->GetVisibility())
+      {
+      return !actor;
+      }
+    if (entry.Generation == this->Generation &&
+        this->Time >= entry.From && this->Time <= entry.Until)
+      {
+      return entry.Visible;
+      }
+    entry.Generation = this->Generation;
+    entry.From = this->Time;
+    entry.Until = this->Time + this->LookAhead;
+    entry.Visible = true;
+    this->NumberOfClassified++;
+    if (!this->GetModelBounds(entry, actor))
+      {
+      return true;
+      }
+    double until = entry.Until < this->Duration ? entry.Until : this->Duration;
+    double bounds[6];
+    entry.Animator->GetMotionBounds(entry.ModelBounds, this->Time, until,
+                                    this->Duration, bounds);
+    entry.Visible = this->Intersects(bounds);
+    return entry.Visible;
+    }
+
+  bool GetModelBounds(Entry &entry, vtkActor *actor)
+    {
+    if (entry.BoundsSource == Entry::None)
+      {
+      vtkMapper *mapper = actor->GetMapper();
+      double *bounds = mapper ? mapper->GetBounds() : 0;
+      if (!bounds || bounds[0] > bounds[1])
+        {
+        return false;
+        }
+      for (int i = 0; i < 6; i++)
+        {
+        entry.ModelBounds[i] = bounds[i];
+        }
+      entry.BoundsSource = Entry::FromMapper;
+      }
+    return true;
+    }
+
+  // False when the box is wholly behind one of the side planes, whose
+  // normals point into the frustum: the corner farthest along the normal
+  // is enough to tell.
+  bool Intersects(const double bounds[6]) const
+    {
+    for (int p = 0; p < 4; p++)
+      {
+      const double *plane = this->Planes + 4 * p;
+      double distance = plane[3];
+      for (int i = 0; i < 3; i++)
+        {
+        distance += plane[i] * (plane[i] > 0.0 ? bounds[2 * i + 1] : bounds[2 * i]);
+        }
+      if (distance < 0.0)
+        {
+        return false;
+        }
+      }
+    return true;
+    }
+
+  typedef AnimationCueAdapter<CullingActorAnimator> AnimationCueObserver;
+
+  AnimationCueObserver *  Observer;
+  vtkRenderer *           Renderer;
+  RenderScheduler *       Scheduler;
+  std::vector<Entry>      Entries;
+  double                  Planes[24];
+  unsigned long           PlanesMTime;
+  double                  PlanesAspect;
+  // Bumped whenever every classification becomes stale.
+  unsigned long           Generation;
+  double                  LookAhead;
+  bool                    SkipInvisibleRenders;
+  double                  Time;
+  double                  Duration;
+  size_t                  NumberOfCommitted;
+  size_t                  NumberOfDeferred;
+  size_t                  NumberOfClassified;
+};
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef __WorkStealingPool_h
+#define __WorkStealingPool_h
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running parallel loops.
+// ParallelFor cuts [0, count) into chunks of grain indices and deals
+// contiguous runs of chunks to one queue per thread. Each thread works
+// from the back of its own queue and, once it is empty, steals from the
+// front of the others', so a thread that drew cheap chunks helps the ones
+// that drew expensive chunks. The calling thread takes part as thread 0
+// and ParallelFor returns when every chunk is done. Calls must not
+// overlap or nest.
+class WorkStealingPool
+{
+public:
+  // threads counts the calling thread; 0 uses one per core.
+  WorkStealingPool(int threads = 0)
+    {
+    this->Generation = 0;
+    this->Pending = 0;
+    this->Stop = false;
+    this->Start(threads);
+    }
+
+  ~WorkStealingPool()
+    {
+    this->Join();
+    }
+
+  void SetNumberOfThreads(int threads)
+    {
+    this->Join();
+    this->Start(threads);
+    }
+  int GetNumberOfThreads() const
+    {
+    return static_cast<int>(this->Queues.size());
+    }
+
+  // Runs body(begin, end) over consecutive ranges covering [0, count).
+  void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body)
+    {
+    if (!count)
+      {
+      return;
+      }
+    grain = grain ? grain : 1;
+    const size_t chunks = (count + grain - 1) / grain;
+    const size_t threads = this->Queues.size();
+    if (threads == 1 || chunks == 1)
+      {
+      body(0, count);
+      return;
+      }
+
+    this->Body = body;
+    this->Pending.store(chunks, std::memory_order_relaxed);
+    for (size_t t = 0; t < threads; t++)
+      {
+      size_t first = chunks * t / threads;
+      size_t last = chunks * (t + 1) / threads;
+      std::lock_guard<std::mutex> lock(this->Queues[t]->Mutex);
+      for (size_t c = first; c < last; c++)
+        {
+        Range range;
+        range.Begin = c * grain;
+        range.End = c + 1 < chunks ? (c + 1) * grain : count;
+        this->Queues[t]->Ranges.push_back(range);
+        }
+      }
+      {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Generation++;
+      }
+    this->WorkReady.notify_all();
+
+    this->RunChunks(0);
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    this->AllDone.wait(lock, [this] { return this->Pending.load(std::memory_order_acquire) == 0; });
+    }
+
+protected:
+  struct Range
+    {
+    size_t Begin;
+    size_t End;
+    };
+
+  struct Queue
+    {
+    std::mutex        Mutex;
+    std::deque<Range> Ranges;
+    };
+
+  void Start(int threads)
+    {
+    if (threads < 1)
+      {
+      threads = static_cast<int>(std::thread::hardware_concurrency());
+      threads = threads > 0 ? threads : 1;
+      }
+    this->Stop = false;
+    this->Queues.clear();
+    for (int t = 0; t < threads; t++)
+      {
+      this->Queues.push_back(std::unique_ptr<Queue>(new Queue));
+      }
+    for (int t = 1; t < threads; t++)
+      {
+      this->Workers.push_back(std::thread(&WorkStealingPool::Work, this, t));
+      }
+    }
+
+  void Join()
+    {
+      {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Stop = true;
+      }
+    this->WorkReady.notify_all();
+    for (size_t t = 0; t < this->Workers.size(); t++)
+      {
+      this->Workers[t].join();
+      }
+    this->Workers.clear();
+    }
+
+  bool Pop(size_t thread, Range &range)
+    {
+    Queue &queue = *this->Queues[thread];
+    std::lock_guard<std::mutex> lock(queue.Mutex);
+    if (queue.Ranges.empty())
+      {
+      return false;
+      }
+    range = queue.Ranges.back();
+    queue.Ranges.pop_back();
+    return true;
+    }
+
+  bool Steal(size_t thread, Range &range)
+    {
+    const size_t threads = this->Queues.size();
+    for (size_t i = 1; i < threads; i++)
+      {
+      Queue &queue = *this->Queues[(thread + i) % threads];
+      std::lock_guard<std::mutex> lock(queue.Mutex);
+      if (!queue.Ranges.empty())
+        {
+        range = queue.Ranges.front();
+        queue.Ranges.pop_front();
+        return true;
+        }
+      }
+    return false;
+    }
+
+  void RunChunks(size_t thread)
+    {
+    Range range;
+    while (this->Pop(thread, range) || this->Steal(thread, range))
+      {
+      this->Body(range.Begin, range.End);
+      if (this->Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+        std::lock_guard<std::mutex> lock(this->Mutex);
+        this->AllDone.notify_all();
+        }
+      }
+    }
+
+  void Work(size_t thread)
+    {
+    unsigned long long seen = 0;
+    for (;;)
+      {
+        {
+        std::unique_lock<std::mutex> lock(this->Mutex);
+        this->WorkReady.wait(lock, [&] { return this->Stop || this->Generation != seen; });
+        if (this->Stop)
+          {
+          return;
+          }
+        seen = this->Generation;
+        }
+      this->RunChunks(thread);
+      }
+    }
+
+  std::vector<std::unique_ptr<Queue> >       Queues;
+  std::vector<std::thread>                   Workers;
+  std::function<void(size_t, size_t)>        Body;
+  std::mutex                                 Mutex;
+  std::condition_variable                    WorkReady;
+  std::condition_variable                    AllDone;
+  unsigned long long                         Generation;
+  std::atomic<size_t>                        Pending;
+  bool                                       Stop;
+};
+
+#endif